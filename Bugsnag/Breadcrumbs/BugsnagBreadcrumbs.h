@@ -26,6 +26,13 @@ BSG_OBJC_DIRECT_MEMBERS
  */
 @property (readonly, nonatomic) NSArray<BugsnagBreadcrumb *> *breadcrumbs;
 
+/**
+ * Returns the JSON encoding of each of the breadcrumbs stored in memory.
+ *
+ * This is much cheaper than `breadcrumbs` because the stored data does not need to be parsed.
+ */
+@property (readonly, nonatomic) NSArray<NSData *> *serializedBreadcrumbs;
+
 /**
  * Store a new breadcrumb.
  */
@@ -34,12 +41,29 @@ BSG_OBJC_DIRECT_MEMBERS
 /**
  * Store a new serialized breadcrumb.
  */
-- (void)addBreadcrumbWithData:(NSData *)data writeToDisk:(BOOL)writeToDisk;
+- (void)addBreadcrumbWithData:(NSData *)data;
 
+/**
+ * Returns the breadcrumbs stored in memory with timestamps no later than `date`, to millisecond precision.
+ *
+ * Breadcrumbs are assumed to be added in chronological order; any that are not are treated as being
+ * as recent as the latest breadcrumb added before them.
+ */
 - (NSArray<BugsnagBreadcrumb *> *)breadcrumbsBeforeDate:(NSDate *)date;
 
 /**
- * The breadcrumb stored on disk.
+ * The JSON encoding of each of the breadcrumbs that `breadcrumbsBeforeDate:` would return.
+ */
+- (NSArray<NSData *> *)serializedBreadcrumbsBeforeDate:(NSDate *)date;
+
+/**
+ * The number of breadcrumbs that have been encoded, and the total time spent encoding them.
+ */
+@property (readonly, nonatomic) NSUInteger encodeCount;
+@property (readonly, nonatomic) NSTimeInterval encodeDuration;
+
+/**
+ * The breadcrumbs stored in the on-disk journal, which includes those left by the previous launch.
  */
 - (NSArray<BugsnagBreadcrumb *> *)cachedBreadcrumbs;
 
@@ -50,6 +74,11 @@ BSG_OBJC_DIRECT_MEMBERS
 
 @end
 
+/**
+ * Parses breadcrumbs encoded by BugsnagBreadcrumbs, skipping any that are not valid.
+ */
+NSArray<BugsnagBreadcrumb *> * BugsnagBreadcrumbsFromJSONData(NSArray<NSData *> *array);
+
 NS_ASSUME_NONNULL_END
 
 #pragma mark -
@@ -57,8 +86,8 @@ NS_ASSUME_NONNULL_END
 /**
  * Inserts the current breadcrumbs into a crash report.
  *
- * This function is async-signal-safe, but requires that any threads that could be adding
- * breadcrumbs are suspended.
+ * This function is async-signal-safe. Breadcrumbs added by other threads while it is running
+ * are dropped.
  */
 void BugsnagBreadcrumbsWriteCrashReport(const BSG_KSCrashReportWriter * _Nonnull writer,
                                         bool requiresAsyncSafety);
@@ -12,26 +12,590 @@
 #import "BSGJSONSerialization.h"
 #import "BSGUtils.h"
 #import "BSG_KSCrashReportWriter.h"
+#import "BSG_KSJSONCodec.h"
 #import "BSG_RFC3339DateTool.h"
 #import "BugsnagBreadcrumb+Private.h"
-#import "BugsnagCollections.h"
 #import "BugsnagConfiguration+Private.h"
 #import "BugsnagLogger.h"
 
 #import <stdatomic.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
 
 //
-// Breadcrumbs are stored as a linked list of JSON encoded C strings
+// Breadcrumbs are stored as JSON encoded C strings in a fixed-capacity ring
 // so that they are accessible at crash time.
 //
+// Each slot refers to a record in a circular byte arena. Producers atomically
+// reserve space in the arena and a sequence number, write their record, and
+// then publish its position to the slot for their sequence number. Records
+// are never freed; a record remains valid until the arena wraps past it.
+//
+// A producer that stalls between reserving space and writing to it can
+// overwrite a newer record, so records are checksummed.
+//
+// Each record carries a timestamp that is clamped to be no earlier than that
+// of previously added records, so that records can be found by date with a
+// binary search. (Records added concurrently may still be out of order by the
+// time between their producers reading the clock.) The unclamped timestamp is
+// kept as well, so that records that were clamped, for example because the
+// clock was set back, can still be matched against their real date.
+//
+// When breadcrumbs are persisted, the header and arena are a shared mapping
+// of a journal file so that records survive the process being killed. Slots
+// are not persisted; records are recovered by scanning the arena for valid
+// checksums.
+//
+
+// Average record size the arena is sized for. If breadcrumbs are larger than
+// this on average, fewer than maxBreadcrumbs may be retained.
+#define BSG_BREADCRUMB_ARENA_BYTES_PER_SLOT 1024
+
+#define BSG_BREADCRUMB_ARENA_MIN_SIZE (64 * 1024ULL)
+
+// Set in arenaHead while a crash report is being written to prevent any
+// records from being overwritten.
+#define BSG_BREADCRUMB_ARENA_FROZEN (1ULL << 63)
+
+#define BSG_BREADCRUMB_JOURNAL_MAGIC 0x4a475342 // "BSGJ"
+#define BSG_BREADCRUMB_JOURNAL_VERSION 3
 
-struct bsg_breadcrumb_list_item {
-    struct bsg_breadcrumb_list_item *next;
+static NSString * const BSGBreadcrumbJournalName = @"journal";
+
+struct bsg_breadcrumb_record {
+    uint64_t sequence;
+    int64_t timestamp; // Milliseconds since 1970, clamped as described above
+    int64_t originalTimestamp; // Milliseconds since 1970, before clamping
+    uint32_t length;
+    uint32_t checksum;
     char jsonData[]; // MUST be null terminated
 };
 
-static _Atomic(struct bsg_breadcrumb_list_item *) g_breadcrumbs_head;
-static atomic_bool g_writing_crash_report;
+struct bsg_breadcrumb_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t arenaSize;
+    _Atomic(uint64_t) head;            // The next sequence number
+    _Atomic(uint64_t) arenaHead;       // The next arena position, which increases monotonically
+    _Atomic(uint64_t) clearedSequence; // Records before this sequence number have been removed
+};
+
+struct bsg_breadcrumb_ring {
+    uint32_t capacity;
+    bool persistent;
+    uint64_t arenaSize;
+    struct bsg_breadcrumb_ring_header *header;
+    char *arena;                 // Immediately follows the header
+    _Atomic(uint64_t) *slots;    // Arena position + 1 of each slot's record, or 0 if empty
+    _Atomic(int64_t) timestamp;  // The latest record timestamp
+    _Atomic(uint64_t) clampedEnd; // One past the sequence number of the latest record whose timestamp was clamped
+};
+
+static _Atomic(struct bsg_breadcrumb_ring *) g_breadcrumbs_ring;
+
+static void bsg_breadcrumb_ring_header_init(struct bsg_breadcrumb_ring_header *header, uint64_t arenaSize) {
+    header->magic = BSG_BREADCRUMB_JOURNAL_MAGIC;
+    header->version = BSG_BREADCRUMB_JOURNAL_VERSION;
+    header->arenaSize = arenaSize;
+}
+
+/// Maps the journal file into memory, keeping any records it contains if its layout matches.
+static struct bsg_breadcrumb_ring_header * bsg_breadcrumb_journal_map(NSString *path, uint64_t arenaSize) {
+    const size_t size = sizeof(struct bsg_breadcrumb_ring_header) + arenaSize;
+    
+    int fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT, 0600);
+    if (fd == -1) {
+        bsg_log_err(@"Could not open %@: %d", path, errno);
+        return NULL;
+    }
+    
+    // NSFileProtectionComplete invalidates mappings 10 seconds after device is
+    // locked, so must be disabled to prevent segfaults when adding breadcrumbs.
+    if (!BSGDisableNSFileProtectionComplete(path)) {
+        close(fd);
+        return NULL;
+    }
+    
+    struct bsg_breadcrumb_ring_header existing = {0};
+    struct stat st;
+    const bool isValid = (fstat(fd, &st) == 0 && st.st_size == (off_t)size &&
+                          pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+                          existing.magic == BSG_BREADCRUMB_JOURNAL_MAGIC &&
+                          existing.version == BSG_BREADCRUMB_JOURNAL_VERSION &&
+                          existing.arenaSize == arenaSize);
+    
+    // Note: ftruncate fills the file with zeros when extending.
+    if (!isValid && (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)size) != 0)) {
+        bsg_log_err(@"ftruncate failed: %d", errno);
+        close(fd);
+        return NULL;
+    }
+    
+    void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_FILE | MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        bsg_log_err(@"mmap failed: %d", errno);
+        return NULL;
+    }
+    
+    struct bsg_breadcrumb_ring_header *header = ptr;
+    if (isValid) {
+        // The previous process may have crashed while writing a crash report.
+        atomic_fetch_and(&header->arenaHead, ~BSG_BREADCRUMB_ARENA_FROZEN);
+    } else {
+        bsg_breadcrumb_ring_header_init(header, arenaSize);
+    }
+    return header;
+}
+
+static struct bsg_breadcrumb_ring * bsg_breadcrumb_ring_create(uint32_t capacity, NSString *journalPath) {
+    struct bsg_breadcrumb_ring *ring = calloc(1, sizeof(struct bsg_breadcrumb_ring));
+    if (!ring) {
+        return NULL;
+    }
+    ring->capacity = capacity;
+    ring->arenaSize = MAX((uint64_t)capacity * BSG_BREADCRUMB_ARENA_BYTES_PER_SLOT,
+                          BSG_BREADCRUMB_ARENA_MIN_SIZE);
+    ring->slots = calloc(capacity, sizeof(*ring->slots));
+    if (!ring->slots) {
+        free(ring);
+        return NULL;
+    }
+    if (journalPath) {
+        ring->header = bsg_breadcrumb_journal_map(journalPath, ring->arenaSize);
+        ring->persistent = ring->header != NULL;
+    }
+    if (!ring->header) {
+        ring->header = calloc(1, sizeof(struct bsg_breadcrumb_ring_header) + ring->arenaSize);
+        if (!ring->header) {
+            free(ring->slots);
+            free(ring);
+            return NULL;
+        }
+        bsg_breadcrumb_ring_header_init(ring->header, ring->arenaSize);
+    }
+    ring->arena = (char *)(ring->header + 1);
+    return ring;
+}
+
+static uint64_t bsg_breadcrumb_record_size(uint64_t length) {
+    return (sizeof(struct bsg_breadcrumb_record) + length + 1 + 7) & ~(uint64_t)7;
+}
+
+static uint32_t bsg_breadcrumb_checksum(int64_t timestamp, int64_t originalTimestamp,
+                                        const char *data, size_t length) {
+    uint32_t hash = 2166136261U; // FNV-1a
+    for (size_t i = 0; i < sizeof(timestamp); i++) {
+        hash = (hash ^ (uint8_t)((uint64_t)timestamp >> (i * 8))) * 16777619U;
+    }
+    for (size_t i = 0; i < sizeof(originalTimestamp); i++) {
+        hash = (hash ^ (uint8_t)((uint64_t)originalTimestamp >> (i * 8))) * 16777619U;
+    }
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+/// Returns the record at `position`, or NULL if the arena has been reserved
+/// beyond the point at which it would be overwritten.
+static const struct bsg_breadcrumb_record *
+bsg_breadcrumb_ring_record(const struct bsg_breadcrumb_ring *ring, uint64_t position, uint64_t arenaHead) {
+    if ((arenaHead & ~BSG_BREADCRUMB_ARENA_FROZEN) > position + ring->arenaSize) {
+        return NULL;
+    }
+    return (const void *)(ring->arena + position % ring->arenaSize);
+}
+
+static bool bsg_breadcrumb_record_is_valid(const struct bsg_breadcrumb_ring *ring, uint64_t position,
+                                           const struct bsg_breadcrumb_record *record, uint64_t sequence) {
+    const uint64_t available = ring->arenaSize - position % ring->arenaSize - sizeof(struct bsg_breadcrumb_record);
+    return (record->sequence == sequence &&
+            record->length < available &&
+            record->jsonData[record->length] == '\0' &&
+            record->checksum == bsg_breadcrumb_checksum(record->timestamp, record->originalTimestamp,
+                                                        record->jsonData, record->length));
+}
+
+/// Copies a record's JSON, returning nil if it is not intact.
+///
+/// @param originalTimestamp If not NULL, receives the record's unclamped timestamp.
+static NSData * bsg_breadcrumb_record_copy(const struct bsg_breadcrumb_ring *ring, uint64_t position,
+                                           const struct bsg_breadcrumb_record *record,
+                                           int64_t *originalTimestamp) {
+    // The record may be overwritten at any time, so only trust fields that have been copied.
+    const uint32_t length = record->length, checksum = record->checksum;
+    const int64_t timestamp = record->timestamp, original = record->originalTimestamp;
+    if (length >= ring->arenaSize - position % ring->arenaSize - sizeof(struct bsg_breadcrumb_record)) {
+        return nil;
+    }
+    NSData *data = [NSData dataWithBytes:record->jsonData length:length];
+    if (bsg_breadcrumb_checksum(timestamp, original, data.bytes, data.length) != checksum) {
+        return nil;
+    }
+    if (originalTimestamp) {
+        *originalTimestamp = original;
+    }
+    return data;
+}
+
+static bool bsg_breadcrumb_ring_reserve(struct bsg_breadcrumb_ring *ring, uint64_t size, uint64_t *position) {
+    uint64_t arenaHead = atomic_load(&ring->header->arenaHead);
+    uint64_t start;
+    do {
+        if (arenaHead & BSG_BREADCRUMB_ARENA_FROZEN) {
+            return false;
+        }
+        start = arenaHead;
+        const uint64_t offset = start % ring->arenaSize;
+        if (offset + size > ring->arenaSize) {
+            // Records must be contiguous, so skip the remainder of the arena.
+            start += ring->arenaSize - offset;
+        }
+    } while (!atomic_compare_exchange_weak(&ring->header->arenaHead, &arenaHead, start + size));
+    *position = start;
+    return true;
+}
+
+static void bsg_breadcrumb_ring_add(struct bsg_breadcrumb_ring *ring, int64_t timestamp,
+                                    const void *jsonData, size_t length) {
+    const uint64_t size = bsg_breadcrumb_record_size(length);
+    if (size > ring->arenaSize) {
+        bsg_log_err(@"Breadcrumb too large (%zu bytes)", length);
+        return;
+    }
+    
+    // Breadcrumbs added out of order, or after the clock has been set back,
+    // take the latest timestamp so that records remain sorted.
+    const int64_t originalTimestamp = timestamp;
+    int64_t latest = atomic_load(&ring->timestamp);
+    while (latest < timestamp && !atomic_compare_exchange_weak(&ring->timestamp, &latest, timestamp)) {}
+    timestamp = MAX(timestamp, latest);
+    
+    uint64_t position;
+    if (!bsg_breadcrumb_ring_reserve(ring, size, &position)) {
+        return;
+    }
+    // Sequence numbers are taken after reserving space so that none are wasted
+    // while a crash report is being written.
+    const uint64_t sequence = atomic_fetch_add(&ring->header->head, 1);
+    
+    struct bsg_breadcrumb_record *record = (void *)(ring->arena + position % ring->arenaSize);
+    record->sequence = sequence;
+    record->timestamp = timestamp;
+    record->originalTimestamp = originalTimestamp;
+    record->length = (uint32_t)length;
+    record->checksum = bsg_breadcrumb_checksum(timestamp, originalTimestamp, jsonData, length);
+    memcpy(record->jsonData, jsonData, length);
+    record->jsonData[length] = '\0';
+    
+    if (timestamp != originalTimestamp) {
+        uint64_t clampedEnd = atomic_load(&ring->clampedEnd);
+        while (clampedEnd <= sequence && !atomic_compare_exchange_weak(&ring->clampedEnd, &clampedEnd, sequence + 1)) {}
+    }
+    
+    _Atomic(uint64_t) *slot = &ring->slots[sequence % ring->capacity];
+    uint64_t current = atomic_load(slot);
+    do {
+        if (current) {
+            // If producers have lapped each other, a newer record may already occupy this slot.
+            const uint64_t arenaHeadBefore = atomic_load(&ring->header->arenaHead);
+            const struct bsg_breadcrumb_record *existing = bsg_breadcrumb_ring_record(ring, current - 1, arenaHeadBefore);
+            const uint64_t existingSequence = existing ? existing->sequence : 0;
+            // A record that was torn or overwritten while its sequence was being read can report a bogus large
+            // sequence, so it is only believed if the arena was not reserved past the record in the meantime.
+            const uint64_t arenaHeadAfter = atomic_load(&ring->header->arenaHead);
+            if (existingSequence > sequence && bsg_breadcrumb_ring_record(ring, current - 1, arenaHeadAfter)) {
+                return;
+            }
+        }
+    } while (!atomic_compare_exchange_weak(slot, &current, position + 1));
+}
+
+/// Returns the sequence number of the oldest record that can be in the ring.
+static uint64_t bsg_breadcrumb_ring_first(const struct bsg_breadcrumb_ring *ring, uint64_t head) {
+    return head > ring->capacity ? head - ring->capacity : 0;
+}
+
+/// Reads the timestamp of the record with `sequence`, returning false if it is not in the ring.
+static bool bsg_breadcrumb_ring_timestamp(const struct bsg_breadcrumb_ring *ring, uint64_t sequence,
+                                          int64_t *timestamp) {
+    const uint64_t slot = atomic_load(&ring->slots[sequence % ring->capacity]);
+    if (!slot) {
+        return false;
+    }
+    const struct bsg_breadcrumb_record *record =
+    bsg_breadcrumb_ring_record(ring, slot - 1, atomic_load(&ring->header->arenaHead));
+    if (!record || record->sequence != sequence) {
+        return false;
+    }
+    *timestamp = record->timestamp;
+    // The record may have been overwritten while it was being read.
+    return bsg_breadcrumb_ring_record(ring, slot - 1, atomic_load(&ring->header->arenaHead)) != NULL;
+}
+
+/// Returns the sequence number of the first record in [first, end) with a timestamp later than
+/// `timestamp`, or `end` if there is none.
+///
+/// Timestamps are in sequence order, so this is a binary search. Records that are missing from the ring
+/// are skipped over.
+static uint64_t bsg_breadcrumb_ring_search(const struct bsg_breadcrumb_ring *ring, uint64_t first, uint64_t end,
+                                           int64_t timestamp) {
+    while (first < end) {
+        const uint64_t middle = first + (end - first) / 2;
+        uint64_t sequence = middle;
+        int64_t value = 0;
+        while (sequence < end && !bsg_breadcrumb_ring_timestamp(ring, sequence, &value)) {
+            sequence++;
+        }
+        if (sequence < end && value <= timestamp) {
+            first = sequence + 1;
+        } else {
+            end = middle;
+        }
+    }
+    return first;
+}
+
+/// Returns copies of the records with sequence numbers in [first, end) and unclamped timestamps no later than
+/// `maxTimestamp`, oldest first.
+static NSArray<NSData *> * bsg_breadcrumb_ring_copy(const struct bsg_breadcrumb_ring *ring,
+                                                    uint64_t first, uint64_t end, int64_t maxTimestamp) {
+    NSMutableArray<NSData *> *array = [NSMutableArray arrayWithCapacity:(NSUInteger)(end - first)];
+    for (uint64_t sequence = first; sequence < end; sequence++) {
+        const uint64_t slot = atomic_load(&ring->slots[sequence % ring->capacity]);
+        if (!slot) {
+            continue;
+        }
+        const uint64_t position = slot - 1;
+        const struct bsg_breadcrumb_record *record =
+        bsg_breadcrumb_ring_record(ring, position, atomic_load(&ring->header->arenaHead));
+        if (!record || record->sequence != sequence) {
+            continue;
+        }
+        int64_t timestamp = 0;
+        NSData *data = bsg_breadcrumb_record_copy(ring, position, record, &timestamp);
+        // Discard the copy if the record could have been overwritten while it was being made.
+        if (data && timestamp <= maxTimestamp &&
+            bsg_breadcrumb_ring_record(ring, position, atomic_load(&ring->header->arenaHead))) {
+            [array addObject:data];
+        }
+    }
+    return array;
+}
+
+/// Returns copies of the records in a persistent ring's journal, including those written by a previous
+/// process, oldest first.
+///
+/// The arena is scanned in a single pass starting from its oldest position.
+static NSArray<NSData *> * bsg_breadcrumb_ring_recover(const struct bsg_breadcrumb_ring *ring) {
+    const uint64_t head = atomic_load(&ring->header->head);
+    const uint64_t first = MAX(bsg_breadcrumb_ring_first(ring, head),
+                               atomic_load(&ring->header->clearedSequence));
+    const uint64_t start = (atomic_load(&ring->header->arenaHead) & ~BSG_BREADCRUMB_ARENA_FROZEN) % ring->arenaSize;
+    
+    NSMutableDictionary<NSNumber *, NSData *> *records = [NSMutableDictionary dictionary];
+    for (uint64_t scanned = 0; scanned < ring->arenaSize; ) {
+        const uint64_t offset = (start + scanned) % ring->arenaSize;
+        const struct bsg_breadcrumb_record *record = (const void *)(ring->arena + offset);
+        const uint64_t sequence = offset + sizeof(struct bsg_breadcrumb_record) < ring->arenaSize ? record->sequence : 0;
+        NSData *data = nil;
+        if (sequence >= first && sequence < head &&
+            bsg_breadcrumb_record_is_valid(ring, offset, record, sequence) &&
+            (data = bsg_breadcrumb_record_copy(ring, offset, record, NULL))) {
+            records[@(sequence)] = data;
+            scanned += bsg_breadcrumb_record_size(data.length);
+        } else {
+            // Records are 8 byte aligned.
+            scanned += 8;
+        }
+    }
+    
+    NSArray<NSNumber *> *sequences = [records.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    return [records objectsForKeys:sequences notFoundMarker:[NSData data]];
+}
+
+static void bsg_breadcrumb_ring_clear(struct bsg_breadcrumb_ring *ring) {
+    atomic_store(&ring->header->clearedSequence, atomic_load(&ring->header->head));
+    atomic_store(&ring->timestamp, 0);
+    for (uint32_t i = 0; i < ring->capacity; i++) {
+        atomic_store(&ring->slots[i], 0);
+    }
+}
+
+#pragma mark - Encoding
+
+//
+// Breadcrumbs are encoded directly with BSG_KSJSONCodec rather than building an
+// NSDictionary for NSJSONSerialization. The ring needs to know a record's length
+// before reserving space for it, so the JSON is accumulated in a buffer (on the
+// stack unless it grows too large) and then copied into the arena.
+//
+
+// Deeper containers in metadata are omitted.
+#define BSG_BREADCRUMB_MAX_DEPTH 100
+
+struct bsg_breadcrumb_buffer {
+    char *bytes;
+    size_t length;
+    size_t capacity;
+    char *heapBytes; // Non-NULL once the buffer has outgrown its initial storage
+};
+
+static int bsg_breadcrumb_buffer_append(const char *data, size_t length, void *userData) {
+    struct bsg_breadcrumb_buffer *buffer = userData;
+    if (buffer->length + length > buffer->capacity) {
+        const size_t capacity = MAX(buffer->capacity * 2, buffer->length + length);
+        char *bytes = realloc(buffer->heapBytes, capacity);
+        if (!bytes) {
+            return BSG_KSJSON_ERROR_CANNOT_ADD_DATA;
+        }
+        if (!buffer->heapBytes) {
+            memcpy(bytes, buffer->bytes, buffer->length);
+        }
+        buffer->bytes = buffer->heapBytes = bytes;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->length, data, length);
+    buffer->length += length;
+    return BSG_KSJSON_OK;
+}
+
+static int EncodeObject(BSG_KSJSONEncodeContext *context, const char *name, id object);
+
+static int EncodeString(BSG_KSJSONEncodeContext *context, const char *name, NSString *string) {
+    const char *cString = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingUTF8);
+    if (cString) {
+        // CoreFoundation only exposes ASCII storage as UTF-8, so the length in UTF-16 code units is also the length in
+        // bytes. Unlike strlen() it includes any embedded NUL characters.
+        return bsg_ksjsonaddStringElement(context, name, cString, (size_t)CFStringGetLength((__bridge CFStringRef)string));
+    }
+    int result = bsg_ksjsonbeginStringElement(context, name);
+    char buffer[256];
+    NSRange range = NSMakeRange(0, string.length);
+    while (result == BSG_KSJSON_OK && range.length) {
+        NSUInteger usedLength = 0;
+        [string getBytes:buffer maxLength:sizeof(buffer) usedLength:&usedLength encoding:NSUTF8StringEncoding
+                 options:NSStringEncodingConversionAllowLossy range:range remainingRange:&range];
+        if (!usedLength) {
+            break;
+        }
+        result = bsg_ksjsonappendStringElement(context, buffer, usedLength);
+    }
+    return result == BSG_KSJSON_OK ? bsg_ksjsonendStringElement(context) : result;
+}
+
+static int EncodeNumber(BSG_KSJSONEncodeContext *context, const char *name, NSNumber *number) {
+    if (number == (__bridge NSNumber *)kCFBooleanTrue || number == (__bridge NSNumber *)kCFBooleanFalse) {
+        return bsg_ksjsonaddBooleanElement(context, name, number.boolValue);
+    }
+    switch (number.objCType[0]) {
+        case 'f':
+        case 'd': {
+            const double value = number.doubleValue;
+            // NSJSONSerialization rejects NaN and infinity, so they are omitted.
+            return isfinite(value) ? bsg_ksjsonaddFloatingPointElement(context, name, value) : BSG_KSJSON_OK;
+        }
+        case 'C':
+        case 'S':
+        case 'I':
+        case 'L':
+        case 'Q':
+            return bsg_ksjsonaddUIntegerElement(context, name, number.unsignedLongLongValue);
+        default:
+            return bsg_ksjsonaddIntegerElement(context, name, number.longLongValue);
+    }
+}
+
+static int EncodeDictionary(BSG_KSJSONEncodeContext *context, const char *name, NSDictionary *dictionary) {
+    int result = bsg_ksjsonbeginObject(context, name);
+    for (id key in dictionary) {
+        if (result != BSG_KSJSON_OK) {
+            break;
+        }
+        if (![key isKindOfClass:[NSString class]]) {
+            continue;
+        }
+        char buffer[256];
+        const char *keyName = CFStringGetCStringPtr((__bridge CFStringRef)key, kCFStringEncodingUTF8);
+        if (!keyName) {
+            keyName = [key getCString:buffer maxLength:sizeof(buffer) encoding:NSUTF8StringEncoding] ? buffer : [key UTF8String];
+        }
+        if (keyName) {
+            result = EncodeObject(context, keyName, dictionary[key]);
+        }
+    }
+    return result == BSG_KSJSON_OK ? bsg_ksjsonendContainer(context) : result;
+}
+
+static int EncodeArray(BSG_KSJSONEncodeContext *context, const char *name, NSArray *array) {
+    int result = bsg_ksjsonbeginArray(context, name);
+    for (id element in array) {
+        if (result != BSG_KSJSON_OK) {
+            break;
+        }
+        result = EncodeObject(context, NULL, element);
+    }
+    return result == BSG_KSJSON_OK ? bsg_ksjsonendContainer(context) : result;
+}
+
+/// Encodes a value as NSJSONSerialization would, omitting any values that it would reject.
+static int EncodeObject(BSG_KSJSONEncodeContext *context, const char *name, id object) {
+    if ([object isKindOfClass:[NSString class]]) {
+        return EncodeString(context, name, object);
+    }
+    if ([object isKindOfClass:[NSNumber class]]) {
+        return EncodeNumber(context, name, object);
+    }
+    if ([object isKindOfClass:[NSNull class]]) {
+        return bsg_ksjsonaddNullElement(context, name);
+    }
+    if (context->containerLevel >= BSG_BREADCRUMB_MAX_DEPTH) {
+        return BSG_KSJSON_OK;
+    }
+    if ([object isKindOfClass:[NSDictionary class]]) {
+        return EncodeDictionary(context, name, object);
+    }
+    if ([object isKindOfClass:[NSArray class]]) {
+        return EncodeArray(context, name, object);
+    }
+    return BSG_KSJSON_OK;
+}
+
+/// Encodes a breadcrumb in the same format as -[BugsnagBreadcrumb objectValue].
+static int EncodeBreadcrumb(BugsnagBreadcrumb *breadcrumb, struct bsg_breadcrumb_buffer *buffer) {
+    NSString *timestamp = breadcrumb.timestampString ?: [BSG_RFC3339DateTool stringFromDate:breadcrumb.timestamp];
+    if (!timestamp || !breadcrumb.message.length) {
+        return BSG_KSJSON_ERROR_INVALID_DATA;
+    }
+    
+    BSG_KSJSONEncodeContext context;
+    bsg_ksjsonbeginEncode(&context, false, bsg_breadcrumb_buffer_append, buffer);
+    int result = bsg_ksjsonbeginObject(&context, NULL);
+    if (result == BSG_KSJSON_OK) {
+        result = EncodeString(&context, "timestamp", timestamp);
+    }
+    if (result == BSG_KSJSON_OK) {
+        // Note: The Bugsnag Error Reporting API specifies that the breadcrumb "message"
+        // field should be delivered in as a "name" field.
+        result = EncodeString(&context, "name", breadcrumb.message);
+    }
+    if (result == BSG_KSJSON_OK) {
+        result = EncodeString(&context, "type", BSGBreadcrumbTypeValue(breadcrumb.type));
+    }
+    if (result == BSG_KSJSON_OK) {
+        result = EncodeDictionary(&context, "metaData", breadcrumb.metadata ?: @{});
+    }
+    if (result == BSG_KSJSON_OK) {
+        result = bsg_ksjsonendEncode(&context);
+    }
+    return result;
+}
+
+/// Breadcrumb timestamps are serialized with millisecond precision, so records are indexed at the same precision.
+static int64_t BreadcrumbTimestamp(NSDate *date) {
+    return (int64_t)floor(date.timeIntervalSince1970 * 1000);
+}
 
 #pragma mark -
 
@@ -40,15 +604,18 @@ static atomic_bool g_writing_crash_report;
 @property (readonly, nonatomic) NSString *breadcrumbsPath;
 
 @property (nonatomic) BugsnagConfiguration *config;
-@property (nonatomic) unsigned int nextFileNumber;
 @property (nonatomic) unsigned int maxBreadcrumbs;
+@property (readonly, nonatomic) struct bsg_breadcrumb_ring *ring;
 
 @end
 
 #pragma mark -
 
 BSG_OBJC_DIRECT_MEMBERS
-@implementation BugsnagBreadcrumbs
+@implementation BugsnagBreadcrumbs {
+    _Atomic(NSUInteger) _encodeCount;
+    _Atomic(uint64_t) _encodeNanoseconds;
+}
 
 - (instancetype)initWithConfiguration:(BugsnagConfiguration *)config {
     if (!(self = [super init])) {
@@ -61,41 +628,55 @@ BSG_OBJC_DIRECT_MEMBERS
     
     _breadcrumbsPath = [BSGFileLocations current].breadcrumbs;
     
+    //
+    // Breadcrumbs are also stored on disk so that they are accessible at next
+    // launch if an OOM is detected.
+    //
+    const BOOL persistent = [self shouldWriteToDisk];
+    
+    struct bsg_breadcrumb_ring *ring = atomic_load(&g_breadcrumbs_ring);
+    if (!_maxBreadcrumbs) {
+        ring = NULL;
+    } else if (!ring || ring->capacity != _maxBreadcrumbs || ring->persistent != persistent) {
+        NSString *journalPath = persistent ? [_breadcrumbsPath stringByAppendingPathComponent:BSGBreadcrumbJournalName] : nil;
+        ring = bsg_breadcrumb_ring_create(_maxBreadcrumbs, journalPath);
+    }
+    // A replaced ring is not freed because a crash report could be being written from it.
+    atomic_store(&g_breadcrumbs_ring, ring);
+    _ring = ring;
+    
     return self;
 }
 
 - (NSArray<BugsnagBreadcrumb *> *)breadcrumbs {
-    NSMutableArray<BugsnagBreadcrumb *> *breadcrumbs = [NSMutableArray array];
-    @synchronized (self) {
-        for (struct bsg_breadcrumb_list_item *item = atomic_load(&g_breadcrumbs_head); item != NULL; item = item->next) {
-            NSError *error = nil;
-            NSData *data = [NSData dataWithBytesNoCopy:item->jsonData length:strlen(item->jsonData) freeWhenDone:NO];
-            NSDictionary *JSONObject = BSGJSONDictionaryFromData(data, 0, &error);
-            if (!JSONObject) {
-                bsg_log_err(@"Unable to parse breadcrumb: %@", error);
-                continue;
-            }
-            BugsnagBreadcrumb *breadcrumb = [BugsnagBreadcrumb breadcrumbFromDict:JSONObject];
-            if (!breadcrumb) {
-                bsg_log_err(@"Unexpected breadcrumb payload in buffer");
-                continue;
-            }
-            [breadcrumbs addObject:breadcrumb];
-        }
+    return BugsnagBreadcrumbsFromJSONData(self.serializedBreadcrumbs);
+}
+
+- (NSArray<NSData *> *)serializedBreadcrumbs {
+    if (!self.ring) {
+        return @[];
     }
-    return breadcrumbs;
+    const uint64_t head = atomic_load(&self.ring->header->head);
+    return bsg_breadcrumb_ring_copy(self.ring, bsg_breadcrumb_ring_first(self.ring, head), head, INT64_MAX);
 }
 
 - (NSArray<BugsnagBreadcrumb *> *)breadcrumbsBeforeDate:(nonnull NSDate *)date {
-    // Because breadcrumbs are stored with only millisecond accuracy, we must also round the beforeDate in the same way.
-    NSString *dateString = [BSG_RFC3339DateTool stringFromDate:date];
-    return BSGArrayMap(self.breadcrumbs, ^id _Nullable(BugsnagBreadcrumb *crumb) {
-        // Using `timestampString` is more efficient because `timestamp` is a computed by parsing `timestampString`.
-        if ([crumb.timestampString compare:dateString] == NSOrderedDescending) {
-            return nil;
-        }
-        return crumb;
-    });
+    return BugsnagBreadcrumbsFromJSONData([self serializedBreadcrumbsBeforeDate:date]);
+}
+
+- (NSArray<NSData *> *)serializedBreadcrumbsBeforeDate:(NSDate *)date {
+    if (!self.ring) {
+        return @[];
+    }
+    const uint64_t head = atomic_load(&self.ring->header->head);
+    const uint64_t first = bsg_breadcrumb_ring_first(self.ring, head);
+    const int64_t timestamp = BreadcrumbTimestamp(date);
+    const uint64_t end = bsg_breadcrumb_ring_search(self.ring, first, head, timestamp);
+    // Clamping only makes timestamps later, so every record before `end` was added before `date`. Records
+    // after it that were clamped, for example because the clock was set back, may have been added before
+    // `date` too, so are checked against their unclamped timestamps.
+    const uint64_t clampedEnd = MIN(atomic_load(&self.ring->clampedEnd), head);
+    return bsg_breadcrumb_ring_copy(self.ring, first, MAX(end, clampedEnd), timestamp);
 }
 
 - (void)addBreadcrumb:(BugsnagBreadcrumb *)crumb {
@@ -105,76 +686,39 @@ BSG_OBJC_DIRECT_MEMBERS
     if (![crumb isValid] || ![self shouldSendBreadcrumb:crumb]) {
         return;
     }
-    NSData *data = [self dataForBreadcrumb:crumb];
-    if (!data) {
+    if (!self.ring) {
         return;
     }
-    [self addBreadcrumbWithData:data writeToDisk:[self shouldWriteToDisk]];
+    
+    const CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    char bytes[4096];
+    struct bsg_breadcrumb_buffer buffer = {.bytes = bytes, .capacity = sizeof(bytes)};
+    const int result = EncodeBreadcrumb(crumb, &buffer);
+    atomic_fetch_add(&_encodeCount, 1);
+    atomic_fetch_add(&_encodeNanoseconds, (uint64_t)((CFAbsoluteTimeGetCurrent() - startTime) * NSEC_PER_SEC));
+    
+    if (result == BSG_KSJSON_OK) {
+        bsg_breadcrumb_ring_add(self.ring, BreadcrumbTimestamp(crumb.timestamp ?: [NSDate date]),
+                                buffer.bytes, buffer.length);
+    } else {
+        bsg_log_err(@"Unable to serialize breadcrumb: %s", bsg_ksjsonstringForError(result));
+    }
+    free(buffer.heapBytes);
+}
+
+- (NSUInteger)encodeCount {
+    return atomic_load(&_encodeCount);
 }
 
-- (void)addBreadcrumbWithData:(NSData *)data writeToDisk:(BOOL)writeToDisk {
-    struct bsg_breadcrumb_list_item *newItem = calloc(1, sizeof(struct bsg_breadcrumb_list_item) + data.length + 1);
-    if (!newItem) {
+- (NSTimeInterval)encodeDuration {
+    return (NSTimeInterval)atomic_load(&_encodeNanoseconds) / NSEC_PER_SEC;
+}
+
+- (void)addBreadcrumbWithData:(NSData *)data {
+    if (!self.ring) {
         return;
     }
-    [data getBytes:newItem->jsonData length:data.length];
-    
-    @synchronized (self) {
-        const unsigned int fileNumber = self.nextFileNumber;
-        const BOOL deleteOld = fileNumber >= self.maxBreadcrumbs;
-        self.nextFileNumber = fileNumber + 1;
-        
-        struct bsg_breadcrumb_list_item *head = atomic_load(&g_breadcrumbs_head);
-        if (head) {
-            struct bsg_breadcrumb_list_item *tail = head;
-            while (tail->next) {
-                tail = tail->next;
-            }
-            tail->next = newItem;
-            if (deleteOld) {
-                atomic_store(&g_breadcrumbs_head, head->next);
-                while (atomic_load(&g_writing_crash_report)) { continue; }
-                free(head);
-            }
-        } else {
-            atomic_store(&g_breadcrumbs_head, newItem);
-        }
-        
-        if (!writeToDisk) {
-            return;
-        }
-        //
-        // Breadcrumbs are also stored on disk so that they are accessible at next
-        // launch if an OOM is detected.
-        //
-        dispatch_async(BSGGetFileSystemQueue(), ^{
-            // Avoid writing breadcrumbs that have already been deleted from the in-memory store.
-            // This can occur when breadcrumbs are being added faster than they can be written.
-            BOOL isStale;
-            @synchronized (self) {
-                unsigned int nextFileNumber = self.nextFileNumber;
-                isStale = (self.maxBreadcrumbs < nextFileNumber) && (fileNumber < (nextFileNumber - self.maxBreadcrumbs));
-            }
-            
-            NSError *error = nil;
-            
-            if (!isStale) {
-                NSString *file = [self pathForFileNumber:fileNumber];
-                // NSDataWritingAtomic not required because we no longer read the files without checking for validity
-                if (![data writeToFile:file options:0 error:&error]) {
-                    bsg_log_err(@"Unable to write breadcrumb: %@", error);
-                }
-            }
-            
-            if (deleteOld) {
-                NSString *fileToDelete = [self pathForFileNumber:fileNumber - self.maxBreadcrumbs];
-                if (![[[NSFileManager alloc] init] removeItemAtPath:fileToDelete error:&error] &&
-                    !([error.domain isEqual:NSCocoaErrorDomain] && error.code == NSFileNoSuchFileError)) {
-                    bsg_log_err(@"Unable to delete old breadcrumb: %@", error);
-                }
-            }
-        });
-    }
+    bsg_breadcrumb_ring_add(self.ring, BreadcrumbTimestamp([NSDate date]), data.bytes, data.length);
 }
 
 - (BOOL)shouldSendBreadcrumb:(BugsnagBreadcrumb *)crumb {
@@ -199,53 +743,52 @@ BSG_OBJC_DIRECT_MEMBERS
 }
 
 - (void)removeAllBreadcrumbs {
-    @synchronized (self) {
-        struct bsg_breadcrumb_list_item *item = atomic_exchange(&g_breadcrumbs_head, NULL);
-        while (item) {
-            struct bsg_breadcrumb_list_item *next = item->next;
-            free(item);
-            item = next;
-        }
-        self.nextFileNumber = 0;
+    if (self.ring) {
+        bsg_breadcrumb_ring_clear(self.ring);
     }
     dispatch_async(BSGGetFileSystemQueue(), ^{
+        // Remove files written by previous versions, which stored one breadcrumb per file.
         NSError *error = nil;
         NSString *directory = self.breadcrumbsPath;
         NSFileManager *fileManager = [NSFileManager new];
-        if (![fileManager removeItemAtPath:directory error:&error] ||
-            ![fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:&error]) {
-            bsg_log_debug(@"%s: %@", __FUNCTION__, error);
+        for (NSString *file in [fileManager contentsOfDirectoryAtPath:directory error:nil]) {
+            if (![file isEqualToString:BSGBreadcrumbJournalName] &&
+                ![fileManager removeItemAtPath:[directory stringByAppendingPathComponent:file] error:&error]) {
+                bsg_log_debug(@"%s: %@", __FUNCTION__, error);
+            }
         }
     });
 }
 
 #pragma mark - File storage
 
-- (NSData *)dataForBreadcrumb:(BugsnagBreadcrumb *)breadcrumb {
-    NSData *data = nil;
-    NSError *error = nil;
-    NSDictionary *json = [breadcrumb objectValue];
-    if (!json || !(data = BSGJSONDataFromDictionary(json, &error))) {
-        bsg_log_err(@"Unable to serialize breadcrumb: %@", error);
+- (NSArray<BugsnagBreadcrumb *> *)cachedBreadcrumbs {
+    if (!self.ring || !self.ring->persistent) {
+        return @[];
     }
-    return data;
-}
-
-- (NSString *)pathForFileNumber:(unsigned int)fileNumber {
-    return [self.breadcrumbsPath stringByAppendingPathComponent:[NSString stringWithFormat:@"%u.json", fileNumber]];
+    
+    NSArray<NSData *> *array = bsg_breadcrumb_ring_recover(self.ring);
+    if (!array.count) {
+        // The journal will be empty at the first launch after upgrading from a version that stored one breadcrumb
+        // per file. Those files are only deleted by -removeAllBreadcrumbs, which is called after this.
+        array = [self legacyBreadcrumbsJSONData];
+    }
+    return BugsnagBreadcrumbsFromJSONData(array);
 }
 
-- (NSArray<BugsnagBreadcrumb *> *)cachedBreadcrumbs {
-    NSError *error = nil;
+- (NSArray<NSData *> *)legacyBreadcrumbsJSONData {
+    NSArray<NSString *> *filenames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.breadcrumbsPath error:nil];
     
-    NSArray<NSString *> *filenames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.breadcrumbsPath error:&error];
-    if (!filenames) {
-        bsg_log_err(@"Unable to read breadcrumbs: %@", error);
-        return @[];
+    NSMutableArray<NSString *> *numberedFiles = [NSMutableArray array];
+    for (NSString *file in filenames) {
+        // Ignore partially written files, which have names like ".dat.nosync43c9.RZFc3z"
+        if (![file hasPrefix:@"."] && [file.pathExtension isEqual:@"json"]) {
+            [numberedFiles addObject:file];
+        }
     }
     
     // We cannot use NSString's -localizedStandardCompare: because its sorting may vary by locale.
-    filenames = [filenames sortedArrayUsingComparator:^NSComparisonResult(NSString *name1, NSString *name2) {
+    [numberedFiles sortUsingComparator:^NSComparisonResult(NSString *name1, NSString *name2) {
         long long value1 = [[name1 stringByDeletingPathExtension] longLongValue];
         long long value2 = [[name2 stringByDeletingPathExtension] longLongValue];
         if (value1 < value2) { return NSOrderedAscending; }
@@ -253,22 +796,28 @@ BSG_OBJC_DIRECT_MEMBERS
         return NSOrderedSame;
     }];
     
-    NSMutableArray *breadcrumbs = [NSMutableArray array];
-    
-    for (NSString *file in filenames) {
-        if ([file hasPrefix:@"."] || ![file.pathExtension isEqual:@"json"]) {
-            // Ignore partially written files, which have names like ".dat.nosync43c9.RZFc3z"
-            continue;
-        }
-        NSString *path = [self.breadcrumbsPath stringByAppendingPathComponent:file];
-        NSData *data = [NSData dataWithContentsOfFile:path options:0 error:&error];
+    NSMutableArray<NSData *> *array = [NSMutableArray arrayWithCapacity:numberedFiles.count];
+    for (NSString *file in numberedFiles) {
+        NSError *error = nil;
+        NSData *data = [NSData dataWithContentsOfFile:[self.breadcrumbsPath stringByAppendingPathComponent:file]
+                                              options:0 error:&error];
         if (!data) {
-            // If a high volume of breadcrumbs is being logged, it is normal for older files to be deleted before this thread can read them.
-            if (!(error.domain == NSCocoaErrorDomain && error.code == NSFileReadNoSuchFileError)) {
-                bsg_log_err(@"Unable to read breadcrumb: %@", error);
-            }
+            bsg_log_err(@"Unable to read breadcrumb: %@", error);
             continue;
         }
+        [array addObject:data];
+    }
+    return array;
+}
+
+@end
+
+#pragma mark -
+
+NSArray<BugsnagBreadcrumb *> * BugsnagBreadcrumbsFromJSONData(NSArray<NSData *> *array) {
+    NSMutableArray<BugsnagBreadcrumb *> *breadcrumbs = [NSMutableArray arrayWithCapacity:array.count];
+    for (NSData *data in array) {
+        NSError *error = nil;
         NSDictionary *JSONObject = BSGJSONDictionaryFromData(data, 0, &error);
         if (!JSONObject) {
             bsg_log_err(@"Unable to parse breadcrumb: %@", error);
@@ -276,32 +825,37 @@ BSG_OBJC_DIRECT_MEMBERS
         }
         BugsnagBreadcrumb *breadcrumb = [BugsnagBreadcrumb breadcrumbFromDict:JSONObject];
         if (!breadcrumb) {
-            bsg_log_err(@"Unexpected breadcrumb payload in file %@", file);
+            bsg_log_err(@"Unexpected breadcrumb payload");
             continue;
         }
         [breadcrumbs addObject:breadcrumb];
     }
-    
     return breadcrumbs;
 }
 
-@end
-
-#pragma mark -
-
 void BugsnagBreadcrumbsWriteCrashReport(const BSG_KSCrashReportWriter *writer,
                                         bool __unused requiresAsyncSafety) {
-    atomic_store(&g_writing_crash_report, true);
-    
     writer->beginArray(writer, "breadcrumbs");
     
-    struct bsg_breadcrumb_list_item *item = atomic_load(&g_breadcrumbs_head);
-    while (item) {
-        writer->addJSONElement(writer, NULL, item->jsonData);
-        item = item->next;
+    struct bsg_breadcrumb_ring *ring = atomic_load(&g_breadcrumbs_ring);
+    if (ring) {
+        // Prevent new reservations so that no record can be overwritten while it is being written.
+        // Producers that have already reserved space can only write to it, and any record that
+        // space overlaps is skipped.
+        const uint64_t arenaHead = atomic_fetch_or(&ring->header->arenaHead, BSG_BREADCRUMB_ARENA_FROZEN);
+        const uint64_t head = atomic_load(&ring->header->head);
+        for (uint64_t sequence = bsg_breadcrumb_ring_first(ring, head); sequence < head; sequence++) {
+            const uint64_t slot = atomic_load(&ring->slots[sequence % ring->capacity]);
+            if (!slot) {
+                continue;
+            }
+            const struct bsg_breadcrumb_record *record = bsg_breadcrumb_ring_record(ring, slot - 1, arenaHead);
+            if (record && bsg_breadcrumb_record_is_valid(ring, slot - 1, record, sequence)) {
+                writer->addJSONElement(writer, NULL, record->jsonData);
+            }
+        }
+        atomic_fetch_and(&ring->header->arenaHead, ~BSG_BREADCRUMB_ARENA_FROZEN);
     }
     
     writer->endContainer(writer);
-    
-    atomic_store(&g_writing_crash_report, false);
 }
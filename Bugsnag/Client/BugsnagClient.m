@@ -770,11 +770,12 @@ BSG_OBJC_DIRECT_MEMBERS
                                                handledState:handledState
                                                        user:[self.user withId]
                                                    metadata:metadata
-                                                breadcrumbs:[self breadcrumbs]
+                                                breadcrumbs:@[]
                                                      errors:@[error]
                                                     threads:threads
                                                     session:nil /* the session's event counts have not yet been incremented! */];
     event.apiKey = self.configuration.apiKey;
+    event.breadcrumbData = self.breadcrumbStore.serializedBreadcrumbs;
     event.context = context;
     event.originalError = errorOrException;
     event.correlation = correlation;
@@ -836,6 +837,13 @@ BSG_OBJC_DIRECT_MEMBERS
     event.session = self.sessionTracker.runningSession;
 
     event.usage = BSGTelemetryCreateUsage(self.configuration);
+    if (event.usage) {
+        event.usage = BSGDictMerge(@{
+            @"system": @{
+                @"breadcrumbsEncoded": @(self.breadcrumbStore.encodeCount),
+                @"breadcrumbEncodeMicros": @((NSUInteger)(self.breadcrumbStore.encodeDuration * 1000000))}
+        }, event.usage);
+    }
 
     if (event.handledState.originalUnhandledValue) {
         // Unhandled Javscript exceptions from React Native result in the app being terminated shortly after the
@@ -1073,8 +1081,6 @@ BSG_OBJC_DIRECT_MEMBERS
     BugsnagDeviceWithState *device = [self generateDeviceWithState:systemInfo];
     device.time = date;
 
-    NSArray<BugsnagBreadcrumb *> *breadcrumbs = [self.breadcrumbStore breadcrumbsBeforeDate:date];
-
     BugsnagMetadata *metadata = [self.metadata copy];
 
     [metadata addMetadata:BSGAppMetadataFromRunContext(bsg_runContext) toSection:BSGKeyApp];
@@ -1086,11 +1092,12 @@ BSG_OBJC_DIRECT_MEMBERS
                          handledState:handledState
                                  user:[self.user withId]
                              metadata:metadata
-                          breadcrumbs:breadcrumbs
+                          breadcrumbs:@[]
                                errors:@[error]
                               threads:threads
                               session:self.sessionTracker.runningSession];
 
+    self.appHangEvent.breadcrumbData = [self.breadcrumbStore serializedBreadcrumbsBeforeDate:date];
     self.appHangEvent.context = self.context;
 
     @synchronized (self.featureFlagStore) {
@@ -20,4 +20,11 @@ BSG_OBJC_DIRECT_MEMBERS
 
 @end
 
+/// Returns the JSON for the contents of a crash report file, converting reports that were written in binary form.
+/// Returns nil if a binary report is truncated or invalid.
+///
+/// If `stats` is non-NULL it receives the number of bytes of JSON produced and the time taken to convert a binary report,
+/// or nil for reports that are already JSON.
+NSData *_Nullable BSGCrashReportJSONData(NSData *data, NSDictionary *_Nullable *_Nullable stats, NSError **error);
+
 NS_ASSUME_NONNULL_END
@@ -11,6 +11,7 @@
 #import "BSGInternalErrorReporter.h"
 #import "BSGJSONSerialization.h"
 #import "BSG_KSCrashReportFields.h"
+#import "BSG_KSJSONCodec.h"
 #import "BSG_RFC3339DateTool.h"
 #import "BugsnagAppWithState.h"
 #import "BugsnagCollections.h"
@@ -51,6 +52,49 @@ static NSArray * CrashReportKeys(NSData *data, NSError *error) {
 }
 
 
+static int AppendJSONData(const char *data, size_t length, void *userData) {
+    [(__bridge NSMutableData *)userData appendBytes:data length:length];
+    return BSG_KSJSON_OK;
+}
+
+NSData * BSGCrashReportJSONData(NSData *data, NSDictionary **stats, NSError **error) {
+    if (stats) {
+        *stats = nil;
+    }
+    
+    // Binary reports begin with the CBOR self-describe tag, JSON reports with "{"
+    if (data.length < 3 || memcmp(data.bytes, "\xd9\xd9\xf7", 3) != 0) {
+        return data;
+    }
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    NSMutableData *json = [NSMutableData dataWithCapacity:data.length * 2];
+    char buffer[4096];
+    BSG_KSJSONEncodeContext context;
+    bsg_ksjsonbeginEncode(&context, false, AppendJSONData, (__bridge void *)json);
+    bsg_ksjsonsetOutputBuffer(&context, buffer, sizeof(buffer));
+    int result = bsg_ksjsontranscodeBinary(&context, data.bytes, data.length);
+    if (result == BSG_KSJSON_OK) {
+        result = bsg_ksjsonendEncode(&context);
+    }
+    if (result != BSG_KSJSON_OK) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"BSGCrashReportErrorDomain" code:result userInfo:@{
+                NSLocalizedDescriptionKey: @(bsg_ksjsonstringForError(result))}];
+        }
+        return nil;
+    }
+    
+    if (stats) {
+        *stats = @{
+            @BSG_KSCrashField_Bytes: @(json.length),
+            @BSG_KSCrashField_DurationMicros: @((NSUInteger)((CFAbsoluteTimeGetCurrent() - startTime) * 1000000))
+        };
+    }
+    return json;
+}
+
+
 BSG_OBJC_DIRECT_MEMBERS
 @implementation BSGEventUploadKSCrashReportOperation
 
@@ -91,6 +135,17 @@ BSG_OBJC_DIRECT_MEMBERS
         return nil;
     }
     
+    NSDictionary *transcodeStats = nil;
+    NSData *jsonData = BSGCrashReportJSONData(data, &transcodeStats, &error);
+    if (!jsonData) {
+        if (errorPtr) {
+            *errorPtr = error;
+        }
+        reportError(@"Binary report error", nil);
+        return nil;
+    }
+    data = jsonData;
+    
     NSDictionary *json = BSGJSONDictionaryFromData(data, 0, &error);
     if (!json) {
         if (errorPtr) {
@@ -131,6 +186,13 @@ BSG_OBJC_DIRECT_MEMBERS
         event.app.type = self.delegate.configuration.appType;
     }
     
+    NSDictionary *writerStats = crashReport[@BSG_KSCrashField_WriterStats];
+    if (event.usage && [writerStats isKindOfClass:[NSDictionary class]]) {
+        NSMutableDictionary *crashReportStats = [writerStats mutableCopy];
+        crashReportStats[@BSG_KSCrashField_Transcode] = transcodeStats;
+        event.usage = BSGDictMerge(@{@"system": @{@"crashReport": crashReportStats}}, event.usage);
+    }
+    
     return event;
 }
 
@@ -23,6 +23,15 @@
 
 static NSString * const EventPayloadVersion = @"4.0";
 
+/// Returns `payload` with `fragment` decoded in place of BSGJSONFragmentPlaceholder, so that it can be persisted.
+static NSDictionary * PayloadWithFragment(NSDictionary *payload, NSData *fragment) {
+    if (!fragment) {
+        return payload;
+    }
+    NSData *data = BSGJSONDataFromDictionaryWithFragment(payload, fragment, NULL);
+    return (data ? BSGJSONDictionaryFromData(data, 0, NULL) : nil) ?: payload;
+}
+
 typedef NS_ENUM(NSUInteger, BSGEventUploadOperationState) {
     BSGEventUploadOperationStateReady,
     BSGEventUploadOperationStateExecuting,
@@ -95,11 +104,14 @@ typedef NS_ENUM(NSUInteger, BSGEventUploadOperationState) {
     }
     
     NSDictionary *eventPayload;
+    // Breadcrumbs that have not been accessed by a callback are spliced into the payload without being parsed.
+    NSData *breadcrumbsJSON = nil, *retryBreadcrumbsJSON = nil;
     @try {
         [event truncateStrings:configuration.maxStringValueLength];
-        eventPayload = [event toJsonWithRedactedKeys:configuration.redactedKeys];
+        eventPayload = [event toJsonWithRedactedKeys:configuration.redactedKeys breadcrumbsJSON:&breadcrumbsJSON];
         if (!retryPayload || [retryPayload isEqualToDictionary:eventPayload]) {
             retryPayload = eventPayload;
+            retryBreadcrumbsJSON = breadcrumbsJSON;
         }
     } @catch (NSException *exception) {
         bsg_log_err(@"Discarding event %@ due to exception %@", self.name, exception);
@@ -131,7 +143,7 @@ typedef NS_ENUM(NSUInteger, BSGEventUploadOperationState) {
         return;
     }
     
-    NSData *data = BSGJSONDataFromDictionary(requestPayload, NULL);
+    NSData *data = BSGJSONDataFromDictionaryWithFragment(requestPayload, breadcrumbsJSON, NULL);
     if (!data) {
         bsg_log_debug(@"Encoding failed; will discard event %@", self.name);
         [self deleteEvent];
@@ -145,9 +157,9 @@ typedef NS_ENUM(NSUInteger, BSGEventUploadOperationState) {
         bsg_log_debug(@"Trimming breadcrumbs; bytesToRemove = %lu", (unsigned long)bytesToRemove);
         @try {
             [event trimBreadcrumbs:bytesToRemove];
-            eventPayload = [event toJsonWithRedactedKeys:configuration.redactedKeys];
+            eventPayload = [event toJsonWithRedactedKeys:configuration.redactedKeys breadcrumbsJSON:&breadcrumbsJSON];
             requestPayload[BSGKeyEvents] = @[eventPayload];
-            data = BSGJSONDataFromDictionary(requestPayload, NULL);
+            data = BSGJSONDataFromDictionaryWithFragment(requestPayload, breadcrumbsJSON, NULL);
         } @catch (NSException *exception) {
             bsg_log_err(@"Discarding event %@ due to exception %@", self.name, exception);
             [BSGInternalErrorReporter.sharedInstance reportException:exception diagnostics:nil groupingHash:
@@ -168,7 +180,7 @@ typedef NS_ENUM(NSUInteger, BSGEventUploadOperationState) {
                 
             case BSGDeliveryStatusFailed:
                 bsg_log_debug(@"Upload failed retryably for event %@", self.name);
-                [self prepareForRetry:retryPayload HTTPBodySize:data.length];
+                [self prepareForRetry:PayloadWithFragment(retryPayload, retryBreadcrumbsJSON) HTTPBodySize:data.length];
                 break;
                 
             case BSGDeliveryStatusUndeliverable:
@@ -261,7 +261,9 @@ BSG_OBJC_DIRECT_MEMBERS
         // Delete the report to prevent reporting a "JSON parsing error"
         NSString *crashReportFilename = [filename stringByReplacingOccurrencesOfString:RecrashReportPrefix withString:CrashReportPrefix];
         NSString *crashReportPath = [directory stringByAppendingPathComponent:crashReportFilename];
-        if (!BSGJSONDictionaryFromFile(crashReportPath, 0, nil)) {
+        NSData *crashReportData = [NSData dataWithContentsOfFile:crashReportPath];
+        NSData *crashReportJSON = crashReportData ? BSGCrashReportJSONData(crashReportData, NULL, nil) : nil;
+        if (!crashReportJSON || !BSGJSONDictionaryFromData(crashReportJSON, 0, nil)) {
             bsg_log_info(@"Deleting unparsable %@", crashReportFilename);
             if (![fileManager removeItemAtPath:crashReportPath error:&error]) {
                 bsg_log_err(@"%@", error);
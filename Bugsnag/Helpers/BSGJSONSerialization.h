@@ -23,6 +23,18 @@ NSData *_Nullable BSGJSONDataFromDictionary(NSDictionary *dictionary, NSError **
 
 NSDictionary *_Nullable BSGJSONDictionaryFromData(NSData *data, NSJSONReadingOptions options, NSError **error);
 
+/* A string value that BSGJSONDataFromDictionaryWithFragment() replaces with pre-encoded JSON.
+ *
+ * This allows large, already serialized values (such as breadcrumbs) to be written into a payload
+ * without parsing them into Foundation objects only for NSJSONSerialization to encode them again.
+ */
+extern NSString * const BSGJSONFragmentPlaceholder;
+
+/* Serializes a dictionary, splicing `fragment` (which must be valid JSON) in place of the first
+ * occurrence of BSGJSONFragmentPlaceholder. Equivalent to BSGJSONDataFromDictionary() if `fragment` is nil.
+ */
+NSData *_Nullable BSGJSONDataFromDictionaryWithFragment(NSDictionary *dictionary, NSData *_Nullable fragment, NSError **error);
+
 BOOL BSGJSONWriteToFileAtomically(NSDictionary *dictionary, NSString *file, NSError **error);
 
 NSDictionary *_Nullable BSGJSONDictionaryFromFile(NSString *file, NSJSONReadingOptions options, NSError **error);
@@ -48,6 +48,30 @@ NSData *_Nullable BSGJSONDataFromDictionary(NSDictionary *obj, NSError **error)
     return nil;
 }
 
+NSString * const BSGJSONFragmentPlaceholder = @"BSGJSONFragmentPlaceholder-5B3C9A0E-64D1-4F0B-9E2A-7C61D8F3B4A2";
+
+NSData *_Nullable BSGJSONDataFromDictionaryWithFragment(NSDictionary *obj, NSData *_Nullable fragment, NSError **error) {
+    NSData *data = BSGJSONDataFromDictionary(obj, error);
+    if (!data || !fragment) {
+        return data;
+    }
+    NSData *placeholder = [[NSString stringWithFormat:@"\"%@\"", BSGJSONFragmentPlaceholder]
+                           dataUsingEncoding:NSUTF8StringEncoding];
+    NSRange range = [data rangeOfData:placeholder options:0 range:NSMakeRange(0, data.length)];
+    if (range.location == NSNotFound) {
+        if (error) {
+            *error = [NSError errorWithDomain:@"BSGJSONSerializationErrorDomain" code:0 userInfo:@{
+                NSLocalizedDescriptionKey: @"Fragment placeholder not found"}];
+        }
+        return nil;
+    }
+    NSMutableData *result = [NSMutableData dataWithCapacity:data.length - range.length + fragment.length];
+    [result appendBytes:data.bytes length:range.location];
+    [result appendData:fragment];
+    [result appendBytes:(const char *)data.bytes + NSMaxRange(range) length:data.length - NSMaxRange(range)];
+    return result;
+}
+
 NSDictionary *_Nullable BSGJSONDictionaryFromData(NSData *data, NSJSONReadingOptions opt, NSError **error) {
     @try {
         id obj = [NSJSONSerialization JSONObjectWithData:data options:opt error:error];
@@ -32,6 +32,7 @@
 #import "BSGWatchKit.h"
 #import "BSG_KSCrashC.h"
 #import "BSG_KSCrashIdentifier.h"
+#import "BSG_KSCrashReport.h"
 
 // ============================================================================
 #pragma mark - Constants -
@@ -39,6 +40,12 @@
 
 #define BSG_kCrashStateFilenameSuffix "-CrashState.json"
 
+// Must not have a .json extension, so that it is never mistaken for a report.
+#define BSG_kPreallocatedReportFilenameSuffix "-CrashReport.preallocated"
+
+/** Large enough for typical reports; larger ones spill over to write(). */
+#define BSG_kPreallocatedReportSize (512 * 1024)
+
 @implementation BSG_KSCrash
 
 + (BSG_KSCrash *)sharedInstance {
@@ -70,6 +77,16 @@
     free(crashReportPath);
     free(recrashReportPath);
     
+    if (installedCrashTypes) {
+        NSString *preallocatedReportPath = [directory stringByAppendingPathComponent:
+                                            [stateFilePrefix stringByAppendingString:@BSG_kPreallocatedReportFilenameSuffix]];
+        // Filling the file takes a few milliseconds, so is kept off the install path.
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            bsg_kscrashreport_preallocateReportFile(preallocatedReportPath.fileSystemRepresentation,
+                                                    BSG_kPreallocatedReportSize);
+        });
+    }
+    
     NSNotificationCenter *nCenter = [NSNotificationCenter defaultCenter];
 #if TARGET_OS_OSX
     // MacOS "active" serves the same purpose as "foreground" in iOS
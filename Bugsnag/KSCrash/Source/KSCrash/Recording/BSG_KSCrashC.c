@@ -112,15 +112,15 @@ BSG_KSCrashType bsg_kscrash_install(const char *const crashReportFilePath,
     
     bsg_mach_headers_initialize();
 
+    context->config.systemInfoJSON = bsg_kssysteminfo_toJSON();
+    context->config.processName = bsg_kssysteminfo_copyProcessName();
+
     bsg_kscrash_reinstall(crashReportFilePath, recrashReportFilePath,
                           stateFilePath, crashID);
 
     BSG_KSCrashType crashTypes =
         bsg_kscrash_setHandlingCrashTypes(context->config.handlingCrashTypes);
 
-    context->config.systemInfoJSON = bsg_kssysteminfo_toJSON();
-    context->config.processName = bsg_kssysteminfo_copyProcessName();
-
     BSG_KSLOG_DEBUG("Installation complete.");
     return crashTypes;
 }
@@ -137,6 +137,7 @@ void bsg_kscrash_reinstall(const char *const crashReportFilePath,
     bsg_ksstring_replace(&bsg_g_stateFilePath, stateFilePath);
 
     BSG_KSCrash_Context *context = crashContext();
+    context->config.generation++;
     bsg_ksstring_replace(&context->config.crashReportFilePath,
                          crashReportFilePath);
     bsg_ksstring_replace(&context->config.recrashReportFilePath,
@@ -146,6 +147,8 @@ void bsg_kscrash_reinstall(const char *const crashReportFilePath,
     if (!bsg_kscrashstate_init(bsg_g_stateFilePath, &context->state)) {
         BSG_KSLOG_ERROR("Failed to initialize persistent crash state");
     }
+
+    bsg_kscrashreport_renderTemplate(context);
 }
 
 BSG_KSCrashType bsg_kscrash_setHandlingCrashTypes(BSG_KSCrashType crashTypes) {
@@ -176,3 +179,12 @@ void bsg_kscrash_setThreadTracingEnabled(bool threadTracingEnabled) {
     (void)threadTracingEnabled;
 #endif
 }
+
+void bsg_kscrash_setWriteBinaryReports(bool writeBinaryReports) {
+    BSG_KSCrash_Context *context = crashContext();
+    context->config.generation++;
+    context->config.writeBinaryReports = writeBinaryReports;
+    if (bsg_g_installed) {
+        bsg_kscrashreport_renderTemplate(context);
+    }
+}
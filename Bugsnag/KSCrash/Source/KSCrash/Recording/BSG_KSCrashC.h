@@ -108,6 +108,14 @@ void bsg_kscrash_setCrashNotifyCallback(
 
 void bsg_kscrash_setThreadTracingEnabled(bool threadTracingEnabled);
 
+/** Write crash reports in a compact binary encoding rather than JSON text,
+ * which is cheaper to produce at crash time. Binary reports are converted to
+ * JSON when they are loaded.
+ *
+ * Default: false
+ */
+void bsg_kscrash_setWriteBinaryReports(bool writeBinaryReports);
+
 /**
  * The current crash context
  */
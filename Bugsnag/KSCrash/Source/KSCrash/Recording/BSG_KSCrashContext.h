@@ -68,6 +68,18 @@ typedef struct {
      * File path to write the recrash report, if the crash reporter crashes
      */
     char *recrashReportFilePath;
+
+    /**
+     * Write standard reports in compact binary form instead of JSON text.
+     * They are converted to JSON by bsg_ksjsontranscodeBinary() before use.
+     */
+    bool writeBinaryReports;
+
+    /**
+     * Incremented before any value written to the report template changes, so
+     * that a template rendered from older values is never used.
+     */
+    unsigned generation;
 } BSG_KSCrash_Configuration;
 
 /** Contextual data used by the crash report writer.
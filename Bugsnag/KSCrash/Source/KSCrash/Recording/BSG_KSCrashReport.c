@@ -47,7 +47,16 @@
 #include "BSGDefines.h"
 #include "BSGRunContext.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <mach-o/loader.h>
+#include <mach/mach_time.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 #ifdef __arm64__
@@ -68,12 +77,20 @@ typedef ucontext_t SignalUserContext;
 /** Maximum depth allowed for a backtrace. */
 #define BSG_kMaxBacktraceDepth 150
 
-/** Length at which we consider a backtrace to represent a stack overflow.
- * If it reaches this point, we start cutting off from the top of the stack
- * rather than the bottom.
+/** How many of the outermost entries to keep when a backtrace is longer than
+ * BSG_kMaxBacktraceDepth. The rest of the space holds the innermost entries,
+ * so a deep recursion is reported along with where it started.
  */
+#define BSG_kBacktraceBottomEntries 50
+
+/** Length at which we consider a backtrace to represent a stack overflow. */
 #define BSG_kStackOverflowThreshold 200
 
+/** The size of the encoder's output buffer while writing a report, and of the
+ * blocks files are read in. Blocks that fill the output buffer bypass it.
+ */
+#define BSG_kReportBufferSize 4096
+
 typedef struct {
     char *data;
     size_t allocated_size;
@@ -90,6 +107,64 @@ typedef struct {
 static const char bsg_g_hexNybbles[] = {'0', '1', '2', '3', '4', '5', '6', '7',
                                         '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
 
+#define BSG_KSCRW_ENCODED_KEY(NAME)                                            \
+    {BSG_KSJSON_ENCODED_NAME(BSG_KSCrashField_##NAME),                         \
+     sizeof(BSG_KSJSON_ENCODED_NAME(BSG_KSCrashField_##NAME)) - 1,             \
+     BSG_KSCrashField_##NAME},
+
+/** Pre-encoded names for BSG_KSCrashKey, indexed by key. */
+static const struct {
+    const char *name;
+    size_t length;
+    /** The plain field name, used when writing binary reports. */
+    const char *field;
+} bsg_g_encodedKeys[BSG_KSCrashKeyCount] = {
+    BSG_KSCrashEncodedFields(BSG_KSCRW_ENCODED_KEY)
+};
+
+#undef BSG_KSCRW_ENCODED_KEY
+
+// ============================================================================
+#pragma mark - Globals -
+// ============================================================================
+
+/** A file created and mapped ahead of time for the next standard report.
+ * It may be prepared on a background thread, so map is published last and
+ * claimed by the report writer with an atomic exchange.
+ */
+static struct {
+    char *path;
+    int fd;
+    _Atomic(char *) map;
+    size_t size;
+} bsg_g_preallocatedReport = {NULL, -1, NULL, 0};
+
+/** The parts of a standard report that stay the same from install until the
+ * config changes, encoded ahead of time so they can be copied into a report.
+ */
+typedef struct {
+    /** The generation of the config the template was rendered from. */
+    unsigned generation;
+    bool binary;
+    /** The length of the "report" object members at the start of data. */
+    size_t reportInfoLength;
+    /** The length of the top level members that follow them. */
+    size_t staticFieldsLength;
+    char data[];
+} BSG_KSCrashReportTemplate;
+
+static _Atomic(BSG_KSCrashReportTemplate *) bsg_g_reportTemplate;
+
+/** The crashed thread's backtrace, walked once when checking for a stack
+ * overflow and reused when the thread is written.
+ */
+static struct {
+    thread_t thread;
+    uintptr_t entries[BSG_kMaxBacktraceDepth];
+    int length;
+    int depth;
+} bsg_g_crashedThreadBacktrace;
+
 // ============================================================================
 #pragma mark - Runtime Config -
 // ============================================================================
@@ -126,6 +201,32 @@ void bsg_kscrw_i_addStringElement(const BSG_KSCrashReportWriter *const writer,
                                BSG_KSJSON_SIZE_AUTOMATIC);
 }
 
+/** Pass the contents of a file to the encoder in large blocks.
+ *
+ * The blocks are as large as the encoder's output buffer, so what is buffered
+ * is flushed and each full block goes straight to the report file.
+ *
+ * @param context The encoding context.
+ *
+ * @param fd The file to read.
+ *
+ * @param append The encoder function to pass each block to.
+ *
+ * @return true if the whole file was read and encoded.
+ */
+bool bsg_kscrw_i_encodeFileContents(
+    BSG_KSJSONEncodeContext *const context, const int fd,
+    int (*const append)(BSG_KSJSONEncodeContext *, const char *, size_t)) {
+    char buffer[BSG_kReportBufferSize];
+    ssize_t bytesRead;
+    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (append(context, buffer, (size_t)bytesRead) != BSG_KSJSON_OK) {
+            return false;
+        }
+    }
+    return bytesRead == 0;
+}
+
 void bsg_kscrw_i_addTextFileElement(const BSG_KSCrashReportWriter *const writer,
                                     const char *const key,
                                     const char *const filePath) {
@@ -142,15 +243,9 @@ void bsg_kscrw_i_addTextFileElement(const BSG_KSCrashReportWriter *const writer,
         goto done;
     }
 
-    char buffer[512];
-    ssize_t bytesRead;
-    for (bytesRead = read(fd, buffer, sizeof(buffer)); bytesRead > 0;
-         bytesRead = read(fd, buffer, sizeof(buffer))) {
-        if (bsg_ksjsonappendStringElement(bsg_getJsonContext(writer), buffer,
-                                          (size_t)bytesRead) != BSG_KSJSON_OK) {
-            BSG_KSLOG_ERROR("Could not append string element");
-            goto done;
-        }
+    if (!bsg_kscrw_i_encodeFileContents(bsg_getJsonContext(writer), fd,
+                                        bsg_ksjsonappendStringElement)) {
+        BSG_KSLOG_ERROR("Could not append string element");
     }
 
 done:
@@ -179,6 +274,45 @@ void bsg_kscrw_i_endDataElement(const BSG_KSCrashReportWriter *const writer) {
     bsg_ksjsonendDataElement(bsg_getJsonContext(writer));
 }
 
+/** Format a binary UUID as a string.
+ *
+ * @param value A pointer to the binary UUID data.
+ *
+ * @param dst A buffer of at least 36 bytes. No NUL terminator is written.
+ *
+ * @return The length of the string written to dst.
+ */
+size_t bsg_kscrw_i_formatUUID(const unsigned char *const value,
+                              char *const dst) {
+    const unsigned char *src = value;
+    char *out = dst;
+    for (int i = 0; i < 4; i++) {
+        *out++ = bsg_g_hexNybbles[(*src >> 4) & 15];
+        *out++ = bsg_g_hexNybbles[(*src++) & 15];
+    }
+    *out++ = '-';
+    for (int i = 0; i < 2; i++) {
+        *out++ = bsg_g_hexNybbles[(*src >> 4) & 15];
+        *out++ = bsg_g_hexNybbles[(*src++) & 15];
+    }
+    *out++ = '-';
+    for (int i = 0; i < 2; i++) {
+        *out++ = bsg_g_hexNybbles[(*src >> 4) & 15];
+        *out++ = bsg_g_hexNybbles[(*src++) & 15];
+    }
+    *out++ = '-';
+    for (int i = 0; i < 2; i++) {
+        *out++ = bsg_g_hexNybbles[(*src >> 4) & 15];
+        *out++ = bsg_g_hexNybbles[(*src++) & 15];
+    }
+    *out++ = '-';
+    for (int i = 0; i < 6; i++) {
+        *out++ = bsg_g_hexNybbles[(*src >> 4) & 15];
+        *out++ = bsg_g_hexNybbles[(*src++) & 15];
+    }
+    return (size_t)(out - dst);
+}
+
 void bsg_kscrw_i_addUUIDElement(const BSG_KSCrashReportWriter *const writer,
                                 const char *const key,
                                 const unsigned char *const value) {
@@ -186,35 +320,8 @@ void bsg_kscrw_i_addUUIDElement(const BSG_KSCrashReportWriter *const writer,
         bsg_ksjsonaddNullElement(bsg_getJsonContext(writer), key);
     } else {
         char uuidBuffer[37];
-        const unsigned char *src = value;
-        char *dst = uuidBuffer;
-        for (int i = 0; i < 4; i++) {
-            *dst++ = bsg_g_hexNybbles[(*src >> 4) & 15];
-            *dst++ = bsg_g_hexNybbles[(*src++) & 15];
-        }
-        *dst++ = '-';
-        for (int i = 0; i < 2; i++) {
-            *dst++ = bsg_g_hexNybbles[(*src >> 4) & 15];
-            *dst++ = bsg_g_hexNybbles[(*src++) & 15];
-        }
-        *dst++ = '-';
-        for (int i = 0; i < 2; i++) {
-            *dst++ = bsg_g_hexNybbles[(*src >> 4) & 15];
-            *dst++ = bsg_g_hexNybbles[(*src++) & 15];
-        }
-        *dst++ = '-';
-        for (int i = 0; i < 2; i++) {
-            *dst++ = bsg_g_hexNybbles[(*src >> 4) & 15];
-            *dst++ = bsg_g_hexNybbles[(*src++) & 15];
-        }
-        *dst++ = '-';
-        for (int i = 0; i < 6; i++) {
-            *dst++ = bsg_g_hexNybbles[(*src >> 4) & 15];
-            *dst++ = bsg_g_hexNybbles[(*src++) & 15];
-        }
-
         bsg_ksjsonaddStringElement(bsg_getJsonContext(writer), key, uuidBuffer,
-                                   (size_t)(dst - uuidBuffer));
+                                   bsg_kscrw_i_formatUUID(value, uuidBuffer));
     }
 }
 
@@ -263,14 +370,9 @@ void bsg_kscrw_i_addJSONElementFromFile(
         goto done;
     }
 
-    char buffer[512];
-    ssize_t bytesRead;
-    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {
-        if (bsg_ksjsonaddRawJSONData(bsg_getJsonContext(writer), buffer,
-                                     (size_t)bytesRead) != BSG_KSJSON_OK) {
-            BSG_KSLOG_ERROR("Could not append JSON data");
-            goto done;
-        }
+    if (!bsg_kscrw_i_encodeFileContents(bsg_getJsonContext(writer), fd,
+                                        bsg_ksjsonaddRawJSONData)) {
+        BSG_KSLOG_ERROR("Could not append JSON data");
     }
 
 done:
@@ -297,6 +399,146 @@ int bsg_kscrw_i_addJSONData(const char *const data, const size_t length,
     return success ? BSG_KSJSON_OK : BSG_KSJSON_ERROR_CANNOT_ADD_DATA;
 }
 
+/** A growable memory buffer for encoding outside of a crash. */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} BSG_KSCrashReportBuffer;
+
+int bsg_kscrw_i_addJSONDataToBuffer(const char *const data,
+                                    const size_t length,
+                                    void *const userData) {
+    BSG_KSCrashReportBuffer *buffer = userData;
+    if (buffer->length + length > buffer->capacity) {
+        const size_t capacity =
+            MAX(buffer->capacity * 2, buffer->length + length);
+        char *newData = realloc(buffer->data, capacity);
+        if (newData == NULL) {
+            buffer->failed = true;
+            return BSG_KSJSON_ERROR_CANNOT_ADD_DATA;
+        }
+        buffer->data = newData;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return BSG_KSJSON_OK;
+}
+
+#pragma mark Encoded Keys
+
+/* These mirror the callbacks above but take a BSG_KSCrashKey, whose name is
+ * written from bsg_g_encodedKeys with a single addJSONData call. They are used
+ * for the fields that are repeated for every frame, thread and image.
+ *
+ * Binary reports need no quoting or formatting, so values are written through
+ * the regular callbacks instead.
+ */
+
+#define bsg_kscrw_i_isBinary(WRITER) (bsg_getJsonContext(WRITER)->binary)
+
+#define bsg_kscrw_i_beginKey(WRITER, KEY)                                      \
+    bsg_ksjsonbeginEncodedElement(bsg_getJsonContext(WRITER),                  \
+                                  bsg_g_encodedKeys[KEY].name,                 \
+                                  bsg_g_encodedKeys[KEY].length)
+
+void bsg_kscrw_i_addBooleanElementForKey(
+    const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key,
+    const bool value) {
+    if (bsg_kscrw_i_isBinary(writer)) {
+        bsg_kscrw_i_addBooleanElement(writer, bsg_g_encodedKeys[key].field,
+                                      value);
+        return;
+    }
+    if (bsg_kscrw_i_beginKey(writer, key) == BSG_KSJSON_OK) {
+        bsg_ksjsonaddRawJSONData(bsg_getJsonContext(writer),
+                                 value ? "true" : "false", value ? 4 : 5);
+    }
+}
+
+void bsg_kscrw_i_addIntegerElementForKey(
+    const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key,
+    const long long value) {
+    if (bsg_kscrw_i_isBinary(writer)) {
+        bsg_kscrw_i_addIntegerElement(writer, bsg_g_encodedKeys[key].field,
+                                      value);
+        return;
+    }
+    if (bsg_kscrw_i_beginKey(writer, key) == BSG_KSJSON_OK) {
+        char buff[30];
+        bsg_ksjsonaddRawJSONData(bsg_getJsonContext(writer), buff,
+                                 bsg_int64_to_string(value, buff));
+    }
+}
+
+void bsg_kscrw_i_addUIntegerElementForKey(
+    const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key,
+    const unsigned long long value) {
+    if (bsg_kscrw_i_isBinary(writer)) {
+        bsg_kscrw_i_addUIntegerElement(writer, bsg_g_encodedKeys[key].field,
+                                       value);
+        return;
+    }
+    if (bsg_kscrw_i_beginKey(writer, key) == BSG_KSJSON_OK) {
+        char buff[30];
+        bsg_ksjsonaddRawJSONData(bsg_getJsonContext(writer), buff,
+                                 bsg_uint64_to_string(value, buff));
+    }
+}
+
+void bsg_kscrw_i_addStringElementForKey(
+    const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key,
+    const char *const value, const size_t length) {
+    BSG_KSJSONEncodeContext *context = bsg_getJsonContext(writer);
+    if (context->binary) {
+        bsg_ksjsonaddStringElement(context, bsg_g_encodedKeys[key].field,
+                                   value, length);
+        return;
+    }
+    if (bsg_kscrw_i_beginKey(writer, key) != BSG_KSJSON_OK) {
+        return;
+    }
+    if (value == NULL) {
+        bsg_ksjsonaddRawJSONData(context, "null", 4);
+        return;
+    }
+    if (bsg_ksjsonaddRawJSONData(context, "\"", 1) == BSG_KSJSON_OK &&
+        bsg_ksjsonappendStringElement(
+            context, value,
+            length == BSG_KSJSON_SIZE_AUTOMATIC ? strlen(value) : length) ==
+            BSG_KSJSON_OK) {
+        bsg_ksjsonendStringElement(context);
+    }
+}
+
+void bsg_kscrw_i_addUUIDElementForKey(
+    const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key,
+    const unsigned char *const value) {
+    if (value == NULL) {
+        bsg_kscrw_i_addStringElementForKey(writer, key, NULL, 0);
+    } else {
+        char uuidBuffer[37];
+        bsg_kscrw_i_addStringElementForKey(
+            writer, key, uuidBuffer, bsg_kscrw_i_formatUUID(value, uuidBuffer));
+    }
+}
+
+void bsg_kscrw_i_beginObjectForKey(const BSG_KSCrashReportWriter *const writer,
+                                   const BSG_KSCrashKey key) {
+    bsg_ksjsonbeginEncodedObject(bsg_getJsonContext(writer),
+                                 bsg_g_encodedKeys[key].name,
+                                 bsg_g_encodedKeys[key].length);
+}
+
+void bsg_kscrw_i_beginArrayForKey(const BSG_KSCrashReportWriter *const writer,
+                                  const BSG_KSCrashKey key) {
+    bsg_ksjsonbeginEncodedArray(bsg_getJsonContext(writer),
+                                bsg_g_encodedKeys[key].name,
+                                bsg_g_encodedKeys[key].length);
+}
+
 // ============================================================================
 #pragma mark - Utility -
 // ============================================================================
@@ -383,8 +625,8 @@ BSG_STRUCT_MCONTEXT_L *bsg_kscrw_i_getMachineContext(
  * @param backtraceLength In: The length of backtraceBuffer.
  *                        Out: The length of the backtrace.
  *
- * @param skippedEntries Out: The number of entries that were skipped due to
- *                             stack overflow.
+ * @param skippedEntries Out: The number of entries that were left out between
+ *                             the top and bottom of a long backtrace.
  *
  * @return The backtrace, or NULL if not found.
  */
@@ -402,19 +644,30 @@ uintptr_t *bsg_kscrw_i_getBacktrace(
         }
     }
 
-    int actualSkippedEntries = 0;
-
-    if (machineContext != NULL) {
-        int actualLength = bsg_ksbt_backtraceLength(machineContext);
-        if (actualLength >= BSG_kStackOverflowThreshold) {
-            actualSkippedEntries = actualLength - *backtraceLength;
+    if (thread != MACH_PORT_NULL &&
+        thread == bsg_g_crashedThreadBacktrace.thread &&
+        bsg_g_crashedThreadBacktrace.length <= *backtraceLength) {
+        *backtraceLength = bsg_g_crashedThreadBacktrace.length;
+        if (skippedEntries != NULL) {
+            *skippedEntries = bsg_g_crashedThreadBacktrace.depth -
+                              bsg_g_crashedThreadBacktrace.length;
         }
+        return bsg_g_crashedThreadBacktrace.entries;
+    }
 
-        *backtraceLength =
-            bsg_ksbt_backtraceThreadState(machineContext, backtraceBuffer,
-                                          actualSkippedEntries, *backtraceLength);
+    if (machineContext != NULL) {
+        int depth = 0;
+        // A buffer with no room beyond the outermost entries keeps only the
+        // innermost ones.
+        const int bottomEntries =
+            *backtraceLength > BSG_kBacktraceBottomEntries
+                ? BSG_kBacktraceBottomEntries
+                : 0;
+        *backtraceLength = bsg_ksbt_backtraceThreadStateRetaining(
+            machineContext, backtraceBuffer, *backtraceLength - bottomEntries,
+            bottomEntries, &depth);
         if (skippedEntries != NULL) {
-            *skippedEntries = actualSkippedEntries;
+            *skippedEntries = depth - *backtraceLength;
         }
         return backtraceBuffer;
      }
@@ -423,6 +676,9 @@ uintptr_t *bsg_kscrw_i_getBacktrace(
 }
 
 /** Check if the stack for the specified thread has overflowed.
+ *
+ * The thread's backtrace is kept for bsg_kscrw_i_getBacktrace(), so that it
+ * does not have to walk the stack again.
  *
  * @param crash The crash handler context.
  *
@@ -432,6 +688,8 @@ uintptr_t *bsg_kscrw_i_getBacktrace(
  */
 bool bsg_kscrw_i_isStackOverflow(const BSG_KSCrash_SentryContext *const crash,
                                  const thread_t thread) {
+    bsg_g_crashedThreadBacktrace.thread = MACH_PORT_NULL;
+
     BSG_STRUCT_MCONTEXT_L concreteMachineContext;
     BSG_STRUCT_MCONTEXT_L *machineContext =
         bsg_kscrw_i_getMachineContext(crash, thread, &concreteMachineContext);
@@ -439,8 +697,14 @@ bool bsg_kscrw_i_isStackOverflow(const BSG_KSCrash_SentryContext *const crash,
         return false;
     }
 
-    return bsg_ksbt_isBacktraceTooLong(machineContext,
-                                       BSG_kStackOverflowThreshold);
+    bsg_g_crashedThreadBacktrace.length =
+        bsg_ksbt_backtraceThreadStateRetaining(
+            machineContext, bsg_g_crashedThreadBacktrace.entries,
+            BSG_kMaxBacktraceDepth - BSG_kBacktraceBottomEntries,
+            BSG_kBacktraceBottomEntries, &bsg_g_crashedThreadBacktrace.depth);
+    bsg_g_crashedThreadBacktrace.thread = thread;
+
+    return bsg_g_crashedThreadBacktrace.depth >= BSG_kStackOverflowThreshold;
 }
 
 // ============================================================================
@@ -467,9 +731,9 @@ void bsg_kscrw_i_writeTraceInfo(const BSG_KSCrash_Context *crashContext,
 
 bool bsg_kscrw_i_exceedsBufferLen(const size_t length);
 
-void bsg_kscrashreport_writeKSCrashFields(BSG_KSCrash_Context *crashContext,
-                                          BSG_KSCrashReportWriter *writer,
-                                          const char *const path);
+void bsg_kscrashreport_writeKSCrashFields(
+    BSG_KSCrash_Context *crashContext, BSG_KSCrashReportWriter *writer,
+    const char *const path, const BSG_KSCrashReportTemplate *const template);
 
 #pragma mark Backtrace
 
@@ -490,23 +754,27 @@ void bsg_kscrw_i_writeBacktraceEntry(
     {
         if (info->image && info->image->header) {
             info->image->inCrashReport = true;
-            writer->addUIntegerElement(writer, BSG_KSCrashField_ObjectAddr,
-                                       (uintptr_t)info->image->header);
+            bsg_kscrw_i_addUIntegerElementForKey(
+                writer, BSG_KSCrashKey_ObjectAddr,
+                (uintptr_t)info->image->header);
         }
         if (info->image && info->image->name) {
-            writer->addStringElement(writer, BSG_KSCrashField_ObjectName,
-                                     bsg_ksfulastPathEntry(info->image->name));
+            bsg_kscrw_i_addStringElementForKey(
+                writer, BSG_KSCrashKey_ObjectName,
+                bsg_ksfulastPathEntry(info->image->name),
+                BSG_KSJSON_SIZE_AUTOMATIC);
         }
         if (info->function_address) {
-            writer->addUIntegerElement(writer, BSG_KSCrashField_SymbolAddr,
-                                       info->function_address);
+            bsg_kscrw_i_addUIntegerElementForKey(
+                writer, BSG_KSCrashKey_SymbolAddr, info->function_address);
         }
         if (info->function_name) {
-            writer->addStringElement(writer, BSG_KSCrashField_SymbolName,
-                                     info->function_name);
+            bsg_kscrw_i_addStringElementForKey(
+                writer, BSG_KSCrashKey_SymbolName, info->function_name,
+                BSG_KSJSON_SIZE_AUTOMATIC);
         }
-        writer->addUIntegerElement(writer, BSG_KSCrashField_InstructionAddr,
-                                   address);
+        bsg_kscrw_i_addUIntegerElementForKey(
+            writer, BSG_KSCrashKey_InstructionAddr, address);
     }
     writer->endContainer(writer);
 }
@@ -521,8 +789,8 @@ void bsg_kscrw_i_writeBacktraceEntry(
  *
  * @param backtraceLength Length of the backtrace.
  *
- * @param skippedEntries The number of entries that were skipped before the
- *                       beginning of backtrace.
+ * @param skippedEntries The number of entries that were left out between the
+ *                       top and bottom of the backtrace.
  */
 void bsg_kscrw_i_writeBacktrace(const BSG_KSCrashReportWriter *const writer,
                                 const char *const key,
@@ -531,12 +799,13 @@ void bsg_kscrw_i_writeBacktrace(const BSG_KSCrashReportWriter *const writer,
                                 const int skippedEntries) {
     writer->beginObject(writer, key);
     {
-        writer->beginArray(writer, BSG_KSCrashField_Contents);
+        bsg_kscrw_i_beginArrayForKey(writer, BSG_KSCrashKey_Contents);
         {
             if (backtraceLength > 0) {
+                // The first entry is always the instruction address.
                 struct bsg_symbolicate_result symbolicated[backtraceLength];
                 bsg_ksbt_symbolicate(backtrace, symbolicated, backtraceLength,
-                                     skippedEntries);
+                                     0);
 
                 for (int i = 0; i < backtraceLength; i++) {
                     bsg_kscrw_i_writeBacktraceEntry(writer, NULL, backtrace[i],
@@ -545,8 +814,8 @@ void bsg_kscrw_i_writeBacktrace(const BSG_KSCrashReportWriter *const writer,
             }
         }
         writer->endContainer(writer);
-        writer->addIntegerElement(writer, BSG_KSCrashField_Skipped,
-                                  skippedEntries);
+        bsg_kscrw_i_addIntegerElementForKey(writer, BSG_KSCrashKey_Skipped,
+                                            skippedEntries);
     }
     writer->endContainer(writer);
 }
@@ -574,8 +843,8 @@ void bsg_kscrw_i_writeStackOverflow(
 
     writer->beginObject(writer, key);
     {
-        writer->addBooleanElement(writer, BSG_KSCrashField_Overflow,
-                                  isStackOverflow);
+        bsg_kscrw_i_addBooleanElementForKey(writer, BSG_KSCrashKey_Overflow,
+                                            isStackOverflow);
     }
     writer->endContainer(writer);
 }
@@ -735,13 +1004,14 @@ void bsg_kscrw_i_writeThread(const BSG_KSCrashReportWriter *const writer,
                                        machineContext, isCrashedThread);
         }
         if (state != NULL) {
-            writer->addStringElement(writer, BSG_KSCrashField_State, state);
+            bsg_kscrw_i_addStringElementForKey(writer, BSG_KSCrashKey_State,
+                                               state, BSG_KSJSON_SIZE_AUTOMATIC);
         }
-        writer->addIntegerElement(writer, BSG_KSCrashField_Index, index);
-        writer->addBooleanElement(writer, BSG_KSCrashField_Crashed,
-                                  isCrashedThread);
-        writer->addBooleanElement(writer, BSG_KSCrashField_CurrentThread,
-                                  isSelfThread);
+        bsg_kscrw_i_addIntegerElementForKey(writer, BSG_KSCrashKey_Index, index);
+        bsg_kscrw_i_addBooleanElementForKey(writer, BSG_KSCrashKey_Crashed,
+                                            isCrashedThread);
+        bsg_kscrw_i_addBooleanElementForKey(writer, BSG_KSCrashKey_CurrentThread,
+                                            isSelfThread);
 
         // pthread_getname_np() acquires no locks if passed pthread_self() as
         // of libpthread-330.201.1 (macOS 10.14 / iOS 12)
@@ -753,7 +1023,8 @@ void bsg_kscrw_i_writeThread(const BSG_KSCrashReportWriter *const writer,
         }
         if (isCrashedThread && machineContext != NULL) {
             bsg_kscrw_i_writeStackOverflow(writer, BSG_KSCrashField_Stack,
-                                           machineContext, skippedEntries > 0);
+                                           machineContext,
+                                           crash->isStackOverflow);
         }
         if (isCrashedThread && backtrace && backtraceLength) {
             bsg_kscrw_i_writeCrashInfoMessage(writer, BSG_KSCrashField_CrashInfoMessage,
@@ -828,15 +1099,23 @@ void bsg_kscrw_i_writeBinaryImage(const BSG_KSCrashReportWriter *const writer,
                                   const char *const key,
                                   const BSG_Mach_Header_Info *img)
 {
+    size_t jsonLength = 0;
+    const char *json = bsg_mach_headers_get_json(img, &jsonLength);
+    if (json != NULL) {
+        bsg_ksjsonaddJSONElement(bsg_getJsonContext(writer), key, json,
+                                 jsonLength);
+        return;
+    }
+
     writer->beginObject(writer, key);
     {
-        writer->addUIntegerElement(writer, BSG_KSCrashField_ImageAddress, (uintptr_t)img->header);
-        writer->addUIntegerElement(writer, BSG_KSCrashField_ImageVmAddress,          img->imageVmAddr);
-        writer->addUIntegerElement(writer, BSG_KSCrashField_ImageSize,               img->imageSize);
-        writer->addStringElement(writer, BSG_KSCrashField_Name,                      img->name);
-        writer->addUUIDElement(writer, BSG_KSCrashField_UUID,                        img->uuid);
-        writer->addIntegerElement(writer, BSG_KSCrashField_CPUType,                  img->header->cputype);
-        writer->addIntegerElement(writer, BSG_KSCrashField_CPUSubType,               img->header->cpusubtype);
+        bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_ImageAddress,   (uintptr_t)img->header);
+        bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_ImageVmAddress, img->imageVmAddr);
+        bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_ImageSize,      img->imageSize);
+        bsg_kscrw_i_addStringElementForKey(writer, BSG_KSCrashKey_Name,             img->name, BSG_KSJSON_SIZE_AUTOMATIC);
+        bsg_kscrw_i_addUUIDElementForKey(writer, BSG_KSCrashKey_UUID,               img->uuid);
+        bsg_kscrw_i_addIntegerElementForKey(writer, BSG_KSCrashKey_CPUType,         img->header->cputype);
+        bsg_kscrw_i_addIntegerElementForKey(writer, BSG_KSCrashKey_CPUSubType,      img->header->cpusubtype);
     }
     writer->endContainer(writer);
 }
@@ -1085,6 +1364,45 @@ void bsg_kscrw_i_writeProcessState(const BSG_KSCrashReportWriter *const writer,
     writer->endContainer(writer);
 }
 
+/** Write the report information that is known before the crash.
+ *
+ * @param writer The writer.
+ *
+ * @param type The report type.
+ *
+ * @param reportID The report ID.
+ *
+ * @param processName The process name.
+ */
+void bsg_kscrw_i_writeStaticReportInfo(
+    const BSG_KSCrashReportWriter *const writer, const char *const type,
+    const char *const reportID, const char *const processName) {
+    writer->addStringElement(writer, BSG_KSCrashField_Version,
+                             BSG_KSCRASH_REPORT_VERSION);
+    writer->addStringElement(writer, BSG_KSCrashField_ID, reportID);
+    writer->addStringElement(writer, BSG_KSCrashField_ProcessName,
+                             processName);
+    writer->addStringElement(writer, BSG_KSCrashField_Type, type);
+}
+
+/** Write the time at which the report is being written.
+ *
+ * @param writer The writer.
+ */
+void bsg_kscrw_i_writeReportTimestamps(
+    const BSG_KSCrashReportWriter *const writer) {
+    writer->addIntegerElement(writer, BSG_KSCrashField_Timestamp, time(NULL));
+    // gettimeofday() is not documented async-signal safe in the sigaction
+    // man page, but times() is and its implementation calls gettimeofday()
+    // so it's reasonable to assume that it is in fact safe.
+    struct timeval t;
+    if (!gettimeofday(&t, NULL)) {
+        writer->addIntegerElement(writer, BSG_KSCrashField_Timestamp_Millis,
+                                  (long long)t.tv_sec * 1000 +
+                                  (long long)t.tv_usec / 1000);
+    }
+}
+
 /** Write basic report information.
  *
  * @param writer The writer.
@@ -1101,23 +1419,67 @@ void bsg_kscrw_i_writeReportInfo(const BSG_KSCrashReportWriter *const writer,
                                  const char *const processName) {
     writer->beginObject(writer, key);
     {
-        writer->addStringElement(writer, BSG_KSCrashField_Version,
-                                 BSG_KSCRASH_REPORT_VERSION);
-        writer->addStringElement(writer, BSG_KSCrashField_ID, reportID);
-        writer->addStringElement(writer, BSG_KSCrashField_ProcessName,
-                                 processName);
-        writer->addIntegerElement(writer, BSG_KSCrashField_Timestamp,
-                                  time(NULL));
-        // gettimeofday() is not documented async-signal safe in the sigaction
-        // man page, but times() is and its implementation calls gettimeofday()
-        // so it's reasonable to assume that it is in fact safe.
-        struct timeval t;
-        if (!gettimeofday(&t, NULL)) {
-            writer->addIntegerElement(writer, BSG_KSCrashField_Timestamp_Millis,
-                                      (long long)t.tv_sec * 1000 +
-                                      (long long)t.tv_usec / 1000);
-        }
-        writer->addStringElement(writer, BSG_KSCrashField_Type, type);
+        bsg_kscrw_i_writeStaticReportInfo(writer, type, reportID, processName);
+        bsg_kscrw_i_writeReportTimestamps(writer);
+    }
+    writer->endContainer(writer);
+}
+
+/** Write the top level fields that are known before the crash.
+ *
+ * @param crashContext The crash context.
+ *
+ * @param writer The writer.
+ */
+void bsg_kscrw_i_writeStaticFields(
+    const BSG_KSCrash_Context *const crashContext,
+    const BSG_KSCrashReportWriter *const writer) {
+    bsg_kscrw_i_writeProcessState(writer, BSG_KSCrashField_ProcessState);
+
+    if (crashContext->config.systemInfoJSON != NULL) {
+        bsg_kscrw_i_addJSONElement(writer, BSG_KSCrashField_System,
+                                   crashContext->config.systemInfoJSON);
+    }
+}
+
+#pragma mark Writer Stats
+
+/** Write the format, size and duration of the report so far.
+ *
+ * @param writer The writer.
+ *
+ * @param key The object key.
+ *
+ * @param file The file being written to.
+ *
+ * @param startTime When writing began (mach_absolute_time()).
+ *
+ * @param templateBytes The number of bytes copied from the report template.
+ */
+void bsg_kscrw_i_writeWriterStats(const BSG_KSCrashReportWriter *const writer,
+                                  const char *const key,
+                                  BSG_KSFile *const file,
+                                  const uint64_t startTime,
+                                  const size_t templateBytes) {
+    BSG_KSJSONEncodeContext *context = bsg_getJsonContext(writer);
+    bsg_ksjsonflush(context);
+    const off_t bytes = BSG_KSFileOffset(file);
+    const double duration =
+        bsg_ksmachtimeDifferenceInSeconds(mach_absolute_time(), startTime);
+
+    writer->beginObject(writer, key);
+    {
+        writer->addStringElement(writer, BSG_KSCrashField_Format,
+                                 context->binary ? BSG_KSCrashFormat_Binary
+                                                 : BSG_KSCrashFormat_JSON);
+        writer->addUIntegerElement(writer, BSG_KSCrashField_Bytes,
+                                   bytes > 0 ? (unsigned long long)bytes : 0);
+        writer->addUIntegerElement(writer, BSG_KSCrashField_DurationMicros,
+                                   (unsigned long long)(duration * 1000000));
+        writer->addBooleanElement(writer, BSG_KSCrashField_Mapped,
+                                  file->mapSize > 0);
+        writer->addUIntegerElement(writer, BSG_KSCrashField_TemplateBytes,
+                                   templateBytes);
     }
     writer->endContainer(writer);
 }
@@ -1166,6 +1528,35 @@ int bsg_kscrw_i_openCrashReportFile(const char *const path) {
     return fd;
 }
 
+/** Fill a file with zeroes up to the requested size.
+ *
+ * Writing real data, rather than reserving space with F_PREALLOCATE or
+ * posix_fallocate(), means the blocks are fully allocated and cached, so
+ * storing to a mapping of them later does not have to convert extents.
+ *
+ * @param fd The file descriptor.
+ *
+ * @param size The size the file should be.
+ *
+ * @return true if the file is at least size bytes long.
+ */
+bool bsg_kscrw_i_zeroFillFile(const int fd, const off_t size) {
+    static const char zeroes[16 * 1024];
+    struct stat st;
+    if (fstat(fd, &st) != 0 || lseek(fd, st.st_size, SEEK_SET) < 0) {
+        return false;
+    }
+    // Files left by a previous launch are already large enough.
+    for (off_t offset = st.st_size; offset < size;
+         offset += (off_t)sizeof(zeroes)) {
+        const off_t length = MIN(size - offset, (off_t)sizeof(zeroes));
+        if (!bsg_ksfuwriteBytesToFD(fd, zeroes, (ssize_t)length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /** Record whether the crashed thread had a stack overflow or not.
  *
  * @param crashContext the context.
@@ -1180,6 +1571,88 @@ void bsg_kscrw_i_updateStackOverflowStatus(
     }
 }
 
+#pragma mark Template
+
+/** Get the report template, if it was rendered from the current config.
+ *
+ * @param crashContext The crash context.
+ *
+ * @return The template, or NULL if the fields must be written normally.
+ */
+const BSG_KSCrashReportTemplate *
+bsg_kscrw_i_reportTemplate(const BSG_KSCrash_Context *const crashContext) {
+    const BSG_KSCrashReportTemplate *template =
+        atomic_load(&bsg_g_reportTemplate);
+    if (template == NULL ||
+        template->binary != crashContext->config.writeBinaryReports ||
+        template->generation != crashContext->config.generation) {
+        return NULL;
+    }
+    return template;
+}
+
+/** Encode the static report fields into a new template.
+ *
+ * Each group of fields is written into an object of its own so that the
+ * encoder is in the same state as when writing a report. The captured range
+ * ends before the single '}' or break byte that closes the object, which also
+ * terminates any raw JSON left open in a binary encoding.
+ *
+ * @param crashContext The crash context.
+ *
+ * @return A template that must be freed, or NULL on failure.
+ */
+BSG_KSCrashReportTemplate *
+bsg_kscrw_i_renderReportTemplate(const BSG_KSCrash_Context *const crashContext) {
+    BSG_KSCrashReportBuffer buffer = {0};
+    BSG_KSJSONEncodeContext jsonContext;
+    BSG_KSCrashReportWriter concreteWriter;
+    BSG_KSCrashReportWriter *writer = &concreteWriter;
+    bsg_kscrw_i_prepareReportWriter(writer, &jsonContext);
+
+    const bool binary = crashContext->config.writeBinaryReports;
+    if (binary) {
+        bsg_ksjsonbeginBinaryEncode(bsg_getJsonContext(writer),
+                                    bsg_kscrw_i_addJSONDataToBuffer, &buffer);
+    } else {
+        bsg_ksjsonbeginEncode(bsg_getJsonContext(writer), false,
+                              bsg_kscrw_i_addJSONDataToBuffer, &buffer);
+    }
+
+    writer->beginObject(writer, BSG_KSCrashField_Report);
+    const size_t reportInfoStart = buffer.length;
+    bsg_kscrw_i_writeStaticReportInfo(writer, BSG_KSCrashReportType_Standard,
+                                      crashContext->config.crashID,
+                                      crashContext->config.processName);
+    writer->endContainer(writer);
+    const size_t reportInfoLength = buffer.length - 1 - reportInfoStart;
+
+    writer->beginObject(writer, BSG_KSCrashField_Report);
+    const size_t staticFieldsStart = buffer.length;
+    bsg_kscrw_i_writeStaticFields(crashContext, writer);
+    writer->endContainer(writer);
+    const size_t staticFieldsLength = buffer.length - 1 - staticFieldsStart;
+
+    bsg_ksjsonendEncode(bsg_getJsonContext(writer));
+
+    BSG_KSCrashReportTemplate *template = NULL;
+    if (!buffer.failed) {
+        template = malloc(sizeof(*template) + reportInfoLength +
+                          staticFieldsLength);
+    }
+    if (template != NULL) {
+        template->generation = crashContext->config.generation;
+        template->binary = binary;
+        template->reportInfoLength = reportInfoLength;
+        template->staticFieldsLength = staticFieldsLength;
+        memcpy(template->data, buffer.data + reportInfoStart, reportInfoLength);
+        memcpy(template->data + reportInfoLength,
+               buffer.data + staticFieldsStart, staticFieldsLength);
+    }
+    free(buffer.data);
+    return template;
+}
+
 // ============================================================================
 #pragma mark - Main API -
 // ============================================================================
@@ -1195,6 +1668,9 @@ void bsg_kscrashreport_writeMinimalReport(
 
     bsg_kscrw_i_updateStackOverflowStatus(crashContext);
 
+    // Images registered lazily may not have been named yet.
+    bsg_mach_headers_populate_for_crash();
+
     BSG_KSFile file;
     char buffer[512];
     BSG_KSFileInit(&file, fd, buffer, sizeof(buffer) / sizeof(*buffer));
@@ -1241,20 +1717,93 @@ void bsg_kscrashreport_writeMinimalReport(
     close(fd);
 }
 
+bool bsg_kscrashreport_preallocateReportFile(const char *const path,
+                                             const size_t size) {
+    if (atomic_load(&bsg_g_preallocatedReport.map) != NULL) {
+        return true;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        BSG_KSLOG_ERROR("Could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+    if (!bsg_kscrw_i_zeroFillFile(fd, (off_t)size)) {
+        BSG_KSLOG_ERROR("Could not allocate %zu bytes for %s: %s", size, path,
+                        strerror(errno));
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        BSG_KSLOG_ERROR("Could not map %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    bsg_ksstring_replace(&bsg_g_preallocatedReport.path, path);
+    bsg_g_preallocatedReport.fd = fd;
+    bsg_g_preallocatedReport.size = size;
+    atomic_store_explicit(&bsg_g_preallocatedReport.map, map,
+                          memory_order_release);
+    return true;
+}
+
+bool bsg_kscrashreport_renderTemplate(
+    const BSG_KSCrash_Context *const crashContext) {
+    BSG_KSCrashReportTemplate *template =
+        bsg_kscrw_i_renderReportTemplate(crashContext);
+    if (template == NULL) {
+        BSG_KSLOG_ERROR("Could not render crash report template");
+    }
+    // A crash may be writing a report from the old template, so it is never
+    // freed. Templates are only rendered when the config changes.
+    atomic_store(&bsg_g_reportTemplate, template);
+    return template != NULL;
+}
+
 void bsg_kscrashreport_writeStandardReport(
     BSG_KSCrash_Context *const crashContext, const char *const path) {
     BSG_KSLOG_INFO("Writing crash report to %s", path);
 
-    int fd = bsg_kscrw_i_openCrashReportFile(path);
-    if (fd < 0) {
-        return;
+    const uint64_t startTime = mach_absolute_time();
+
+    // The JSON encoder accumulates output in jsonBuffer and hands it over in
+    // full blocks, which BSG_KSFile writes without copying, so file only needs
+    // a small buffer for partial blocks.
+    BSG_KSFile file;
+    char buffer[512];
+
+    // A preallocated file is written to through its mapping, so no file has to
+    // be created or grown here. It is moved into place before anything is
+    // written, so that a report cut short by a second crash is still found
+    // and diagnosed on the next launch rather than overwritten.
+    char *const map = atomic_exchange_explicit(&bsg_g_preallocatedReport.map,
+                                               NULL, memory_order_acquire);
+    int fd;
+    if (map != NULL) {
+        fd = bsg_g_preallocatedReport.fd;
+        if (rename(bsg_g_preallocatedReport.path, path) != 0) {
+            BSG_KSLOG_ERROR("Could not move crash report to %s: %s", path,
+                            strerror(errno));
+        }
+        BSG_KSFileInitMapped(&file, fd, map, bsg_g_preallocatedReport.size,
+                             buffer, sizeof(buffer) / sizeof(*buffer));
+    } else {
+        fd = bsg_kscrw_i_openCrashReportFile(path);
+        if (fd < 0) {
+            return;
+        }
+        BSG_KSFileInit(&file, fd, buffer, sizeof(buffer) / sizeof(*buffer));
     }
 
     bsg_kscrw_i_updateStackOverflowStatus(crashContext);
 
-    BSG_KSFile file;
-    char buffer[4096];
-    BSG_KSFileInit(&file, fd, buffer, sizeof(buffer) / sizeof(*buffer));
+    // Images registered lazily may not have been named yet.
+    bsg_mach_headers_populate_for_crash();
+
+    const BSG_KSCrashReportTemplate *template =
+        bsg_kscrw_i_reportTemplate(crashContext);
 
     BSG_KSJSONEncodeContext jsonContext;
     jsonContext.userData = &file;
@@ -1262,16 +1811,36 @@ void bsg_kscrashreport_writeStandardReport(
     BSG_KSCrashReportWriter *writer = &concreteWriter;
     bsg_kscrw_i_prepareReportWriter(writer, &jsonContext);
 
-    bsg_ksjsonbeginEncode(bsg_getJsonContext(writer), false,
-                          bsg_kscrw_i_addJSONData, &file);
+    if (crashContext->config.writeBinaryReports) {
+        bsg_ksjsonbeginBinaryEncode(bsg_getJsonContext(writer),
+                                    bsg_kscrw_i_addJSONData, &file);
+    } else {
+        bsg_ksjsonbeginEncode(bsg_getJsonContext(writer), false,
+                              bsg_kscrw_i_addJSONData, &file);
+    }
+    char jsonBuffer[BSG_kReportBufferSize];
+    bsg_ksjsonsetOutputBuffer(bsg_getJsonContext(writer), jsonBuffer,
+                              sizeof(jsonBuffer));
 
     writer->beginObject(writer, BSG_KSCrashField_Report);
     {
-        bsg_kscrw_i_writeReportInfo(
+        if (template != NULL) {
+            writer->beginObject(writer, BSG_KSCrashField_Report);
+            {
+                bsg_ksjsonaddEncodedElements(bsg_getJsonContext(writer),
+                                             template->data,
+                                             template->reportInfoLength);
+                bsg_kscrw_i_writeReportTimestamps(writer);
+            }
+            writer->endContainer(writer);
+        } else {
+            bsg_kscrw_i_writeReportInfo(
                 writer, BSG_KSCrashField_Report, BSG_KSCrashReportType_Standard,
                 crashContext->config.crashID, crashContext->config.processName);
+        }
 
-        bsg_kscrashreport_writeKSCrashFields(crashContext, writer, path);
+        bsg_kscrashreport_writeKSCrashFields(crashContext, writer, path,
+                                             template);
 
         if (crashContext->config.onCrashNotify != NULL) {
             // NOTE: The deny list for BSG_KSCrashField_UserAtCrash children in BugsnagEvent.m
@@ -1282,24 +1851,41 @@ void bsg_kscrashreport_writeStandardReport(
             crashContext->config.onCrashNotify(writer, crashContext->crash.requiresAsyncSafety);
             writer->endContainer(writer);
         }
+
+        bsg_kscrw_i_writeWriterStats(
+            writer, BSG_KSCrashField_WriterStats, &file, startTime,
+            template != NULL ? template->reportInfoLength +
+                                   template->staticFieldsLength
+                             : 0);
     }
     writer->endContainer(writer);
 
     bsg_ksjsonendEncode(bsg_getJsonContext(writer));
 
-    BSG_KSFileFlush(&file);
+    if (map != NULL) {
+        if (!BSG_KSFileTruncate(&file)) {
+            BSG_KSLOG_ERROR("Could not truncate crash report: %s",
+                            strerror(errno));
+        }
+        munmap(map, bsg_g_preallocatedReport.size);
+    } else {
+        BSG_KSFileFlush(&file);
+    }
     close(fd);
 }
 
-void bsg_kscrashreport_writeKSCrashFields(BSG_KSCrash_Context *crashContext,
-                                          BSG_KSCrashReportWriter *writer,
-                                          __unused const char *const path) {
-
-    bsg_kscrw_i_writeProcessState(writer, BSG_KSCrashField_ProcessState);
+void bsg_kscrashreport_writeKSCrashFields(
+    BSG_KSCrash_Context *crashContext, BSG_KSCrashReportWriter *writer,
+    __unused const char *const path,
+    const BSG_KSCrashReportTemplate *const template) {
 
-    if (crashContext->config.systemInfoJSON != NULL) {
-        bsg_kscrw_i_addJSONElement(writer, BSG_KSCrashField_System,
-                crashContext->config.systemInfoJSON);
+    if (template != NULL) {
+        bsg_ksjsonaddEncodedElements(
+            bsg_getJsonContext(writer),
+            template->data + template->reportInfoLength,
+            template->staticFieldsLength);
+    } else {
+        bsg_kscrw_i_writeStaticFields(crashContext, writer);
     }
 
     writer->beginObject(writer, BSG_KSCrashField_SystemAtCrash);
@@ -36,6 +36,38 @@
 extern "C" {
 #endif
 
+/** Create, size and map a file for the next standard crash report, so that
+ * writing the report needs no file creation, disk allocation or write() calls.
+ * The file is moved to the path passed to
+ * bsg_kscrashreport_writeStandardReport() before the report is written.
+ *
+ * Not async signal safe, but may be called on a background thread while crash
+ * handling is installed.
+ *
+ * @param path The file to preallocate. May be left over from a previous launch.
+ *
+ * @param size The number of bytes to allocate. Reports that are larger
+ *             continue with ordinary writes.
+ *
+ * @return true if the file was allocated and mapped.
+ */
+bool bsg_kscrashreport_preallocateReportFile(const char *path, size_t size);
+
+/** Encode the fields of a standard crash report that do not change until the
+ * config does (report info, process name, crash ID and system info), so that
+ * bsg_kscrashreport_writeStandardReport() only has to copy them.
+ *
+ * Must be called again whenever any of those config values, or the report
+ * format, change. Reports written in the meantime encode the fields as usual.
+ *
+ * Not async signal safe.
+ *
+ * @param crashContext The crash context holding the config.
+ *
+ * @return true if the template was rendered.
+ */
+bool bsg_kscrashreport_renderTemplate(const BSG_KSCrash_Context *crashContext);
+
 /** Write a standard crash report to a file.
  *
  * @param crashContext Contextual information about the crash and environment.
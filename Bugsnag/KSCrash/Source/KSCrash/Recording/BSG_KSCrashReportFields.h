@@ -162,8 +162,56 @@
 #define BSG_KSCrashField_UserAtCrash "user_atcrash"
 #define BSG_KSCrashField_OnCrashMetadataSectionName "onCrash"
 
+#pragma mark Writer Stats
+#define BSG_KSCrashField_WriterStats "writer_stats"
+#define BSG_KSCrashField_Format "format"
+#define BSG_KSCrashField_Bytes "bytes"
+#define BSG_KSCrashField_DurationMicros "duration_us"
+#define BSG_KSCrashField_Mapped "mapped"
+#define BSG_KSCrashField_TemplateBytes "template_bytes"
+#define BSG_KSCrashField_Transcode "transcode"
+#define BSG_KSCrashFormat_Binary "cbor"
+#define BSG_KSCrashFormat_JSON "json"
+
 #pragma mark Incomplete
 #define BSG_KSCrashField_Incomplete "incomplete"
 #define BSG_KSCrashField_RecrashReport "recrash_report"
 
+#pragma mark - Encoded Keys -
+
+/** Fields that are written many times per report and so are emitted using
+ * pre-encoded names (see BSG_KSJSON_ENCODED_NAME) rather than being quoted and
+ * escaped at crash time.
+ */
+#define BSG_KSCrashEncodedFields(X)                                            \
+    X(Contents)                                                                \
+    X(CPUSubType)                                                              \
+    X(CPUType)                                                                 \
+    X(Crashed)                                                                 \
+    X(CurrentThread)                                                           \
+    X(ImageAddress)                                                            \
+    X(ImageSize)                                                               \
+    X(ImageVmAddress)                                                          \
+    X(Index)                                                                   \
+    X(InstructionAddr)                                                         \
+    X(Name)                                                                    \
+    X(ObjectAddr)                                                              \
+    X(ObjectName)                                                              \
+    X(Overflow)                                                                \
+    X(Skipped)                                                                 \
+    X(State)                                                                   \
+    X(SymbolAddr)                                                              \
+    X(SymbolName)                                                              \
+    X(UUID)
+
+#define BSG_KSCrashEncodedFieldEnumCase(NAME) BSG_KSCrashKey_##NAME,
+
+/** Identifies a field with a pre-encoded name. */
+typedef enum {
+    BSG_KSCrashEncodedFields(BSG_KSCrashEncodedFieldEnumCase)
+    BSG_KSCrashKeyCount
+} BSG_KSCrashKey;
+
+#undef BSG_KSCrashEncodedFieldEnumCase
+
 #endif
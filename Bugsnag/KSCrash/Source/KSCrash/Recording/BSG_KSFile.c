@@ -12,6 +12,7 @@
 
 #include <string.h>
 #include <sys/param.h>
+#include <unistd.h>
 
 static inline bool bsg_write(const int fd, const char *bytes, size_t length) {
     return bsg_ksfuwriteBytesToFD(fd, bytes, (ssize_t)length);
@@ -22,9 +23,40 @@ void BSG_KSFileInit(BSG_KSFile *file, int fd, char *buffer, size_t length) {
     file->buffer = buffer;
     file->bufferSize = length;
     file->bufferUsed = 0;
+    file->map = NULL;
+    file->mapSize = 0;
+    file->mapUsed = 0;
+}
+
+void BSG_KSFileInitMapped(BSG_KSFile *file, int fd, char *map, size_t mapSize,
+                          char *buffer, size_t length) {
+    BSG_KSFileInit(file, fd, buffer, length);
+    file->map = map;
+    file->mapSize = mapSize;
 }
 
 bool BSG_KSFileWrite(BSG_KSFile *file, const char *data, size_t length) {
+    if (file->map) {
+        const size_t bytesCopied = MIN(file->mapSize - file->mapUsed, length);
+        memcpy(file->map + file->mapUsed, data, bytesCopied);
+        file->mapUsed += bytesCopied;
+        if (bytesCopied == length) {
+            return true;
+        }
+        // The mapping is full; carry on writing after it.
+        if (lseek(file->fd, (off_t)file->mapSize, SEEK_SET) < 0) {
+            return false;
+        }
+        file->map = NULL;
+        data += bytesCopied;
+        length -= bytesCopied;
+    }
+
+    if (file->bufferUsed == 0 && length >= file->bufferSize) {
+        // Nothing to preserve ordering with; skip the copy.
+        return bsg_write(file->fd, data, length);
+    }
+
     const size_t bytesCopied = MIN(file->bufferSize - file->bufferUsed, length);
     memcpy(file->buffer + file->bufferUsed, data, bytesCopied);
     file->bufferUsed += bytesCopied;
@@ -57,3 +89,19 @@ bool BSG_KSFileFlush(BSG_KSFile *file) {
     file->bufferUsed = 0;
     return true;
 }
+
+off_t BSG_KSFileOffset(BSG_KSFile *file) {
+    if (file->map) {
+        return (off_t)file->mapUsed;
+    }
+    const off_t offset = lseek(file->fd, 0, SEEK_CUR);
+    return offset < 0 ? offset : offset + (off_t)file->bufferUsed;
+}
+
+bool BSG_KSFileTruncate(BSG_KSFile *file) {
+    if (!BSG_KSFileFlush(file)) {
+        return false;
+    }
+    const off_t offset = BSG_KSFileOffset(file);
+    return offset >= 0 && ftruncate(file->fd, offset) == 0;
+}
@@ -10,16 +10,40 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 typedef struct {
     int fd;
     char *buffer;
     size_t bufferSize;
     size_t bufferUsed;
+    char *map;
+    size_t mapSize;
+    size_t mapUsed;
 } BSG_KSFile;
 
 void BSG_KSFileInit(BSG_KSFile *file, int fd, char *buffer, size_t length);
 
+/**
+ * Initializes a file whose first mapSize bytes are mapped writable at map.
+ *
+ * Data is copied straight into the mapping; once it is full, the remainder is
+ * written to fd through the buffer as with BSG_KSFileInit().
+ * Call BSG_KSFileTruncate() when done to discard unused preallocated space.
+ */
+void BSG_KSFileInitMapped(BSG_KSFile *file, int fd, char *map, size_t mapSize,
+                          char *buffer, size_t length);
+
 bool BSG_KSFileWrite(BSG_KSFile *file, const char *data, size_t length);
 
 bool BSG_KSFileFlush(BSG_KSFile *file);
+
+/**
+ * Returns the number of bytes written so far, including any still buffered.
+ */
+off_t BSG_KSFileOffset(BSG_KSFile *file);
+
+/**
+ * Flushes the buffer and sets the file's length to the number of bytes written.
+ */
+bool BSG_KSFileTruncate(BSG_KSFile *file);
@@ -29,6 +29,8 @@
 #include "BSG_KSMach.h"
 #include "BSGDefines.h"
 
+#include <string.h>
+
 /**
  * Mask to strip pointer authentication codes from pointers on Arm64e
  * devices. Example usage, assuming the usage is guarded for __arm64__:
@@ -51,58 +53,65 @@ typedef struct BSG_KSFrameEntry {
     const uintptr_t return_address;
 } BSG_KSFrameEntry;
 
-// Avoiding static functions due to linker issues.
-
-int bsg_ksbt_backtraceLength(
-    const BSG_STRUCT_MCONTEXT_L *const machineContext) {
-    const uintptr_t instructionAddress =
-        bsg_ksmachinstructionAddress(machineContext);
-
-    if (instructionAddress == 0) {
-        return 0;
-    }
-
-    BSG_KSFrameEntry frame = {0};
-    const uintptr_t framePtr = bsg_ksmachframePointer(machineContext);
-    if (framePtr == 0 || bsg_ksmachcopyMem((void *)framePtr, &frame,
-                                           sizeof(frame)) != KERN_SUCCESS) {
-        return 1;
-    }
-    for (int i = 1; i < BSG_kBacktraceGiveUpPoint; i++) {
-        if (frame.previous == 0 ||
-            bsg_ksmachcopyMem(frame.previous, &frame, sizeof(frame)) !=
-                KERN_SUCCESS) {
-            return i;
-        }
-    }
+/** The size of the aligned blocks of stack copied by BSG_KSStackReader.
+ * Blocks never straddle a page boundary, so a block is either readable in
+ * full or not at all.
+ */
+#define BSG_KSStackBlockSize 4096
 
-    return BSG_kBacktraceGiveUpPoint;
-}
+/** Serves frame reads from a local copy of the block of stack they lie in,
+ * so that walking the frames on one block costs a single bsg_ksmachcopyMem()
+ * call rather than one per frame.
+ */
+typedef struct {
+    /** Whether a block has been copied. No address, not even 0, can stand in
+     * for "nothing copied" because frame pointers can hold any value.
+     */
+    bool valid;
+    /** The address of the copied block. */
+    uintptr_t base;
+    char block[BSG_KSStackBlockSize];
+} BSG_KSStackReader;
 
-bool bsg_ksbt_isBacktraceTooLong(
-    const BSG_STRUCT_MCONTEXT_L *const machineContext, int maxLength) {
-    const uintptr_t instructionAddress =
-        bsg_ksmachinstructionAddress(machineContext);
+/** The number of bsg_ksmachcopyMem() calls made by bsg_ksbt_i_readFrame(),
+ * for tests. Not synchronized, so only meaningful while one thread is walking.
+ */
+static size_t bsg_g_copyCount;
 
-    if (instructionAddress == 0) {
-        return 0;
-    }
+// Avoiding static functions due to linker issues.
 
-    BSG_KSFrameEntry frame = {0};
-    const uintptr_t framePtr = bsg_ksmachframePointer(machineContext);
-    if (framePtr == 0 || bsg_ksmachcopyMem((void *)framePtr, &frame,
-                                           sizeof(frame)) != KERN_SUCCESS) {
-        return 1;
-    }
-    for (int i = 1; i < maxLength; i++) {
-        if (frame.previous == 0 ||
-            bsg_ksmachcopyMem(frame.previous, &frame, sizeof(frame)) !=
-                KERN_SUCCESS) {
-            return false;
+/** Read a frame entry from a thread's stack.
+ *
+ * @param reader The reader, initialized with valid = false.
+ *
+ * @param address The address of the frame entry.
+ *
+ * @param frame Receives the frame entry.
+ *
+ * @return true if the frame entry could be read.
+ */
+bool bsg_ksbt_i_readFrame(BSG_KSStackReader *const reader,
+                          const void *const address,
+                          BSG_KSFrameEntry *const frame) {
+    const uintptr_t start = (uintptr_t)address;
+    const uintptr_t base = start & ~(uintptr_t)(BSG_KSStackBlockSize - 1);
+    if (start - base + sizeof(*frame) <= BSG_KSStackBlockSize) {
+        if (!(reader->valid && base == reader->base)) {
+            bsg_g_copyCount++;
+            reader->valid =
+                bsg_ksmachcopyMem((const void *)base, reader->block,
+                                  BSG_KSStackBlockSize) == KERN_SUCCESS;
+            reader->base = base;
+        }
+        if (reader->valid) {
+            memcpy(frame, reader->block + (start - base), sizeof(*frame));
+            return true;
         }
     }
-
-    return true;
+    // Frames that straddle blocks or lie outside readable ones are checked
+    // individually.
+    bsg_g_copyCount++;
+    return bsg_ksmachcopyMem(address, frame, sizeof(*frame)) == KERN_SUCCESS;
 }
 
 int bsg_ksbt_backtraceThreadState(
@@ -140,16 +149,17 @@ int bsg_ksbt_backtraceThreadState(
     }
 
     BSG_KSFrameEntry frame = {0};
+    BSG_KSStackReader reader;
+    reader.valid = false;
 
     const uintptr_t framePtr = bsg_ksmachframePointer(machineContext);
-    if (framePtr == 0 || bsg_ksmachcopyMem((void *)framePtr, &frame,
-                                           sizeof(frame)) != KERN_SUCCESS) {
+    if (framePtr == 0 ||
+        !bsg_ksbt_i_readFrame(&reader, (void *)framePtr, &frame)) {
         return i;
     }
     for (int j = 1; j < skipEntries; j++) {
         if (frame.previous == 0 ||
-            bsg_ksmachcopyMem(frame.previous, &frame, sizeof(frame)) !=
-                KERN_SUCCESS) {
+            !bsg_ksbt_i_readFrame(&reader, frame.previous, &frame)) {
             return i;
         }
     }
@@ -163,14 +173,97 @@ int bsg_ksbt_backtraceThreadState(
         backtraceBuffer[i] = frame.return_address;
 #endif
         if (backtraceBuffer[i] == 0 || frame.previous == 0 ||
-            bsg_ksmachcopyMem(frame.previous, &frame, sizeof(frame)) !=
-                KERN_SUCCESS) {
+            !bsg_ksbt_i_readFrame(&reader, frame.previous, &frame)) {
             break;
         }
     }
     return i;
 }
 
+/** Reverse the order of entries in a buffer.
+ *
+ * @param buffer The entries to reverse.
+ *
+ * @param count The number of entries.
+ */
+void bsg_ksbt_i_reverse(uintptr_t *const buffer, const int count) {
+    for (int i = 0, j = count - 1; i < j; i++, j--) {
+        const uintptr_t entry = buffer[i];
+        buffer[i] = buffer[j];
+        buffer[j] = entry;
+    }
+}
+
+int bsg_ksbt_backtraceThreadStateRetaining(
+    const BSG_STRUCT_MCONTEXT_L *const machineContext,
+    uintptr_t *const backtraceBuffer, const int topEntries,
+    const int bottomEntries, int *const depth) {
+    int count = 0;
+
+    // The first topEntries addresses are stored in order, the rest go into a
+    // ring of bottomEntries that ends up holding the outermost frames.
+#define BSG_KSBT_RETAIN(ADDRESS)                                               \
+    do {                                                                       \
+        if (count < topEntries) {                                              \
+            backtraceBuffer[count] = (ADDRESS);                                \
+        } else if (bottomEntries > 0) {                                        \
+            backtraceBuffer[topEntries + (count - topEntries) % bottomEntries] = \
+                (ADDRESS);                                                     \
+        }                                                                      \
+        count++;                                                               \
+    } while (0)
+
+    BSG_KSBT_RETAIN(bsg_ksmachinstructionAddress(machineContext));
+
+    const uintptr_t linkRegister = bsg_ksmachlinkRegister(machineContext);
+    if (linkRegister) {
+        BSG_KSBT_RETAIN(linkRegister);
+    }
+
+    BSG_KSFrameEntry frame = {0};
+    BSG_KSStackReader reader;
+    reader.valid = false;
+    const uintptr_t framePtr = bsg_ksmachframePointer(machineContext);
+    if (framePtr != 0 &&
+        bsg_ksbt_i_readFrame(&reader, (void *)framePtr, &frame)) {
+        while (count < BSG_kBacktraceGiveUpPoint) {
+#if defined(__arm64__)
+            // Strip program auth code from address prior to storing address.
+            // Intended for Arm64e but is a no-op on other Arm64 archs.
+            const uintptr_t address =
+                frame.return_address & BSG_PACStrippingMaskArm64e;
+#else
+            const uintptr_t address = frame.return_address;
+#endif
+            if (address == 0) {
+                break;
+            }
+            BSG_KSBT_RETAIN(address);
+            if (frame.previous == 0 ||
+                !bsg_ksbt_i_readFrame(&reader, frame.previous, &frame)) {
+                break;
+            }
+        }
+    }
+
+#undef BSG_KSBT_RETAIN
+
+    *depth = count;
+    if (count <= topEntries + bottomEntries) {
+        return count;
+    }
+
+    if (bottomEntries > 0) {
+        // Rotate the ring so that its oldest entry comes first.
+        uintptr_t *const ring = backtraceBuffer + topEntries;
+        const int oldest = (count - topEntries) % bottomEntries;
+        bsg_ksbt_i_reverse(ring, oldest);
+        bsg_ksbt_i_reverse(ring + oldest, bottomEntries - oldest);
+        bsg_ksbt_i_reverse(ring, bottomEntries);
+    }
+    return topEntries + bottomEntries;
+}
+
 #if BSG_HAVE_MACH_THREADS
 int bsg_ksbt_backtraceThread(const thread_t thread,
                              uintptr_t *const backtraceBuffer,
@@ -201,3 +294,11 @@ void bsg_ksbt_symbolicate(const uintptr_t *const backtraceBuffer,
                        &symbolsBuffer[i]);
     }
 }
+
+size_t bsg_test_support_ksbt_copy_count(void) {
+    return bsg_g_copyCount;
+}
+
+void bsg_test_support_ksbt_reset_copy_count(void) {
+    bsg_g_copyCount = 0;
+}
@@ -37,34 +37,13 @@
 extern "C" {
 #endif
 
-/** Point at which bsg_ksbt_backtraceLength() will give up trying to count.
+/** Point at which bsg_ksbt_backtraceThreadStateRetaining() will give up
+ * trying to count.
  *
  * This really only comes into play during a stack overflow.
  */
 #define BSG_kBacktraceGiveUpPoint 10000000
 
-/** Count how many entries there are in a potential backtrace.
- *
- * This is useful for intelligently generating a backtrace after a stack
- * overflow.
- *
- * @param machineContext The machine context to check the backtrace for.
- *
- * @return The number of backtrace entries.
- */
-int bsg_ksbt_backtraceLength(const BSG_STRUCT_MCONTEXT_L *machineContext);
-
-/** Check if a backtrace is too long.
- *
- * @param machineContext The machine context to check the backtrace for.
- *
- * @param maxLength The give up point.
- *
- * @return true if the backtrace is longer than maxLength.
- */
-bool bsg_ksbt_isBacktraceTooLong(
-    const BSG_STRUCT_MCONTEXT_L *const machineContext, int maxLength);
-
 /** Generate a backtrace using the thread state in the specified machine context
  *  (async-safe).
  *
@@ -82,6 +61,39 @@ int bsg_ksbt_backtraceThreadState(const BSG_STRUCT_MCONTEXT_L *machineContext,
                                   uintptr_t *backtraceBuffer, int skipEntries,
                                   int maxEntries);
 
+/** Walk the whole backtrace in the specified machine context once, keeping
+ *  the innermost and outermost entries and counting all of them (async-safe).
+ *
+ * This gives the length of the backtrace, which is needed to detect a stack
+ * overflow, along with the frames on either side of a deep recursion.
+ *
+ * @param machineContext The machine context to generate a backtrace for.
+ *
+ * @param backtraceBuffer A buffer to hold topEntries + bottomEntries entries.
+ *                        Receives the innermost entries followed by the
+ *                        outermost ones, with any in between left out.
+ *
+ * @param topEntries The number of innermost entries to keep.
+ *
+ * @param bottomEntries The number of outermost entries to keep.
+ *
+ * @param depth Out: The total number of entries in the backtrace, up to
+ *              BSG_kBacktraceGiveUpPoint.
+ *
+ * @return The number of entries stored in backtraceBuffer.
+ */
+int bsg_ksbt_backtraceThreadStateRetaining(
+    const BSG_STRUCT_MCONTEXT_L *machineContext, uintptr_t *backtraceBuffer,
+    int topEntries, int bottomEntries, int *depth);
+
+/** The number of bsg_ksmachcopyMem() calls made to read stack frames since the
+ * last reset (for unit tests).
+ */
+size_t bsg_test_support_ksbt_copy_count(void);
+
+/** Reset the count of bsg_ksmachcopyMem() calls (for unit tests). */
+void bsg_test_support_ksbt_reset_copy_count(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,31 +10,70 @@
 #include <memory.h>
 #include <math.h>
 
-// Max uint64 is 18446744073709551615
-#define MAX_UINT64_DIGITS 20
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BSG_STRINGCONVERSION_HAVE_SSE2 1
+#else
+#define BSG_STRINGCONVERSION_HAVE_SSE2 0
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BSG_STRINGCONVERSION_HAVE_NEON 1
+#else
+#define BSG_STRINGCONVERSION_HAVE_NEON 0
+#endif
+
+static const uint64_t g_pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+static const char g_decimalPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * Count the decimal digits in value without dividing: log10 is approximated
+ * from the bit length (1233/4096 ~= log10(2)) and corrected with one compare.
+ * Setting the low bit maps 0 to 1 and never crosses a power of ten.
+ */
+static inline size_t count_decimal_digits(uint64_t value) {
+    value |= 1;
+    const int bits = 64 - __builtin_clzll(value);
+    const int approx = (bits * 1233) >> 12;
+    return (size_t)approx + (value >= g_pow10[approx] ? 1 : 0);
+}
 
 size_t bsg_uint64_to_string(uint64_t value, char* dst) {
-    if(value == 0) {
-        dst[0] = '0';
-        dst[1] = 0;
-        return 1;
-    }
+    const size_t length = count_decimal_digits(value);
 
-    char buff[MAX_UINT64_DIGITS+1];
-    buff[sizeof(buff)-1] = 0;
-    size_t index = sizeof(buff) - 2;
-    for(;;) {
-        buff[index] = (value%10) + '0';
-        value /= 10;
-        if (value == 0) {
-            break;
-        }
-        index--;
+    // Digits are written right to left, straight into dst, two at a time.
+    char* ptr = dst + length;
+    *ptr = 0;
+    while (value >= 100) {
+        const size_t index = (size_t)(value % 100) * 2;
+        value /= 100;
+        ptr -= 2;
+        memcpy(ptr, g_decimalPairs + index, 2);
     }
-
-    size_t length = sizeof(buff) - index;
-    memcpy(dst, buff+index, length);
-    return length - 1;
+    if (value >= 10) {
+        memcpy(ptr - 2, g_decimalPairs + value * 2, 2);
+    } else {
+        ptr[-1] = (char)value + '0';
+    }
+    return length;
 }
 
 size_t bsg_int64_to_string(int64_t value, char* dst) {
@@ -45,8 +84,50 @@ size_t bsg_int64_to_string(int64_t value, char* dst) {
     return bsg_uint64_to_string((uint64_t)value, dst);
 }
 
-static char g_hexNybbles[] = {'0', '1', '2', '3', '4', '5', '6', '7',
-                              '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+/**
+ * Write all 16 nybbles of value to dst as lowercase hex, most significant first.
+ * Exactly 16 bytes are written, with no NUL terminator.
+ */
+static inline void write_hex16(uint64_t value, char* dst) {
+#if BSG_STRINGCONVERSION_HAVE_NEON
+    static const uint8_t hexDigits[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
+                                          '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+    // Lanes hold the bytes of value, most significant first.
+    const uint8x8_t bytes = vcreate_u8(__builtin_bswap64(value));
+    const uint8x8x2_t nybbles = vzip_u8(vshr_n_u8(bytes, 4), vand_u8(bytes, vdup_n_u8(0x0f)));
+    const uint8x16_t chars = vqtbl1q_u8(vld1q_u8(hexDigits),
+                                        vcombine_u8(nybbles.val[0], nybbles.val[1]));
+    vst1q_u8((uint8_t *)dst, chars);
+#elif BSG_STRINGCONVERSION_HAVE_SSE2
+    const uint64_t swapped = __builtin_bswap64(value);
+    const __m128i bytes = _mm_loadl_epi64((const __m128i *)(const void *)&swapped);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nybbles = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask),
+                                              _mm_and_si128(bytes, mask));
+    // '0' + n, plus ('a' - '0' - 10) for every n above 9.
+    const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nybbles, _mm_set1_epi8(9)),
+                                          _mm_set1_epi8('a' - '0' - 10));
+    const __m128i chars = _mm_add_epi8(_mm_add_epi8(nybbles, _mm_set1_epi8('0')), letters);
+    _mm_storeu_si128((__m128i *)(void *)dst, chars);
+#else
+    // Portable SWAR fallback: spread each 32-bit half to one nybble per byte,
+    // then convert all 8 bytes to ASCII at once.
+    for (int half = 0; half < 2; half++) {
+        uint64_t x = (uint32_t)(value >> (half == 0 ? 32 : 0));
+        x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+        x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+        x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        // Bit 4 of n + 6 is set only for nybbles 0xa-0xf.
+        const uint64_t letters = ((x + 0x0606060606060606ULL) >> 4) & 0x0101010101010101ULL;
+        x += 0x3030303030303030ULL + letters * ('a' - '0' - 10);
+        // Byte n now holds nybble n; store the most significant first.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        memcpy(dst + half * 8, &x, sizeof(x));
+    }
+#endif
+}
 
 size_t bsg_uint64_to_hex(uint64_t value, char* dst, int min_digits) {
     if (min_digits < 1) {
@@ -55,21 +136,14 @@ size_t bsg_uint64_to_hex(uint64_t value, char* dst, int min_digits) {
         min_digits = 16;
     }
 
-    char buff[MAX_UINT64_DIGITS+1];
-    buff[sizeof(buff)-1] = 0;
-    size_t index = sizeof(buff) - 2;
-    for(int digitCount = 1;; digitCount++) {
-        buff[index] = g_hexNybbles[(value&15)];
-        value >>= 4;
-        if (value == 0 && digitCount >= min_digits) {
-            break;
-        }
-        index--;
-    }
+    const int significant = (64 - __builtin_clzll(value | 1) + 3) / 4;
+    const int digits = significant > min_digits ? significant : min_digits;
 
-    size_t length = sizeof(buff) - index;
-    memcpy(dst, buff+index, length);
-    return length - 1;
+    // Shift the wanted digits to the top so that they come out first, then
+    // write all 16 straight into dst and terminate after the wanted ones.
+    write_hex16(value << ((16 - digits) * 4), dst);
+    dst[digits] = 0;
+    return (size_t)digits;
 }
 
 /**
@@ -186,3 +260,307 @@ size_t bsg_double_to_string(double value, char* dst, int max_sig_digits) {
     }
     return positive_double_to_string(value, dst, max_sig_digits);
 }
+
+#pragma mark - Shortest round-trip double conversion
+
+/*
+ * Shortest round-trip conversion uses the Grisu2 algorithm from
+ * "Printing Floating-Point Numbers Quickly and Accurately with Integers"
+ * (Florian Loitsch, PLDI 2010), working entirely in 64-bit integer arithmetic
+ * with a table of cached powers of ten. It produces the shortest digit string
+ * that parses back to the same double in the vast majority of cases, and a
+ * string that still round-trips (but may have one extra digit) otherwise.
+ */
+
+/** A floating point value with a 64-bit significand: f * 2^e */
+typedef struct {
+    uint64_t f;
+    int e;
+} bsg_diy_fp;
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_HIDDEN_BIT ((uint64_t)1 << DP_SIGNIFICAND_SIZE)
+#define DP_SIGNIFICAND_MASK (DP_HIDDEN_BIT - 1)
+#define DP_EXPONENT_MASK ((uint64_t)0x7FF << DP_SIGNIFICAND_SIZE)
+
+/** Normalized powers of ten from 1e-348 to 1e+340 in steps of 1e8. */
+static const bsg_diy_fp g_cachedPowers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220}, // 1e-348
+    {0xbaaee17fa23ebf76ULL, -1193}, // 1e-340
+    {0x8b16fb203055ac76ULL, -1166}, // 1e-332
+    {0xcf42894a5dce35eaULL, -1140}, // 1e-324
+    {0x9a6bb0aa55653b2dULL, -1113}, // 1e-316
+    {0xe61acf033d1a45dfULL, -1087}, // 1e-308
+    {0xab70fe17c79ac6caULL, -1060}, // 1e-300
+    {0xff77b1fcbebcdc4fULL, -1034}, // 1e-292
+    {0xbe5691ef416bd60cULL, -1007}, // 1e-284
+    {0x8dd01fad907ffc3cULL, -980}, // 1e-276
+    {0xd3515c2831559a83ULL, -954}, // 1e-268
+    {0x9d71ac8fada6c9b5ULL, -927}, // 1e-260
+    {0xea9c227723ee8bcbULL, -901}, // 1e-252
+    {0xaecc49914078536dULL, -874}, // 1e-244
+    {0x823c12795db6ce57ULL, -847}, // 1e-236
+    {0xc21094364dfb5637ULL, -821}, // 1e-228
+    {0x9096ea6f3848984fULL, -794}, // 1e-220
+    {0xd77485cb25823ac7ULL, -768}, // 1e-212
+    {0xa086cfcd97bf97f4ULL, -741}, // 1e-204
+    {0xef340a98172aace5ULL, -715}, // 1e-196
+    {0xb23867fb2a35b28eULL, -688}, // 1e-188
+    {0x84c8d4dfd2c63f3bULL, -661}, // 1e-180
+    {0xc5dd44271ad3cdbaULL, -635}, // 1e-172
+    {0x936b9fcebb25c996ULL, -608}, // 1e-164
+    {0xdbac6c247d62a584ULL, -582}, // 1e-156
+    {0xa3ab66580d5fdaf6ULL, -555}, // 1e-148
+    {0xf3e2f893dec3f126ULL, -529}, // 1e-140
+    {0xb5b5ada8aaff80b8ULL, -502}, // 1e-132
+    {0x87625f056c7c4a8bULL, -475}, // 1e-124
+    {0xc9bcff6034c13053ULL, -449}, // 1e-116
+    {0x964e858c91ba2655ULL, -422}, // 1e-108
+    {0xdff9772470297ebdULL, -396}, // 1e-100
+    {0xa6dfbd9fb8e5b88fULL, -369}, // 1e-92
+    {0xf8a95fcf88747d94ULL, -343}, // 1e-84
+    {0xb94470938fa89bcfULL, -316}, // 1e-76
+    {0x8a08f0f8bf0f156bULL, -289}, // 1e-68
+    {0xcdb02555653131b6ULL, -263}, // 1e-60
+    {0x993fe2c6d07b7facULL, -236}, // 1e-52
+    {0xe45c10c42a2b3b06ULL, -210}, // 1e-44
+    {0xaa242499697392d3ULL, -183}, // 1e-36
+    {0xfd87b5f28300ca0eULL, -157}, // 1e-28
+    {0xbce5086492111aebULL, -130}, // 1e-20
+    {0x8cbccc096f5088ccULL, -103}, // 1e-12
+    {0xd1b71758e219652cULL, -77}, // 1e-4
+    {0x9c40000000000000ULL, -50}, // 1e4
+    {0xe8d4a51000000000ULL, -24}, // 1e12
+    {0xad78ebc5ac620000ULL, 3}, // 1e20
+    {0x813f3978f8940984ULL, 30}, // 1e28
+    {0xc097ce7bc90715b3ULL, 56}, // 1e36
+    {0x8f7e32ce7bea5c70ULL, 83}, // 1e44
+    {0xd5d238a4abe98068ULL, 109}, // 1e52
+    {0x9f4f2726179a2245ULL, 136}, // 1e60
+    {0xed63a231d4c4fb27ULL, 162}, // 1e68
+    {0xb0de65388cc8ada8ULL, 189}, // 1e76
+    {0x83c7088e1aab65dbULL, 216}, // 1e84
+    {0xc45d1df942711d9aULL, 242}, // 1e92
+    {0x924d692ca61be758ULL, 269}, // 1e100
+    {0xda01ee641a708deaULL, 295}, // 1e108
+    {0xa26da3999aef774aULL, 322}, // 1e116
+    {0xf209787bb47d6b85ULL, 348}, // 1e124
+    {0xb454e4a179dd1877ULL, 375}, // 1e132
+    {0x865b86925b9bc5c2ULL, 402}, // 1e140
+    {0xc83553c5c8965d3dULL, 428}, // 1e148
+    {0x952ab45cfa97a0b3ULL, 455}, // 1e156
+    {0xde469fbd99a05fe3ULL, 481}, // 1e164
+    {0xa59bc234db398c25ULL, 508}, // 1e172
+    {0xf6c69a72a3989f5cULL, 534}, // 1e180
+    {0xb7dcbf5354e9beceULL, 561}, // 1e188
+    {0x88fcf317f22241e2ULL, 588}, // 1e196
+    {0xcc20ce9bd35c78a5ULL, 614}, // 1e204
+    {0x98165af37b2153dfULL, 641}, // 1e212
+    {0xe2a0b5dc971f303aULL, 667}, // 1e220
+    {0xa8d9d1535ce3b396ULL, 694}, // 1e228
+    {0xfb9b7cd9a4a7443cULL, 720}, // 1e236
+    {0xbb764c4ca7a44410ULL, 747}, // 1e244
+    {0x8bab8eefb6409c1aULL, 774}, // 1e252
+    {0xd01fef10a657842cULL, 800}, // 1e260
+    {0x9b10a4e5e9913129ULL, 827}, // 1e268
+    {0xe7109bfba19c0c9dULL, 853}, // 1e276
+    {0xac2820d9623bf429ULL, 880}, // 1e284
+    {0x80444b5e7aa7cf85ULL, 907}, // 1e292
+    {0xbf21e44003acdd2dULL, 933}, // 1e300
+    {0x8e679c2f5e44ff8fULL, 960}, // 1e308
+    {0xd433179d9c8cb841ULL, 986}, // 1e316
+    {0x9e19db92b4e31ba9ULL, 1013}, // 1e324
+    {0xeb96bf6ebadf77d9ULL, 1039}, // 1e332
+    {0xaf87023b9bf0ee6bULL, 1066}, // 1e340
+};
+
+static inline bsg_diy_fp diy_fp_from_double(const double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const int biased_e = (int)((bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    const uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    if (biased_e != 0) {
+        return (bsg_diy_fp){significand + DP_HIDDEN_BIT, biased_e - DP_EXPONENT_BIAS};
+    }
+    return (bsg_diy_fp){significand, 1 - DP_EXPONENT_BIAS};
+}
+
+static inline bsg_diy_fp diy_fp_normalize(bsg_diy_fp v) {
+    const int shift = __builtin_clzll(v.f);
+    return (bsg_diy_fp){v.f << shift, v.e - shift};
+}
+
+static inline bsg_diy_fp diy_fp_multiply(const bsg_diy_fp x, const bsg_diy_fp y) {
+    // 64x64 -> upper 64 bits, rounded. Done in 32-bit halves so it also works
+    // on 32-bit targets without __uint128_t.
+    const uint64_t M32 = 0xFFFFFFFFu;
+    const uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+    tmp += 1U << 31;
+    return (bsg_diy_fp){ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+}
+
+/** Compute the normalized upper and lower boundaries of value's rounding interval. */
+static inline void diy_fp_boundaries(const bsg_diy_fp v, bsg_diy_fp *minus, bsg_diy_fp *plus) {
+    bsg_diy_fp pl = {(v.f << 1) + 1, v.e - 1};
+    while (!(pl.f & (DP_HIDDEN_BIT << 1))) {
+        pl.f <<= 1;
+        pl.e--;
+    }
+    pl.f <<= 64 - DP_SIGNIFICAND_SIZE - 2;
+    pl.e -= 64 - DP_SIGNIFICAND_SIZE - 2;
+
+    // The lower boundary is closer when the significand is a power of two.
+    bsg_diy_fp mi = v.f == DP_HIDDEN_BIT ? (bsg_diy_fp){(v.f << 2) - 1, v.e - 2}
+                                         : (bsg_diy_fp){(v.f << 1) - 1, v.e - 1};
+    mi.f <<= mi.e - pl.e;
+    mi.e = pl.e;
+
+    *minus = mi;
+    *plus = pl;
+}
+
+/** Select a cached power c such that e + c.e + 64 is in [-60, -32].
+ * Writes the negated decimal exponent of the power to K.
+ */
+static inline bsg_diy_fp cached_power(const int e, int *K) {
+    // 0.30102999566398114 = log10(2)
+    const double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if (dk - k > 0.0) {
+        k++;
+    }
+    const unsigned index = (unsigned)((k >> 3) + 1);
+    *K = -(-348 + (int)(index << 3));
+    return g_cachedPowers[index];
+}
+
+static inline void grisu_round(char *buffer, int length, uint64_t delta, uint64_t rest,
+                               uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static inline int count_decimal_digits32(const uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= g_pow10[digits]) {
+        digits++;
+    }
+    return digits;
+}
+
+/** Generate the digits of W within the interval (Mp - delta, Mp). */
+static int grisu_digit_gen(const bsg_diy_fp W, const bsg_diy_fp Mp, uint64_t delta,
+                           char *buffer, int *K) {
+    const bsg_diy_fp one = {(uint64_t)1 << -Mp.e, Mp.e};
+    const uint64_t wp_w = Mp.f - W.f;
+    uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    int kappa = count_decimal_digits32(p1);
+    int length = 0;
+
+    while (kappa > 0) {
+        const uint32_t divisor = (uint32_t)g_pow10[kappa - 1];
+        const uint32_t d = p1 / divisor;
+        p1 %= divisor;
+        if (d || length) {
+            buffer[length++] = (char)('0' + d);
+        }
+        kappa--;
+        const uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+        if (rest <= delta) {
+            *K += kappa;
+            grisu_round(buffer, length, delta, rest, g_pow10[kappa] << -one.e, wp_w);
+            return length;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        const char d = (char)(p2 >> -one.e);
+        if (d || length) {
+            buffer[length++] = (char)('0' + d);
+        }
+        p2 &= one.f - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            const int index = -kappa;
+            grisu_round(buffer, length, delta, p2, one.f,
+                        wp_w * (index < 20 ? g_pow10[index] : 0));
+            return length;
+        }
+    }
+}
+
+/** Write the shortest digits of a positive, finite, non-zero value to buffer.
+ * The value equals digits * 10^K.
+ *
+ * @return The number of digits written (max 17).
+ */
+static int grisu2(const double value, char *buffer, int *K) {
+    const bsg_diy_fp v = diy_fp_from_double(value);
+    bsg_diy_fp w_m, w_p;
+    diy_fp_boundaries(v, &w_m, &w_p);
+
+    const bsg_diy_fp c_mk = cached_power(w_p.e, K);
+    const bsg_diy_fp W = diy_fp_multiply(diy_fp_normalize(v), c_mk);
+    bsg_diy_fp Wp = diy_fp_multiply(w_p, c_mk);
+    bsg_diy_fp Wm = diy_fp_multiply(w_m, c_mk);
+    Wm.f++;
+    Wp.f--;
+    return grisu_digit_gen(W, Wp, Wp.f - Wm.f, buffer, K);
+}
+
+size_t bsg_double_to_shortest_string(double value, char* dst) {
+    char *out = dst;
+
+    if (isnan(value)) {
+        strlcpy(dst, "nan", 4);
+        return 3;
+    }
+    if (value < 0) {
+        *out++ = '-';
+        value = -value;
+    }
+    if (isinf(value)) {
+        strlcpy(out, "inf", 4);
+        return (size_t)(out - dst) + 3;
+    }
+    if (value == 0) {
+        // Also covers -0.0, which is not < 0
+        out[0] = '0';
+        out[1] = 0;
+        return (size_t)(out - dst) + 1;
+    }
+
+    char digits[20];
+    int K = 0;
+    const int length = grisu2(value, digits, &K);
+    // Decimal exponent of the first digit.
+    const int exponent = length + K - 1;
+
+    // Same layout as bsg_double_to_string: d[.ddd][e(+|-)x]
+    *out++ = digits[0];
+    if (length > 1) {
+        *out++ = '.';
+        memcpy(out, digits + 1, (size_t)(length - 1));
+        out += length - 1;
+    }
+    if (exponent != 0) {
+        *out++ = 'e';
+        if (exponent > 0) {
+            *out++ = '+';
+        }
+        out += bsg_int64_to_string(exponent, out);
+    } else {
+        *out = 0;
+    }
+    return (size_t)(out - dst);
+}
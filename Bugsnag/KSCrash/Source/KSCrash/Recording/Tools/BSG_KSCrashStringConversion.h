@@ -65,6 +65,20 @@ size_t bsg_uint64_to_hex(uint64_t value, char* dst, int min_digits);
  */
 size_t bsg_double_to_string(double value, char* dst, int max_sig_digits);
 
+/**
+ * Convert a double to the shortest string that converts back to the same value.
+ * Uses the same layout as bsg_double_to_string, i.e. values with an exponent
+ * other than 0 are always printed in exponential form.
+ *
+ * This function is async-safe: it does not allocate memory or take locks, and
+ * works from a static table of powers of ten.
+ *
+ * This function will write a maximum of 25 characters (including the NUL) to dst.
+ *
+ * Returns the length of the string written to dst (not including the NUL).
+ */
+size_t bsg_double_to_shortest_string(double value, char* dst);
+
 
 #ifdef __cplusplus
 }
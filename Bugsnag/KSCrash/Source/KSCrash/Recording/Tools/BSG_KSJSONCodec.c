@@ -32,6 +32,20 @@
 #include <stdint.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BSG_KSJSONCODEC_HAVE_SSE2 1
+#else
+#define BSG_KSJSONCODEC_HAVE_SSE2 0
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BSG_KSJSONCODEC_HAVE_NEON 1
+#else
+#define BSG_KSJSONCODEC_HAVE_NEON 0
+#endif
+
 // ============================================================================
 #pragma mark - Configuration -
 // ============================================================================
@@ -55,11 +69,12 @@
 #define BSG_KSJSONCODEC_WorkBufferSize 512
 #endif
 
-/**
- * The maximum number of significant digits when printing floats.
- * 7 (6 + 1 whole digit in exp form) is the default used by the old sprintf code.
+/** Runs of unescaped characters at least this long are passed directly to the
+ * data handler rather than being copied into the work buffer.
  */
-#define MAX_SIGNIFICANT_DIGITS 7
+#ifndef BSG_KSJSONCODEC_DirectRunLength
+#define BSG_KSJSONCODEC_DirectRunLength 32
+#endif
 
 // ============================================================================
 #pragma mark - Helpers -
@@ -95,8 +110,46 @@ const char *bsg_ksjsonstringForError(const int error) {
 
 // Avoiding static functions due to linker issues.
 
+int bsg_ksjsonflush(BSG_KSJSONEncodeContext *const context) {
+    size_t length = (size_t)(context->outputCursor - context->outputStart);
+    unlikely_if(length == 0) { return BSG_KSJSON_OK; }
+    context->outputCursor = context->outputStart;
+    return context->addJSONData(context->outputStart, length,
+                                context->userData);
+}
+
+/** Add JSON encoded data that does not fit in the output buffer, or when there
+ * is no output buffer.
+ *
+ * @param context The encoding context.
+ *
+ * @param data The encoded data.
+ *
+ * @param length The length of the data.
+ *
+ * @return true if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_addJSONDataSlow(BSG_KSJSONEncodeContext *const context,
+                                      const char *const data,
+                                      const size_t length) {
+    unlikely_if(context->outputStart == NULL) {
+        return context->addJSONData(data, length, context->userData);
+    }
+    int result = bsg_ksjsonflush(context);
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(length >=
+                (size_t)(context->outputLimit - context->outputStart)) {
+        return context->addJSONData(data, length, context->userData);
+    }
+    memcpy(context->outputCursor, data, length);
+    context->outputCursor += length;
+    return BSG_KSJSON_OK;
+}
+
 /** Add JSON encoded data to an external handler.
  * The external handler will decide how to handle the data (store/transmit/etc).
+ * If the context has an output buffer, the data is appended to that instead
+ * and only passed on when the buffer fills.
  *
  * @param context The encoding context.
  *
@@ -106,10 +159,75 @@ const char *bsg_ksjsonstringForError(const int error) {
  *
  * @return true if the data was handled successfully.
  */
+static inline int bsg_ksjsoncodec_i_addJSONData(
+    BSG_KSJSONEncodeContext *const context, const char *const data,
+    const size_t length) {
+    // Strictly less than, so that a context without an output buffer (where
+    // cursor == limit == NULL) always takes the slow path.
+    likely_if(length < (size_t)(context->outputLimit - context->outputCursor)) {
+        memcpy(context->outputCursor, data, length);
+        context->outputCursor += length;
+        return BSG_KSJSON_OK;
+    }
+    return bsg_ksjsoncodec_i_addJSONDataSlow(context, data, length);
+}
+
 #define addJSONData(CONTEXT, DATA, LENGTH)                                     \
-    (CONTEXT)->addJSONData(DATA, LENGTH, (CONTEXT)->userData)
+    bsg_ksjsoncodec_i_addJSONData(CONTEXT, DATA, LENGTH)
+
+size_t bsg_ksjsoncodec_i_unescapedLength(const char *const string,
+                                         const size_t length) {
+    const unsigned char *const start = (const unsigned char *)string;
+    const unsigned char *const end = start + length;
+    const unsigned char *src = start;
+
+#if BSG_KSJSONCODEC_HAVE_SSE2
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i maxControl = _mm_set1_epi8(' ' - 1);
+    for (; end - src >= 16; src += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(const void *)src);
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                         _mm_cmpeq_epi8(chunk, backslash)),
+            // Unsigned chunk <= 0x1F
+            _mm_cmpeq_epi8(_mm_min_epu8(chunk, maxControl), chunk));
+        int mask = _mm_movemask_epi8(special);
+        unlikely_if(mask != 0) {
+            return (size_t)(src - start) + (size_t)__builtin_ctz((unsigned)mask);
+        }
+    }
+#elif BSG_KSJSONCODEC_HAVE_NEON
+    const uint8x16_t quote = vdupq_n_u8('\"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(' ');
+    for (; end - src >= 16; src += 16) {
+        uint8x16_t chunk = vld1q_u8(src);
+        uint8x16_t special =
+            vorrq_u8(vorrq_u8(vceqq_u8(chunk, quote), vceqq_u8(chunk, backslash)),
+                     vcltq_u8(chunk, space));
+        // Narrow each 0x00/0xFF byte to a nybble so the whole mask fits in 64
+        // bits and the first match can be found with a bit scan.
+        uint64_t mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)),
+            0);
+        unlikely_if(mask != 0) {
+            return (size_t)(src - start) + (size_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+
+    for (; src < end; src++) {
+        unlikely_if(*src == '\\' || *src == '\"' || *src < ' ') { break; }
+    }
+    return (size_t)(src - start);
+}
 
-/** Escape a string portion for use with JSON and send to data handler.
+/** Escape a string for use with JSON and send to data handler.
+ *
+ * Runs of characters that need no escaping are passed straight to the data
+ * handler; only escape sequences and short runs between them are assembled in
+ * the work buffer.
  *
  * @param context The JSON context.
  *
@@ -127,29 +245,51 @@ int bsg_ksjsoncodec_i_appendEscapedString(
 
     const char *restrict src = string;
     char *restrict dst = workBuffer;
+    int result;
 
-    // Simple case (no escape or special characters)
-    for (; src < srcEnd && *src != '\\' && *src != '\"' &&
-           (unsigned char)*src >= ' ';
-         src++) {
-        *dst++ = *src;
-    }
+    while (src < srcEnd) {
+        size_t runLength = bsg_ksjsoncodec_i_unescapedLength(
+            src, (size_t)(srcEnd - src));
+        if (runLength > 0) {
+            size_t buffered = (size_t)(dst - workBuffer);
+            bool runEndsString = src + runLength == srcEnd;
+            likely_if((buffered == 0 && runEndsString) ||
+                      runLength >= BSG_KSJSONCODEC_DirectRunLength ||
+                      buffered + runLength + 6 > BSG_KSJSONCODEC_WorkBufferSize) {
+                // Flush what has been escaped so far, then hand the clean run
+                // to the data handler without copying it.
+                unlikely_if(buffered > 0) {
+                    unlikely_if((result = addJSONData(context, workBuffer,
+                                                      buffered)) != BSG_KSJSON_OK) {
+                        return result;
+                    }
+                    dst = workBuffer;
+                }
+                unlikely_if((result = addJSONData(context, src, runLength)) !=
+                            BSG_KSJSON_OK) {
+                    return result;
+                }
+            } else {
+                memcpy(dst, src, runLength);
+                dst += runLength;
+            }
+            src += runLength;
+            if (src >= srcEnd) {
+                break;
+            }
+        }
 
-    // Deal with complicated case (if any)
-    int result;
-    for (; src < srcEnd; src++) {
-        
-        // If we add an escaped control character this may exceed the buffer by up to
-        // 6 characters: add this chunk now, reset the buffer and carry on
+        // An escaped control character may need up to 6 characters: add this
+        // chunk now, reset the buffer and carry on
         if (dst + 6 > workBuffer + BSG_KSJSONCODEC_WorkBufferSize) {
             size_t encLength = (size_t)(dst - workBuffer);
-            unlikely_if((result = addJSONData(context, dst - encLength, encLength)) !=
+            unlikely_if((result = addJSONData(context, workBuffer, encLength)) !=
                         BSG_KSJSON_OK) {
                 return result;
             }
             dst = workBuffer;
         }
-        
+
         switch (*src) {
         case '\\':
         case '\"':
@@ -176,29 +316,27 @@ int bsg_ksjsoncodec_i_appendEscapedString(
             *dst++ = '\\';
             *dst++ = 't';
             break;
-        default:
-
+        default: {
             // escape control chars (U+0000 - U+001F)
             // see https://www.ietf.org/rfc/rfc4627.txt
+            unsigned int last = (unsigned int)*src % 16;
+            unsigned int first = ((unsigned int)*src - last) / 16;
 
-            if ((unsigned char)*src < ' ') {
-                unsigned int last = (unsigned int)*src % 16;
-                unsigned int first = ((unsigned int)*src - last) / 16;
-
-                *dst++ = '\\';
-                *dst++ = 'u';
-                *dst++ = '0';
-                *dst++ = '0';
-                *dst++ = bsg_g_hexNybbles[first];
-                *dst++ = bsg_g_hexNybbles[last];
-            } else {
-                *dst++ = *src;
-            }
+            *dst++ = '\\';
+            *dst++ = 'u';
+            *dst++ = '0';
+            *dst++ = '0';
+            *dst++ = bsg_g_hexNybbles[first];
+            *dst++ = bsg_g_hexNybbles[last];
             break;
         }
+        }
+        src++;
     }
+
     size_t encLength = (size_t)(dst - workBuffer);
-    return addJSONData(context, dst - encLength, encLength);
+    unlikely_if(encLength == 0) { return BSG_KSJSON_OK; }
+    return addJSONData(context, workBuffer, encLength);
 }
 
 /** Escape a string for use with JSON and send to data handler.
@@ -214,21 +352,7 @@ int bsg_ksjsoncodec_i_appendEscapedString(
 int bsg_ksjsoncodec_i_addEscapedString(BSG_KSJSONEncodeContext *const context,
                                        const char *restrict const string,
                                        size_t length) {
-    int result = BSG_KSJSON_OK;
-
-    // Keep adding portions until the whole string has been processed.
-    size_t offset = 0;
-    while (offset < length) {
-        size_t toAdd = length - offset;
-        unlikely_if(toAdd > BSG_KSJSONCODEC_WorkBufferSize) {
-            toAdd = BSG_KSJSONCODEC_WorkBufferSize;
-        }
-        result = bsg_ksjsoncodec_i_appendEscapedString(context, string + offset,
-                                                       toAdd);
-        unlikely_if(result != BSG_KSJSON_OK) { break; }
-        offset += toAdd;
-    }
-    return result;
+    return bsg_ksjsoncodec_i_appendEscapedString(context, string, length);
 }
 
 /** Escape and quote a string for use with JSON and send to data handler.
@@ -255,8 +379,150 @@ int bsg_ksjsoncodec_i_addQuotedEscapedString(
     return addJSONData(context, "\"", 1);
 }
 
-int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
-                           const char *const name) {
+// ============================================================================
+#pragma mark - Binary Encode -
+// ============================================================================
+
+/* In binary mode (see bsg_ksjsonbeginBinaryEncode) the encoder writes the
+ * following subset of CBOR (RFC 8949) instead of JSON text, using the same
+ * container bookkeeping:
+ *
+ *   names                definite text strings, only inside objects
+ *   objects, arrays      indefinite maps (0xbf) and arrays (0x9f) ... break
+ *   integers             major types 0 (unsigned) and 1 (negative)
+ *   floating point       64-bit floats (0xfb)
+ *   true, false, null    0xf5, 0xf4, 0xf6
+ *   strings              definite text, or indefinite text (0x7f) ... break
+ *   data                 indefinite byte strings (0x5f) ... break
+ *   pre-formatted JSON   tag 262 (embedded JSON) followed by text
+ *
+ * Output starts with the self-describe tag (0xd9d9f7), so it can never be
+ * mistaken for JSON text. bsg_ksjsontranscodeBinary() converts it back.
+ */
+
+#define BSG_KSCBOR_Unsigned (0 << 5)
+#define BSG_KSCBOR_Negative (1 << 5)
+#define BSG_KSCBOR_Bytes (2 << 5)
+#define BSG_KSCBOR_Text (3 << 5)
+#define BSG_KSCBOR_Array (4 << 5)
+#define BSG_KSCBOR_Map (5 << 5)
+#define BSG_KSCBOR_Tag (6 << 5)
+#define BSG_KSCBOR_Simple (7 << 5)
+#define BSG_KSCBOR_MajorTypeMask 0xe0
+#define BSG_KSCBOR_InfoMask 0x1f
+#define BSG_KSCBOR_Indefinite 31
+#define BSG_KSCBOR_False 20
+#define BSG_KSCBOR_True 21
+#define BSG_KSCBOR_Null 22
+#define BSG_KSCBOR_Float32 26
+#define BSG_KSCBOR_Float64 27
+#define BSG_KSCBOR_Break 0xff
+#define BSG_KSCBOR_TagEmbeddedJSON 262
+#define BSG_KSCBOR_TagSelfDescribe 55799
+
+/** Write a CBOR initial byte and its big-endian argument.
+ *
+ * @param context The encoding context.
+ *
+ * @param majorType One of the BSG_KSCBOR major types.
+ *
+ * @param value The argument (length, value or tag number).
+ *
+ * @return BSG_KSJSON_OK if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_binaryHead(BSG_KSJSONEncodeContext *const context,
+                                 const uint8_t majorType, uint64_t value) {
+    uint8_t buff[9];
+    size_t argumentLength;
+    likely_if(value < 24) {
+        buff[0] = majorType | (uint8_t)value;
+        return addJSONData(context, (const char *)buff, 1);
+    }
+    else if (value <= UINT8_MAX) {
+        buff[0] = majorType | 24;
+        argumentLength = 1;
+    }
+    else if (value <= UINT16_MAX) {
+        buff[0] = majorType | 25;
+        argumentLength = 2;
+    }
+    else if (value <= UINT32_MAX) {
+        buff[0] = majorType | 26;
+        argumentLength = 4;
+    }
+    else {
+        buff[0] = majorType | 27;
+        argumentLength = 8;
+    }
+    for (size_t i = argumentLength; i > 0; i--) {
+        buff[i] = (uint8_t)value;
+        value >>= 8;
+    }
+    return addJSONData(context, (const char *)buff, argumentLength + 1);
+}
+
+/** Write a CBOR byte that carries no argument (simple values, indefinite
+ * length markers and break).
+ */
+static inline int bsg_ksjsoncodec_i_binaryByte(
+    BSG_KSJSONEncodeContext *const context, const uint8_t byte) {
+    return addJSONData(context, (const char *)&byte, 1);
+}
+
+/** Write a definite length text or byte string. */
+int bsg_ksjsoncodec_i_binaryString(BSG_KSJSONEncodeContext *const context,
+                                   const uint8_t majorType,
+                                   const char *const value,
+                                   const size_t length) {
+    int result = bsg_ksjsoncodec_i_binaryHead(context, majorType, length);
+    unlikely_if(result != BSG_KSJSON_OK || length == 0) { return result; }
+    return addJSONData(context, value, length);
+}
+
+/** Terminate pre-formatted JSON that was written via bsg_ksjsonaddRawJSONData.
+ */
+int bsg_ksjsoncodec_i_binaryCloseRawJSON(
+    BSG_KSJSONEncodeContext *const context) {
+    likely_if(!context->binaryRawJSONOpen) { return BSG_KSJSON_OK; }
+    context->binaryRawJSONOpen = false;
+    return bsg_ksjsoncodec_i_binaryByte(context, BSG_KSCBOR_Break);
+}
+
+/** Begin a binary element, writing its name if we're in an object.
+ *
+ * @param context The encoding context.
+ *
+ * @param name The element's name (need not be NUL terminated).
+ *
+ * @param length The length of name.
+ *
+ * @return BSG_KSJSON_OK if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_binaryBeginElement(BSG_KSJSONEncodeContext *const context,
+                                         const char *const name,
+                                         const size_t length) {
+    int result = bsg_ksjsoncodec_i_binaryCloseRawJSON(context);
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    if (context->isObject[context->containerLevel]) {
+        unlikely_if(name == NULL) {
+            BSG_KSLOG_ERROR("Name was null inside an object");
+            return BSG_KSJSON_ERROR_INVALID_DATA;
+        }
+        return bsg_ksjsoncodec_i_binaryString(context, BSG_KSCBOR_Text, name,
+                                              length);
+    }
+    return BSG_KSJSON_OK;
+}
+
+/** Write the separator (and pretty printing indentation) that precedes a new
+ * element in the current container.
+ *
+ * @param context The JSON context.
+ *
+ * @return true if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_beginElementSeparator(
+    BSG_KSJSONEncodeContext *const context) {
     int result = BSG_KSJSON_OK;
 
     // Decide if a comma is warranted.
@@ -281,6 +547,24 @@ int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
             }
         }
     }
+    return result;
+}
+
+/** Begin a JSON element, adding the separator and, if we're in an object, the
+ * element's name.
+ *
+ * @param context The JSON context.
+ *
+ * @param name The element's name (need not be NUL terminated).
+ *
+ * @param length The length of name, or BSG_KSJSON_SIZE_AUTOMATIC.
+ *
+ * @return BSG_KSJSON_OK if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_beginNamedElement(BSG_KSJSONEncodeContext *const context,
+                                        const char *const name, size_t length) {
+    int result = bsg_ksjsoncodec_i_beginElementSeparator(context);
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
 
     // Add a name field if we're in an object.
     if (context->isObject[context->containerLevel]) {
@@ -288,8 +572,11 @@ int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
             BSG_KSLOG_ERROR("Name was null inside an object");
             return BSG_KSJSON_ERROR_INVALID_DATA;
         }
+        if (length == BSG_KSJSON_SIZE_AUTOMATIC) {
+            length = strlen(name);
+        }
         unlikely_if((result = bsg_ksjsoncodec_i_addQuotedEscapedString(
-                         context, name, strlen(name))) != BSG_KSJSON_OK) {
+                         context, name, length)) != BSG_KSJSON_OK) {
             return result;
         }
         unlikely_if(context->prettyPrint) {
@@ -308,8 +595,71 @@ int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
     return result;
 }
 
+int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
+                           const char *const name) {
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryBeginElement(context, name,
+                                                    name ? strlen(name) : 0);
+    }
+    return bsg_ksjsoncodec_i_beginNamedElement(context, name,
+                                               BSG_KSJSON_SIZE_AUTOMATIC);
+}
+
+int bsg_ksjsonbeginEncodedElement(BSG_KSJSONEncodeContext *const context,
+                                  const char *const encodedName,
+                                  const size_t length) {
+    unlikely_if(context->binary) {
+        // Strip the quotes and colon added by BSG_KSJSON_ENCODED_NAME.
+        return bsg_ksjsoncodec_i_binaryBeginElement(context, encodedName + 1,
+                                                    length - 3);
+    }
+    int result = bsg_ksjsoncodec_i_beginElementSeparator(context);
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
+
+    // Add the name field if we're in an object.
+    if (context->isObject[context->containerLevel]) {
+        unlikely_if((result = addJSONData(context, encodedName, length)) !=
+                    BSG_KSJSON_OK) {
+            return result;
+        }
+        unlikely_if(context->prettyPrint) {
+            return addJSONData(context, " ", 1);
+        }
+    }
+    return result;
+}
+
 int bsg_ksjsonaddRawJSONData(BSG_KSJSONEncodeContext *const context,
                              const char *const data, const size_t length) {
+    unlikely_if(context->binary) {
+        // Consecutive pieces of raw JSON form one embedded JSON value, which
+        // is terminated by the next element or the end of the container.
+        unlikely_if(!context->binaryRawJSONOpen) {
+            int result = bsg_ksjsoncodec_i_binaryHead(
+                context, BSG_KSCBOR_Tag, BSG_KSCBOR_TagEmbeddedJSON);
+            unlikely_if(result != BSG_KSJSON_OK) { return result; }
+            result = bsg_ksjsoncodec_i_binaryByte(
+                context, BSG_KSCBOR_Text | BSG_KSCBOR_Indefinite);
+            unlikely_if(result != BSG_KSJSON_OK) { return result; }
+            context->binaryRawJSONOpen = true;
+        }
+        return bsg_ksjsoncodec_i_binaryString(context, BSG_KSCBOR_Text, data,
+                                              length);
+    }
+    return addJSONData(context, data, length);
+}
+
+int bsg_ksjsonaddEncodedElements(BSG_KSJSONEncodeContext *const context,
+                                 const char *const data, const size_t length) {
+    unlikely_if(length == 0) { return BSG_KSJSON_OK; }
+    int result;
+    unlikely_if(context->binary) {
+        result = bsg_ksjsoncodec_i_binaryCloseRawJSON(context);
+    }
+    else {
+        result = bsg_ksjsoncodec_i_beginElementSeparator(context);
+    }
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
     return addJSONData(context, data, length);
 }
 
@@ -317,6 +667,11 @@ int bsg_ksjsonaddBooleanElement(BSG_KSJSONEncodeContext *const context,
                                 const char *const name, const bool value) {
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryByte(
+            context, BSG_KSCBOR_Simple |
+                         (value ? BSG_KSCBOR_True : BSG_KSCBOR_False));
+    }
     if (value) {
         return addJSONData(context, "true", 4);
     } else {
@@ -328,15 +683,32 @@ int bsg_ksjsonaddFloatingPointElement(BSG_KSJSONEncodeContext *const context,
                                       const char *const name, double value) {
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint8_t buff[9] = {BSG_KSCBOR_Simple | BSG_KSCBOR_Float64};
+        for (int i = 8; i > 0; i--) {
+            buff[i] = (uint8_t)bits;
+            bits >>= 8;
+        }
+        return addJSONData(context, (const char *)buff, sizeof(buff));
+    }
     char buff[30];
-    bsg_double_to_string(value, buff, MAX_SIGNIFICANT_DIGITS);
-    return addJSONData(context, buff, strlen(buff));
+    size_t length = bsg_double_to_shortest_string(value, buff);
+    return addJSONData(context, buff, length);
 }
 
 int bsg_ksjsonaddIntegerElement(BSG_KSJSONEncodeContext *const context,
                                 const char *const name, long long value) {
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        // Negative values are encoded as -1 - value, i.e. ~value.
+        return value < 0 ? bsg_ksjsoncodec_i_binaryHead(
+                               context, BSG_KSCBOR_Negative, ~(uint64_t)value)
+                         : bsg_ksjsoncodec_i_binaryHead(
+                               context, BSG_KSCBOR_Unsigned, (uint64_t)value);
+    }
     char buff[30];
     bsg_int64_to_string(value, buff);
     return addJSONData(context, buff, strlen(buff));
@@ -347,6 +719,9 @@ int bsg_ksjsonaddUIntegerElement(BSG_KSJSONEncodeContext *const context,
                                  unsigned long long value) {
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryHead(context, BSG_KSCBOR_Unsigned, value);
+    }
     char buff[30];
     bsg_uint64_to_string(value, buff);
     return addJSONData(context, buff, strlen(buff));
@@ -395,6 +770,13 @@ int bsg_ksjsonaddJSONElement(BSG_KSJSONEncodeContext *const context,
 
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        result = bsg_ksjsoncodec_i_binaryHead(context, BSG_KSCBOR_Tag,
+                                              BSG_KSCBOR_TagEmbeddedJSON);
+        unlikely_if(result != BSG_KSJSON_OK) { return result; }
+        return bsg_ksjsoncodec_i_binaryString(context, BSG_KSCBOR_Text,
+                                              element, length);
+    }
     return addJSONData(context, element, length);
 }
 
@@ -402,6 +784,10 @@ int bsg_ksjsonaddNullElement(BSG_KSJSONEncodeContext *const context,
                              const char *const name) {
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryByte(context,
+                                            BSG_KSCBOR_Simple | BSG_KSCBOR_Null);
+    }
     return addJSONData(context, "null", 4);
 }
 
@@ -416,6 +802,10 @@ int bsg_ksjsonaddStringElement(BSG_KSJSONEncodeContext *const context,
     if (length == BSG_KSJSON_SIZE_AUTOMATIC) {
         length = strlen(value);
     }
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryString(context, BSG_KSCBOR_Text, value,
+                                              length);
+    }
     return bsg_ksjsoncodec_i_addQuotedEscapedString(context, value, length);
 }
 
@@ -423,15 +813,26 @@ int bsg_ksjsonbeginStringElement(BSG_KSJSONEncodeContext *const context,
                                  const char *const name) {
     int result = bsg_ksjsonbeginElement(context, name);
     unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryByte(
+            context, BSG_KSCBOR_Text | BSG_KSCBOR_Indefinite);
+    }
     return addJSONData(context, "\"", 1);
 }
 
 int bsg_ksjsonappendStringElement(BSG_KSJSONEncodeContext *const context,
                                   const char *const value, size_t length) {
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryString(context, BSG_KSCBOR_Text, value,
+                                              length);
+    }
     return bsg_ksjsoncodec_i_addEscapedString(context, value, length);
 }
 
 int bsg_ksjsonendStringElement(BSG_KSJSONEncodeContext *const context) {
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryByte(context, BSG_KSCBOR_Break);
+    }
     return addJSONData(context, "\"", 1);
 }
 
@@ -451,11 +852,27 @@ int bsg_ksjsonaddDataElement(BSG_KSJSONEncodeContext *const context,
 
 int bsg_ksjsonbeginDataElement(BSG_KSJSONEncodeContext *const context,
                                const char *const name) {
+    unlikely_if(context->binary) {
+        int result = bsg_ksjsonbeginElement(context, name);
+        unlikely_if(result != BSG_KSJSON_OK) { return result; }
+        return bsg_ksjsoncodec_i_binaryByte(
+            context, BSG_KSCBOR_Bytes | BSG_KSCBOR_Indefinite);
+    }
     return bsg_ksjsonbeginStringElement(context, name);
 }
 
-int bsg_ksjsonappendDataElement(BSG_KSJSONEncodeContext *const context,
-                                const char *const value, size_t length) {
+/** Write data as hex digits, without quotes.
+ *
+ * @param context The JSON context.
+ *
+ * @param value The data.
+ *
+ * @param length The length of the data.
+ *
+ * @return BSG_KSJSON_OK if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_addHexData(BSG_KSJSONEncodeContext *const context,
+                                 const char *const value, size_t length) {
     const unsigned char *currentByte = (const unsigned char *)value;
     const unsigned char *end = currentByte + length;
     char chars[2];
@@ -472,22 +889,48 @@ int bsg_ksjsonappendDataElement(BSG_KSJSONEncodeContext *const context,
     return result;
 }
 
+int bsg_ksjsonappendDataElement(BSG_KSJSONEncodeContext *const context,
+                                const char *const value, size_t length) {
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryString(context, BSG_KSCBOR_Bytes, value,
+                                              length);
+    }
+    return bsg_ksjsoncodec_i_addHexData(context, value, length);
+}
+
 int bsg_ksjsonendDataElement(BSG_KSJSONEncodeContext *const context) {
     return bsg_ksjsonendStringElement(context);
 }
 
+/** Open a new container after its element has been begun.
+ *
+ * @param context The JSON context.
+ *
+ * @param isObject true for an object, false for an array.
+ *
+ * @return true if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_openContainer(BSG_KSJSONEncodeContext *const context,
+                                    const bool isObject) {
+    context->containerLevel++;
+    context->isObject[context->containerLevel] = isObject;
+    context->containerFirstEntry = true;
+
+    unlikely_if(context->binary) {
+        return bsg_ksjsoncodec_i_binaryByte(
+            context, (isObject ? BSG_KSCBOR_Map : BSG_KSCBOR_Array) |
+                         BSG_KSCBOR_Indefinite);
+    }
+    return addJSONData(context, isObject ? "{" : "[", 1);
+}
+
 int bsg_ksjsonbeginArray(BSG_KSJSONEncodeContext *const context,
                          const char *const name) {
     likely_if(context->containerLevel >= 0) {
         int result = bsg_ksjsonbeginElement(context, name);
         unlikely_if(result != BSG_KSJSON_OK) { return result; }
     }
-
-    context->containerLevel++;
-    context->isObject[context->containerLevel] = false;
-    context->containerFirstEntry = true;
-
-    return addJSONData(context, "[", 1);
+    return bsg_ksjsoncodec_i_openContainer(context, false);
 }
 
 int bsg_ksjsonbeginObject(BSG_KSJSONEncodeContext *const context,
@@ -496,12 +939,23 @@ int bsg_ksjsonbeginObject(BSG_KSJSONEncodeContext *const context,
         int result = bsg_ksjsonbeginElement(context, name);
         unlikely_if(result != BSG_KSJSON_OK) { return result; }
     }
+    return bsg_ksjsoncodec_i_openContainer(context, true);
+}
 
-    context->containerLevel++;
-    context->isObject[context->containerLevel] = true;
-    context->containerFirstEntry = true;
+int bsg_ksjsonbeginEncodedArray(BSG_KSJSONEncodeContext *const context,
+                                const char *const encodedName,
+                                const size_t length) {
+    int result = bsg_ksjsonbeginEncodedElement(context, encodedName, length);
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    return bsg_ksjsoncodec_i_openContainer(context, false);
+}
 
-    return addJSONData(context, "{", 1);
+int bsg_ksjsonbeginEncodedObject(BSG_KSJSONEncodeContext *const context,
+                                 const char *const encodedName,
+                                 const size_t length) {
+    int result = bsg_ksjsonbeginEncodedElement(context, encodedName, length);
+    unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    return bsg_ksjsoncodec_i_openContainer(context, true);
 }
 
 int bsg_ksjsonendContainer(BSG_KSJSONEncodeContext *const context) {
@@ -510,6 +964,12 @@ int bsg_ksjsonendContainer(BSG_KSJSONEncodeContext *const context) {
     bool isObject = context->isObject[context->containerLevel];
     context->containerLevel--;
 
+    unlikely_if(context->binary) {
+        int result = bsg_ksjsoncodec_i_binaryCloseRawJSON(context);
+        unlikely_if(result != BSG_KSJSON_OK) { return result; }
+        return bsg_ksjsoncodec_i_binaryByte(context, BSG_KSCBOR_Break);
+    }
+
     // Pretty printing
     unlikely_if(context->prettyPrint && !context->containerFirstEntry) {
         int result;
@@ -538,6 +998,22 @@ void bsg_ksjsonbeginEncode(BSG_KSJSONEncodeContext *const context,
     context->containerFirstEntry = true;
 }
 
+void bsg_ksjsonbeginBinaryEncode(BSG_KSJSONEncodeContext *const context,
+                                 BSG_KSJSONAddDataFunc addJSONDataFunc,
+                                 void *const userData) {
+    bsg_ksjsonbeginEncode(context, false, addJSONDataFunc, userData);
+    context->binary = true;
+    bsg_ksjsoncodec_i_binaryHead(context, BSG_KSCBOR_Tag,
+                                 BSG_KSCBOR_TagSelfDescribe);
+}
+
+void bsg_ksjsonsetOutputBuffer(BSG_KSJSONEncodeContext *const context,
+                               char *const buffer, const size_t length) {
+    context->outputStart = buffer;
+    context->outputCursor = buffer;
+    context->outputLimit = buffer ? buffer + length : NULL;
+}
+
 int bsg_ksjsonendEncode(BSG_KSJSONEncodeContext *const context) {
     int result = BSG_KSJSON_OK;
     while (context->containerLevel > 0) {
@@ -546,5 +1022,291 @@ int bsg_ksjsonendEncode(BSG_KSJSONEncodeContext *const context) {
             return result;
         }
     }
-    return result;
+    unlikely_if(context->binary) {
+        unlikely_if((result = bsg_ksjsoncodec_i_binaryCloseRawJSON(context)) !=
+                    BSG_KSJSON_OK) {
+            return result;
+        }
+    }
+    return bsg_ksjsonflush(context);
+}
+
+// ============================================================================
+#pragma mark - Binary Transcode -
+// ============================================================================
+
+typedef struct {
+    const uint8_t *cursor;
+    const uint8_t *end;
+} BSG_KSCBORReader;
+
+typedef struct {
+    /** The major type (one of the BSG_KSCBOR major types). */
+    uint8_t majorType;
+    /** The additional information (low 5 bits of the initial byte). */
+    uint8_t info;
+    /** The argument: a value, length, tag number or simple value. */
+    uint64_t value;
+} BSG_KSCBORHead;
+
+/** Read a CBOR initial byte and its argument.
+ *
+ * @param reader The reader.
+ *
+ * @param head Receives the decoded head.
+ *
+ * @return BSG_KSJSON_OK, or an error if the head is truncated or uses a
+ *         reserved encoding.
+ */
+int bsg_ksjsoncodec_i_readBinaryHead(BSG_KSCBORReader *const reader,
+                                     BSG_KSCBORHead *const head) {
+    unlikely_if(reader->cursor >= reader->end) {
+        return BSG_KSJSON_ERROR_INCOMPLETE;
+    }
+    const uint8_t byte = *reader->cursor++;
+    head->majorType = byte & BSG_KSCBOR_MajorTypeMask;
+    head->info = byte & BSG_KSCBOR_InfoMask;
+    likely_if(head->info < 24 || head->info == BSG_KSCBOR_Indefinite) {
+        head->value = head->info < 24 ? head->info : 0;
+        return BSG_KSJSON_OK;
+    }
+    unlikely_if(head->info > 27) { return BSG_KSJSON_ERROR_INVALID_DATA; }
+    const size_t argumentLength = (size_t)1 << (head->info - 24);
+    unlikely_if((size_t)(reader->end - reader->cursor) < argumentLength) {
+        return BSG_KSJSON_ERROR_INCOMPLETE;
+    }
+    head->value = 0;
+    for (size_t i = 0; i < argumentLength; i++) {
+        head->value = (head->value << 8) | *reader->cursor++;
+    }
+    return BSG_KSJSON_OK;
+}
+
+/** Take the payload of a definite length string from the reader.
+ *
+ * @return BSG_KSJSON_OK, or BSG_KSJSON_ERROR_INCOMPLETE if truncated.
+ */
+int bsg_ksjsoncodec_i_readBinaryPayload(BSG_KSCBORReader *const reader,
+                                        const BSG_KSCBORHead *const head,
+                                        const char **const payload) {
+    unlikely_if(head->value > (uint64_t)(reader->end - reader->cursor)) {
+        return BSG_KSJSON_ERROR_INCOMPLETE;
+    }
+    *payload = (const char *)reader->cursor;
+    reader->cursor += head->value;
+    return BSG_KSJSON_OK;
+}
+
+/** Write a text or byte string value, which may be split into chunks, as JSON.
+ *
+ * @param context The JSON context.
+ *
+ * @param reader The reader, positioned after the string's head.
+ *
+ * @param head The string's head.
+ *
+ * @param embeddedJSON true if the text is pre-formatted JSON to be copied
+ *                     verbatim, rather than a string to be quoted.
+ *
+ * @return BSG_KSJSON_OK if the data was handled successfully.
+ */
+int bsg_ksjsoncodec_i_transcodeBinaryString(
+    BSG_KSJSONEncodeContext *const context, BSG_KSCBORReader *const reader,
+    const BSG_KSCBORHead *const head, const bool embeddedJSON) {
+    const bool isData = head->majorType == BSG_KSCBOR_Bytes;
+    int result;
+    unlikely_if(!embeddedJSON &&
+                (result = addJSONData(context, "\"", 1)) != BSG_KSJSON_OK) {
+        return result;
+    }
+
+    BSG_KSCBORHead chunk = *head;
+    const bool chunked = head->info == BSG_KSCBOR_Indefinite;
+    for (;;) {
+        if (chunked) {
+            unlikely_if(reader->cursor >= reader->end) {
+                return BSG_KSJSON_ERROR_INCOMPLETE;
+            }
+            if (*reader->cursor == BSG_KSCBOR_Break) {
+                reader->cursor++;
+                break;
+            }
+            unlikely_if((result = bsg_ksjsoncodec_i_readBinaryHead(
+                             reader, &chunk)) != BSG_KSJSON_OK) {
+                return result;
+            }
+            unlikely_if(chunk.majorType != head->majorType ||
+                        chunk.info == BSG_KSCBOR_Indefinite) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+        }
+        const char *payload;
+        unlikely_if((result = bsg_ksjsoncodec_i_readBinaryPayload(
+                         reader, &chunk, &payload)) != BSG_KSJSON_OK) {
+            return result;
+        }
+        const size_t length = (size_t)chunk.value;
+        if (embeddedJSON) {
+            result = addJSONData(context, payload, length);
+        } else if (isData) {
+            result = bsg_ksjsoncodec_i_addHexData(context, payload, length);
+        } else {
+            result = bsg_ksjsoncodec_i_addEscapedString(context, payload,
+                                                        length);
+        }
+        unlikely_if(result != BSG_KSJSON_OK) { return result; }
+        if (!chunked) {
+            break;
+        }
+    }
+
+    return embeddedJSON ? BSG_KSJSON_OK : addJSONData(context, "\"", 1);
+}
+
+/** Write a scalar (simple value or float) as JSON. */
+int bsg_ksjsoncodec_i_transcodeBinarySimple(
+    BSG_KSJSONEncodeContext *const context, const BSG_KSCBORHead *const head) {
+    switch (head->info) {
+    case BSG_KSCBOR_False:
+        return addJSONData(context, "false", 5);
+    case BSG_KSCBOR_True:
+        return addJSONData(context, "true", 4);
+    case BSG_KSCBOR_Null:
+        return addJSONData(context, "null", 4);
+    case BSG_KSCBOR_Float32:
+    case BSG_KSCBOR_Float64: {
+        double value;
+        if (head->info == BSG_KSCBOR_Float32) {
+            uint32_t bits = (uint32_t)head->value;
+            float floatValue;
+            memcpy(&floatValue, &bits, sizeof(floatValue));
+            value = floatValue;
+        } else {
+            memcpy(&value, &head->value, sizeof(value));
+        }
+        char buff[30];
+        return addJSONData(context, buff,
+                           bsg_double_to_shortest_string(value, buff));
+    }
+    default:
+        return BSG_KSJSON_ERROR_INVALID_DATA;
+    }
+}
+
+int bsg_ksjsontranscodeBinary(BSG_KSJSONEncodeContext *const context,
+                              const char *const data, const size_t length) {
+    unlikely_if(context->binary) { return BSG_KSJSON_ERROR_INVALID_DATA; }
+
+    BSG_KSCBORReader reader = {(const uint8_t *)data,
+                               (const uint8_t *)data + length};
+    const int baseLevel = context->containerLevel;
+    const int maxLevel = (int)(sizeof(context->isObject) /
+                               sizeof(*context->isObject)) - 1;
+    int result;
+
+    // Skip the self-describe tag.
+    if (length >= 3 && reader.cursor[0] == 0xd9 && reader.cursor[1] == 0xd9 &&
+        reader.cursor[2] == 0xf7) {
+        reader.cursor += 3;
+    }
+
+    // An empty report is as unusable as a truncated one.
+    unlikely_if(reader.cursor == reader.end) {
+        return BSG_KSJSON_ERROR_INCOMPLETE;
+    }
+
+    while (reader.cursor < reader.end) {
+        // End of the current container.
+        if (*reader.cursor == BSG_KSCBOR_Break) {
+            unlikely_if(context->containerLevel <= baseLevel) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+            reader.cursor++;
+            unlikely_if((result = bsg_ksjsonendContainer(context)) !=
+                        BSG_KSJSON_OK) {
+                return result;
+            }
+            continue;
+        }
+
+        BSG_KSCBORHead head;
+        const char *name = NULL;
+        size_t nameLength = 0;
+        if (context->isObject[context->containerLevel]) {
+            unlikely_if((result = bsg_ksjsoncodec_i_readBinaryHead(
+                             &reader, &head)) != BSG_KSJSON_OK) {
+                return result;
+            }
+            unlikely_if(head.majorType != BSG_KSCBOR_Text ||
+                        head.info == BSG_KSCBOR_Indefinite) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+            unlikely_if((result = bsg_ksjsoncodec_i_readBinaryPayload(
+                             &reader, &head, &name)) != BSG_KSJSON_OK) {
+                return result;
+            }
+            nameLength = (size_t)head.value;
+        }
+
+        unlikely_if((result = bsg_ksjsoncodec_i_readBinaryHead(
+                         &reader, &head)) != BSG_KSJSON_OK) {
+            return result;
+        }
+        unlikely_if((result = bsg_ksjsoncodec_i_beginNamedElement(
+                         context, name, nameLength)) != BSG_KSJSON_OK) {
+            return result;
+        }
+
+        char buff[30];
+        switch (head.majorType) {
+        case BSG_KSCBOR_Unsigned:
+            result = addJSONData(context, buff,
+                                 bsg_uint64_to_string(head.value, buff));
+            break;
+        case BSG_KSCBOR_Negative:
+            unlikely_if(head.value > INT64_MAX) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+            result = addJSONData(
+                context, buff,
+                bsg_int64_to_string(-1 - (int64_t)head.value, buff));
+            break;
+        case BSG_KSCBOR_Bytes:
+        case BSG_KSCBOR_Text:
+            result = bsg_ksjsoncodec_i_transcodeBinaryString(context, &reader,
+                                                             &head, false);
+            break;
+        case BSG_KSCBOR_Array:
+        case BSG_KSCBOR_Map:
+            // Only indefinite length containers are produced by the encoder.
+            unlikely_if(head.info != BSG_KSCBOR_Indefinite ||
+                        context->containerLevel >= maxLevel) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+            result = bsg_ksjsoncodec_i_openContainer(
+                context, head.majorType == BSG_KSCBOR_Map);
+            break;
+        case BSG_KSCBOR_Tag:
+            unlikely_if(head.value != BSG_KSCBOR_TagEmbeddedJSON) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+            unlikely_if((result = bsg_ksjsoncodec_i_readBinaryHead(
+                             &reader, &head)) != BSG_KSJSON_OK) {
+                return result;
+            }
+            unlikely_if(head.majorType != BSG_KSCBOR_Text) {
+                return BSG_KSJSON_ERROR_INVALID_DATA;
+            }
+            result = bsg_ksjsoncodec_i_transcodeBinaryString(context, &reader,
+                                                             &head, true);
+            break;
+        default:
+            result = bsg_ksjsoncodec_i_transcodeBinarySimple(context, &head);
+            break;
+        }
+        unlikely_if(result != BSG_KSJSON_OK) { return result; }
+    }
+
+    return context->containerLevel > baseLevel ? BSG_KSJSON_ERROR_INCOMPLETE
+                                               : BSG_KSJSON_OK;
 }
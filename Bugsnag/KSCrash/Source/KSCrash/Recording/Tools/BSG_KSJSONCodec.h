@@ -110,6 +110,22 @@ typedef struct {
 
     bool prettyPrint;
 
+    /** Optional output buffer (see bsg_ksjsonsetOutputBuffer). */
+    char *outputStart;
+
+    /** Where the next encoded byte will be written in the output buffer. */
+    char *outputCursor;
+
+    /** The end of the output buffer. */
+    char *outputLimit;
+
+    /** If true, write compact binary instead of JSON text
+     * (see bsg_ksjsonbeginBinaryEncode). */
+    bool binary;
+
+    /** Binary mode: true while pre-formatted JSON is being appended. */
+    bool binaryRawJSONOpen;
+
 } BSG_KSJSONEncodeContext;
 
 /** Begin a new encoding process.
@@ -125,7 +141,75 @@ typedef struct {
 void bsg_ksjsonbeginEncode(BSG_KSJSONEncodeContext *context, bool prettyPrint,
                            BSG_KSJSONAddDataFunc addJSONData, void *userData);
 
-/** End the encoding process, ending any remaining open containers.
+/** Begin a new encoding process that writes a compact binary encoding (a
+ * subset of CBOR, RFC 8949) instead of JSON text.
+ *
+ * All of the encoding functions can be used as normal, and produce the same
+ * structure. Names, numbers and strings are written as-is, without escaping
+ * or formatting, and can be converted to the equivalent JSON later using
+ * bsg_ksjsontranscodeBinary().
+ *
+ * @param context The encoding context.
+ *
+ * @param addJSONData Function to handle adding data.
+ *
+ * @param userData User-specified data which gets passed to addJSONData.
+ */
+void bsg_ksjsonbeginBinaryEncode(BSG_KSJSONEncodeContext *context,
+                                 BSG_KSJSONAddDataFunc addJSONData,
+                                 void *userData);
+
+/** Convert data produced by a binary encoding process to JSON.
+ *
+ * The JSON is written to a context that was begun with bsg_ksjsonbeginEncode()
+ * as if the original encoding functions had been called on it. Call
+ * bsg_ksjsonendEncode() afterwards to flush it.
+ *
+ * Only the subset of CBOR written by the binary encoder is accepted.
+ *
+ * @param context The (JSON) encoding context to write to.
+ *
+ * @param data The binary data.
+ *
+ * @param length The length of the binary data.
+ *
+ * @return BSG_KSJSON_OK if the data was converted,
+ *         BSG_KSJSON_ERROR_INCOMPLETE if it ends part way through, or
+ *         BSG_KSJSON_ERROR_INVALID_DATA if it is not valid binary output.
+ */
+int bsg_ksjsontranscodeBinary(BSG_KSJSONEncodeContext *context,
+                              const char *data, size_t length);
+
+/** Give the encoder a buffer to accumulate encoded data in.
+ * Small pieces of JSON are appended to the buffer and only passed on to
+ * addJSONData when it fills up, when a piece is too large to fit, or when the
+ * buffer is flushed. Without an output buffer, every piece of JSON is passed
+ * to addJSONData as soon as it is encoded.
+ *
+ * Must be called after bsg_ksjsonbeginEncode(). The buffer must remain valid
+ * until bsg_ksjsonendEncode() has been called.
+ *
+ * @param context The encoding context.
+ *
+ * @param buffer The buffer to use, or NULL to stop buffering.
+ *
+ * @param length The length of the buffer.
+ */
+void bsg_ksjsonsetOutputBuffer(BSG_KSJSONEncodeContext *context, char *buffer,
+                               size_t length);
+
+/** Pass any data accumulated in the output buffer on to addJSONData.
+ * This must be called before writing to the underlying destination by any
+ * other means.
+ *
+ * @param context The encoding context.
+ *
+ * @return BSG_KSJSON_OK if the process was successful.
+ */
+int bsg_ksjsonflush(BSG_KSJSONEncodeContext *context);
+
+/** End the encoding process, ending any remaining open containers and flushing
+ * the output buffer.
  *
  * @return BSG_KSJSON_OK if the process was successful.
  */
@@ -343,9 +427,63 @@ int bsg_ksjsonbeginArray(BSG_KSJSONEncodeContext *context, const char *name);
 int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
                            const char *const name);
 
+/** Produce a pre-encoded element name from a string literal that contains no
+ * characters requiring escaping, e.g. BSG_KSJSON_ENCODED_NAME("name") yields
+ * "\"name\":".
+ */
+#define BSG_KSJSON_ENCODED_NAME(NAME) "\"" NAME "\":"
+
+/** Begin a generic JSON element using a name that has already been quoted,
+ *  escaped and suffixed with ':' (see BSG_KSJSON_ENCODED_NAME), so that it can
+ *  be written without any further processing.
+ *  Note: This does not add any object or array specifiers ('{', '[').
+ *
+ * @param context The JSON context.
+ *
+ * @param encodedName The encoded name of the next element (only used if parent
+ * is a dictionary).
+ *
+ * @param length The length of encodedName.
+ */
+int bsg_ksjsonbeginEncodedElement(BSG_KSJSONEncodeContext *const context,
+                                  const char *const encodedName,
+                                  const size_t length);
+
+/** Begin a new object container with a pre-encoded name.
+ *
+ * @param context The encoding context.
+ *
+ * @param encodedName The object's encoded name (see BSG_KSJSON_ENCODED_NAME).
+ *
+ * @param length The length of encodedName.
+ *
+ * @return BSG_KSJSON_OK if the process was successful.
+ */
+int bsg_ksjsonbeginEncodedObject(BSG_KSJSONEncodeContext *const context,
+                                 const char *const encodedName,
+                                 const size_t length);
+
+/** Begin a new array container with a pre-encoded name.
+ *
+ * @param context The encoding context.
+ *
+ * @param encodedName The array's encoded name (see BSG_KSJSON_ENCODED_NAME).
+ *
+ * @param length The length of encodedName.
+ *
+ * @return BSG_KSJSON_OK if the process was successful.
+ */
+int bsg_ksjsonbeginEncodedArray(BSG_KSJSONEncodeContext *const context,
+                                const char *const encodedName,
+                                const size_t length);
+
 /** Add JSON data manually.
  * This function just passes your data directly through, even if it's malforned.
  *
+ * When encoding binary, consecutive calls following bsg_ksjsonbeginElement()
+ * make up a single embedded JSON value, which is copied verbatim when
+ * transcoding.
+ *
  * @param context The encoding context.
  *
  * @param data The data to write.
@@ -357,6 +495,22 @@ int bsg_ksjsonbeginElement(BSG_KSJSONEncodeContext *const context,
 int bsg_ksjsonaddRawJSONData(BSG_KSJSONEncodeContext *const context,
                              const char *const data, const size_t length);
 
+/** Add one or more complete elements that were encoded earlier, in the same
+ * format, inside a container of the same kind as the current one (e.g. the
+ * output captured between bsg_ksjsonbeginObject() and bsg_ksjsonendContainer()
+ * of another encode). A separator is written first if needed.
+ *
+ * @param context The encoding context.
+ *
+ * @param data The encoded elements.
+ *
+ * @param length The length of the data.
+ *
+ * @return BSG_KSJSON_OK if the process was successful.
+ */
+int bsg_ksjsonaddEncodedElements(BSG_KSJSONEncodeContext *const context,
+                                 const char *const data, const size_t length);
+
 /** End the current container and return to the next higher level.
  *
  * @param context The encoding context.
@@ -472,6 +626,20 @@ typedef struct BSG_KSJSONDecodeCallbacks {
 
 } BSG_KSJSONDecodeCallbacks;
 
+/** Find the length of the leading run of bytes that can be written to JSON
+ * output without escaping.
+ *
+ * Scans 16 bytes at a time using SSE2 or NEON where available, falling back to
+ * a scalar loop for the tail and on other architectures.
+ *
+ * @param string The string to scan.
+ *
+ * @param length The length of the string.
+ *
+ * @return The offset of the first byte that needs escaping, or length if none.
+ */
+size_t bsg_ksjsoncodec_i_unescapedLength(const char *string, size_t length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,15 +8,23 @@
 
 #include "BSG_KSMachHeaders.h"
 
+#include "BSG_KSCrashReportFields.h"
+#include "BSG_KSJSONCodec.h"
 #include "BSG_KSLogger.h"
 #include "BSG_KSMach.h"
+#include "BSG_Symbolicate.h"
 
 #include <dispatch/dispatch.h>
 #include <dlfcn.h>
 #include <mach-o/dyld.h>
 #include <mach-o/dyld_images.h>
 #include <os/trace.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <uuid/uuid.h>
 
 // Copied from https://github.com/apple/swift/blob/swift-5.0-RELEASE/include/swift/Runtime/Debug.h#L28-L40
 
@@ -41,6 +49,12 @@ static void register_for_changes(void);
 static intptr_t compute_slide(const struct mach_header *header);
 static bool contains_address(BSG_Mach_Header_Info *image, vm_address_t address);
 static const char * get_path(const struct mach_header *header);
+static void render_json(BSG_Mach_Header_Info *image);
+static const char * get_dyld_image_path(const struct mach_header *header);
+static void image_table_add(BSG_Mach_Header_Info *image);
+static void image_table_rebuild(void);
+static void image_names_add(BSG_Mach_Header_Info *image);
+static bool read_load_commands(const struct mach_header *header, intptr_t slide, BSG_Mach_Header_Info *info);
 
 static const struct dyld_all_image_infos *g_all_image_infos;
 
@@ -53,6 +67,7 @@ static _Atomic(BSG_Mach_Header_Info *) g_images_tail = &g_head_dummy;
 static BSG_Mach_Header_Info *g_self_image;
 
 static _Atomic(bool) is_mach_headers_initialized;
+static _Atomic(bool) g_lazy_population;
 
 void bsg_mach_headers_initialize(void) {
     bool expected = false;
@@ -63,6 +78,10 @@ void bsg_mach_headers_initialize(void) {
 
     register_dyld_images();
     register_for_changes();
+    
+    BSG_KSLOG_DEBUG("Registered %u images in %.3f ms (lazy population %s)",
+                    bsg_mach_headers_registration_count(), bsg_mach_headers_registration_duration() * 1000,
+                    atomic_load(&g_lazy_population) ? "on" : "off");
 }
 
 BSG_Mach_Header_Info *bsg_mach_headers_get_images(void) {
@@ -129,9 +148,7 @@ bool bsg_mach_headers_populate_info(const struct mach_header *header, intptr_t s
     
     // Early exit conditions; this is not a valid/useful binary image
     // 1. We can't find a sensible Mach command
-    uintptr_t cmdPtr = bsg_mach_headers_first_cmd_after_header(header);
-    if (cmdPtr == 0) {
-        BSG_KSLOG_ERROR("Invalid mach header @ %p", header);
+    if (!read_load_commands(header, slide, info)) {
         return false;
     }
 
@@ -142,11 +159,27 @@ bool bsg_mach_headers_populate_info(const struct mach_header *header, intptr_t s
         return false;
     }
     
+    info->name = imageName;
+    return true;
+}
+
+/**
+ * Populate the parts of a Mach binary image info structure that can be read from its load commands, i.e. everything
+ * except its name.
+ */
+static bool read_load_commands(const struct mach_header *header, intptr_t slide, BSG_Mach_Header_Info *info) {
+    uintptr_t cmdPtr = bsg_mach_headers_first_cmd_after_header(header);
+    if (cmdPtr == 0) {
+        BSG_KSLOG_ERROR("Invalid mach header @ %p", header);
+        return false;
+    }
+    
     // Look for the TEXT segment to get the image size.
-    // Also look for a UUID command.
+    // Also look for a UUID command and the __crash_info section, so that crash handling does not need to.
     uint64_t imageSize = 0;
     uint64_t imageVmAddr = 0;
     uint8_t *uuid = NULL;
+    uint64_t crashInfoAddr = 0;
 
     for (uint32_t iCmd = 0; iCmd < header->ncmds; iCmd++) {
         struct load_command *loadCmd = (struct load_command *)cmdPtr;
@@ -157,6 +190,12 @@ bool bsg_mach_headers_populate_info(const struct mach_header *header, intptr_t s
                 imageSize = segCmd->vmsize;
                 imageVmAddr = segCmd->vmaddr;
             }
+            const struct section *sections = (const void *)(segCmd + 1);
+            for (uint32_t iSect = 0; iSect < segCmd->nsects; iSect++) {
+                if (strcmp(sections[iSect].sectname, CRASHREPORTER_ANNOTATIONS_SECTION) == 0) {
+                    crashInfoAddr = sections[iSect].addr;
+                }
+            }
             break;
         }
         case LC_SEGMENT_64: {
@@ -166,6 +205,12 @@ bool bsg_mach_headers_populate_info(const struct mach_header *header, intptr_t s
                 imageSize = segCmd->vmsize;
                 imageVmAddr = segCmd->vmaddr;
             }
+            const struct section_64 *sections = (const void *)(segCmd + 1);
+            for (uint32_t iSect = 0; iSect < segCmd->nsects; iSect++) {
+                if (strcmp(sections[iSect].sectname, CRASHREPORTER_ANNOTATIONS_SECTION) == 0) {
+                    crashInfoAddr = sections[iSect].addr;
+                }
+            }
             break;
         }
         case LC_UUID: {
@@ -179,43 +224,154 @@ bool bsg_mach_headers_populate_info(const struct mach_header *header, intptr_t s
     
     // Sanity checks that should never fail
     if (((uintptr_t)imageVmAddr + (uintptr_t)slide) != (uintptr_t)header) {
-        BSG_KSLOG_ERROR("Mach header != (vmaddr + slide) for %s; symbolication will be compromised.", imageName);
+        BSG_KSLOG_ERROR("Mach header != (vmaddr + slide) @ %p; symbolication will be compromised.", header);
     }
     
     info->header = header;
     info->imageSize = imageSize;
     info->imageVmAddr = imageVmAddr;
     info->uuid = uuid;
-    info->name = imageName;
     info->slide = slide;
+    info->crashInfo = crashInfoAddr ? (uintptr_t)crashInfoAddr + (uintptr_t)slide : 0;
     info->unloaded = FALSE;
     atomic_store(&info->next, NULL);
     
     return true;
 }
 
+// MARK: - Registration
+
+enum {
+    IMAGE_PENDING,
+    IMAGE_POPULATING,
+    IMAGE_POPULATED,
+};
+
+/// The number of images registered lazily that have not been populated yet.
+static _Atomic(uint32_t) g_pending_image_count;
+
+/// The time spent in add_image, in mach_absolute_time() units, and the number of calls.
+static _Atomic(uint64_t) g_add_image_time;
+static _Atomic(uint32_t) g_add_image_count;
+
+void bsg_mach_headers_set_lazy_population(bool lazy) {
+    atomic_store(&g_lazy_population, lazy);
+}
+
+/**
+ * Fills in the parts of an image that are not needed to find it by address: its name (which requires dladdr), its
+ * name index entries and its pre-rendered JSON.
+ */
+static void populate_image(BSG_Mach_Header_Info *image) {
+    const char *name = atomic_load(&image->name);
+    if (!name) {
+        name = get_path(image->header);
+        // bsg_mach_headers_populate_for_crash() may have named the image in the meantime.
+        const char *expected = NULL;
+        if (!atomic_compare_exchange_strong(&image->name, &expected, name)) {
+            name = expected;
+        }
+    }
+    if (name) {
+        render_json(image);
+        image_names_add(image);
+    } else {
+        // Registering eagerly drops images without a name, so images registered lazily must be dropped too.
+        BSG_KSLOG_ERROR("Could not find name for mach header @ %p", image->header);
+        image->unloaded = true;
+        image_table_rebuild();
+    }
+}
+
+static void populate_image_async(void *image) {
+    bsg_mach_headers_ensure_populated(image);
+}
+
+static dispatch_queue_t population_queue(void) {
+    static dispatch_once_t once;
+    static dispatch_queue_t queue;
+    dispatch_once(&once, ^{
+        queue = dispatch_queue_create("com.bugsnag.mach-headers", DISPATCH_QUEUE_SERIAL);
+    });
+    return queue;
+}
+
+void bsg_mach_headers_ensure_populated(BSG_Mach_Header_Info *image) {
+    int expected = IMAGE_PENDING;
+    if (atomic_compare_exchange_strong(&image->state, &expected, IMAGE_POPULATING)) {
+        populate_image(image);
+        atomic_store(&image->state, IMAGE_POPULATED);
+        atomic_fetch_sub(&g_pending_image_count, 1);
+        return;
+    }
+    while (atomic_load(&image->state) != IMAGE_POPULATED) {
+        // Another thread is populating the image, which does not take long.
+        sched_yield();
+    }
+}
+
+void bsg_mach_headers_populate_for_crash(void) {
+    for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img; img = atomic_load(&img->next)) {
+        if (atomic_load(&img->state) != IMAGE_POPULATED && !atomic_load(&img->name)) {
+            // dladdr() is not async-signal safe, but dyld's own image list can be read at any time.
+            // The image may be being populated in the background, so only name it if that has not done so yet.
+            const char *expected = NULL;
+            atomic_compare_exchange_strong(&img->name, &expected, get_dyld_image_path(img->header));
+        }
+    }
+}
+
+double bsg_mach_headers_registration_duration(void) {
+    return bsg_ksmachtimeDifferenceInSeconds(atomic_load(&g_add_image_time), 0);
+}
+
+uint32_t bsg_mach_headers_registration_count(void) {
+    return atomic_load(&g_add_image_count);
+}
+
 static void add_image(const struct mach_header *header, intptr_t slide) {
+    const uint64_t startTime = mach_absolute_time();
+    const bool lazy = atomic_load(&g_lazy_population);
+    
     BSG_Mach_Header_Info *newImage = calloc(1, sizeof(BSG_Mach_Header_Info));
     if (newImage == NULL) {
         return;
     }
 
-    if (!bsg_mach_headers_populate_info(header, slide, newImage)) {
+    // In lazy mode, only the load commands are read now; they are all that is needed to find the image by address.
+    if (!(lazy ? read_load_commands(header, slide, newImage) :
+          bsg_mach_headers_populate_info(header, slide, newImage))) {
         free(newImage);
         return;
     }
 
+    if (lazy) {
+        atomic_fetch_add(&g_pending_image_count, 1);
+    } else {
+        populate_image(newImage);
+        atomic_store(&newImage->state, IMAGE_POPULATED);
+    }
+
     BSG_Mach_Header_Info *oldTail = atomic_exchange(&g_images_tail, newImage);
     atomic_store(&oldTail->next, newImage);
 
     if (header == &__dso_handle) {
         g_self_image = newImage;
     }
+
+    image_table_add(newImage);
+
+    if (lazy) {
+        dispatch_async_f(population_queue(), newImage, populate_image_async);
+    }
+    
+    atomic_fetch_add(&g_add_image_time, mach_absolute_time() - startTime);
+    atomic_fetch_add(&g_add_image_count, 1);
 }
 
 static void remove_image(const struct mach_header *header, intptr_t slide) {
     BSG_Mach_Header_Info existingImage = { 0 };
-    if (!bsg_mach_headers_populate_info(header, slide, &existingImage)) {
+    if (!read_load_commands(header, slide, &existingImage)) {
         return;
     }
 
@@ -226,33 +382,250 @@ static void remove_image(const struct mach_header *header, intptr_t slide) {
             img->unloaded = true;
         }
     }
+    
+    image_table_rebuild();
+    
+    // Cached symbolication results may point into the unloaded image's string table
+    bsg_symbolicate_cache_invalidate();
 }
 
-BSG_Mach_Header_Info *bsg_mach_headers_image_named(const char *const imageName, bool exactMatch) {
-        
-    if (imageName != NULL) {
-        
-        for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img != NULL; img = atomic_load(&img->next)) {
-            if (img->name == NULL) {
-                continue; // name is null if the index is out of range per dyld(3)
-            } else if (img->unloaded == true) {
-                continue; // ignore unloaded libraries
-            } else if (exactMatch) {
-                if (strcmp(img->name, imageName) == 0) {
-                    return img;
-                }
-            } else {
-                if (strstr(img->name, imageName) != NULL) {
-                    return img;
-                }
-            }
+// MARK: - Image Name Index
+
+#define IMAGE_NAMES_BUCKET_COUNT 1024
+
+/// An entry keyed by an image's path or basename. Entries are only ever appended to a bucket's chain, so they can be
+/// read without locks.
+struct image_name_entry {
+    uint32_t hash;
+    const char *key;
+    BSG_Mach_Header_Info *image;
+    _Atomic(struct image_name_entry *) next;
+};
+
+static _Atomic(struct image_name_entry *) g_image_names[IMAGE_NAMES_BUCKET_COUNT];
+
+static uint32_t image_name_hash(const char *name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static void image_names_insert(const char *key, BSG_Mach_Header_Info *image) {
+    struct image_name_entry *entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        return;
+    }
+    entry->hash = image_name_hash(key);
+    entry->key = key;
+    entry->image = image;
+    // Append so that the earliest loaded image with a given name is found first.
+    _Atomic(struct image_name_entry *) *link = &g_image_names[entry->hash % IMAGE_NAMES_BUCKET_COUNT];
+    for (;;) {
+        struct image_name_entry *expected = NULL;
+        if (atomic_compare_exchange_strong(link, &expected, entry)) {
+            return;
+        }
+        link = &expected->next;
+    }
+}
+
+static void image_names_add(BSG_Mach_Header_Info *image) {
+    image_names_insert(image->name, image);
+    const char *basename = strrchr(image->name, '/');
+    if (basename && basename[1]) {
+        image_names_insert(basename + 1, image);
+    }
+}
+
+// Returns the first loaded image whose path or basename is name.
+static BSG_Mach_Header_Info *image_names_find(const char *name) {
+    const uint32_t hash = image_name_hash(name);
+    for (struct image_name_entry *entry = atomic_load(&g_image_names[hash % IMAGE_NAMES_BUCKET_COUNT]);
+         entry; entry = atomic_load(&entry->next)) {
+        if (entry->hash == hash && !entry->image->unloaded && strcmp(entry->key, name) == 0) {
+            return entry->image;
+        }
+    }
+    return NULL;
+}
+
+static void image_names_reset(void) {
+    for (int i = 0; i < IMAGE_NAMES_BUCKET_COUNT; i++) {
+        struct image_name_entry *entry = atomic_exchange(&g_image_names[i], NULL);
+        while (entry) {
+            struct image_name_entry *next = atomic_load(&entry->next);
+            free(entry);
+            entry = next;
         }
     }
+}
+
+static BSG_Mach_Header_Info *find_image_named(const char *const imageName, bool exactMatch) {
+    if (exactMatch) {
+        return image_names_find(imageName);
+    }
     
+    for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img != NULL; img = atomic_load(&img->next)) {
+        const char *name = atomic_load(&img->name);
+        if (name == NULL) {
+            continue; // name is null if the index is out of range per dyld(3)
+        } else if (img->unloaded == true) {
+            continue; // ignore unloaded libraries
+        } else if (strstr(name, imageName) != NULL) {
+            return img;
+        }
+    }
     return NULL;
 }
 
+// Populates any images that were registered lazily and have not been populated yet. Returns false if there were none.
+static bool populate_pending_images(void) {
+    if (atomic_load(&g_pending_image_count) == 0) {
+        return false;
+    }
+    for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img != NULL; img = atomic_load(&img->next)) {
+        bsg_mach_headers_ensure_populated(img);
+    }
+    return true;
+}
+
+BSG_Mach_Header_Info *bsg_mach_headers_image_named(const char *const imageName, bool exactMatch) {
+    if (imageName == NULL) {
+        return NULL;
+    }
+    
+    BSG_Mach_Header_Info *image = find_image_named(imageName, exactMatch);
+    
+    // Images registered lazily are only named and indexed once populated, which is only worth forcing on a miss.
+    if (image == NULL && populate_pending_images()) {
+        image = find_image_named(imageName, exactMatch);
+    }
+    return image;
+}
+
+// MARK: - Image Address Table
+
+/// An immutable snapshot of the loaded images sorted by address, which is replaced whenever images are added or
+/// removed so that lookups can binary search without taking any locks.
+struct image_table {
+    uint32_t count;
+    /// The next table that has been replaced but may still be in use by a reader.
+    struct image_table *retired;
+    BSG_Mach_Header_Info *images[];
+};
+
+static _Atomic(struct image_table *) g_image_table;
+
+/// The number of threads currently reading g_image_table. Replaced tables are only freed when this is zero.
+static _Atomic(int) g_image_table_readers;
+
+/// Serialises updates of g_image_table; never taken by readers.
+static pthread_mutex_t g_image_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// Tables that have been replaced, but not yet freed.
+static struct image_table *g_retired_image_tables;
+
+// Returns the index of the first image in the table that starts after address.
+static uint32_t image_table_upper_bound(const struct image_table *table, uintptr_t address) {
+    uint32_t low = 0, high = table->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if ((uintptr_t)table->images[mid]->header <= address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static int image_compare(const void *a, const void *b) {
+    uintptr_t lhs = (uintptr_t)(*(BSG_Mach_Header_Info *const *)a)->header;
+    uintptr_t rhs = (uintptr_t)(*(BSG_Mach_Header_Info *const *)b)->header;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+// Must be called with g_image_table_mutex held. A NULL table makes lookups fall back to walking the list.
+static void image_table_publish(struct image_table *table) {
+    struct image_table *old = atomic_exchange(&g_image_table, table);
+    if (old) {
+        old->retired = g_retired_image_tables;
+        g_retired_image_tables = old;
+    }
+    // Readers that start after the exchange will see the new table, so if there are none now the old tables are free.
+    if (atomic_load(&g_image_table_readers) == 0) {
+        while (g_retired_image_tables) {
+            struct image_table *retired = g_retired_image_tables;
+            g_retired_image_tables = retired->retired;
+            free(retired);
+        }
+    }
+}
+
+// Must be called with g_image_table_mutex held.
+static void image_table_rebuild_locked(void) {
+    uint32_t count = 0;
+    for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img; img = atomic_load(&img->next)) {
+        count += !img->unloaded;
+    }
+    struct image_table *table = malloc(sizeof(*table) + count * sizeof(BSG_Mach_Header_Info *));
+    if (table) {
+        table->count = 0;
+        for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images();
+             img && table->count < count; img = atomic_load(&img->next)) {
+            if (!img->unloaded) {
+                table->images[table->count++] = img;
+            }
+        }
+        qsort(table->images, table->count, sizeof(BSG_Mach_Header_Info *), image_compare);
+    }
+    image_table_publish(table);
+}
+
+static void image_table_rebuild(void) {
+    pthread_mutex_lock(&g_image_table_mutex);
+    image_table_rebuild_locked();
+    pthread_mutex_unlock(&g_image_table_mutex);
+}
+
+static void image_table_add(BSG_Mach_Header_Info *image) {
+    pthread_mutex_lock(&g_image_table_mutex);
+    const struct image_table *old = atomic_load(&g_image_table);
+    if (!old) {
+        image_table_rebuild_locked();
+    } else {
+        struct image_table *table = malloc(sizeof(*table) + (old->count + 1) * sizeof(BSG_Mach_Header_Info *));
+        if (table) {
+            // Copy the old table, inserting the new image in order.
+            uint32_t index = image_table_upper_bound(old, (uintptr_t)image->header);
+            memcpy(table->images, old->images, index * sizeof(BSG_Mach_Header_Info *));
+            table->images[index] = image;
+            memcpy(table->images + index + 1, old->images + index,
+                   (old->count - index) * sizeof(BSG_Mach_Header_Info *));
+            table->count = old->count + 1;
+        }
+        image_table_publish(table);
+    }
+    pthread_mutex_unlock(&g_image_table_mutex);
+}
+
 BSG_Mach_Header_Info *bsg_mach_headers_image_at_address(const uintptr_t address) {
+    BSG_Mach_Header_Info *image = NULL;
+    atomic_fetch_add(&g_image_table_readers, 1);
+    const struct image_table *table = atomic_load(&g_image_table);
+    if (table) {
+        uint32_t index = image_table_upper_bound(table, address);
+        if (index > 0 && contains_address(table->images[index - 1], address)) {
+            image = table->images[index - 1];
+        }
+    }
+    atomic_fetch_sub(&g_image_table_readers, 1);
+    if (table) {
+        return image;
+    }
     for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img; img = atomic_load(&img->next)) {
         if (contains_address(img, address)) {
             return img;
@@ -278,46 +651,12 @@ uintptr_t bsg_mach_headers_first_cmd_after_header(const struct mach_header *cons
     }
 }
 
-static uintptr_t bsg_mach_header_info_get_section_addr_named(const BSG_Mach_Header_Info *header, const char *name) {
-    uintptr_t cmdPtr = bsg_mach_headers_first_cmd_after_header(header->header);
-    if (!cmdPtr) {
-        return 0;
-    }
-    for (uint32_t i = 0; i < header->header->ncmds; i++) {
-        const struct load_command *loadCmd = (struct load_command *)cmdPtr;
-        if (loadCmd->cmd == LC_SEGMENT) {
-            const struct segment_command *segment = (void *)cmdPtr;
-            char *sectionPtr = (void *)(cmdPtr + sizeof(*segment));
-            for (uint32_t j = 0; j < segment->nsects; j++) {
-                struct section *section = (void *)sectionPtr;
-                if (strcmp(name, section->sectname) == 0) {
-                    return section->addr + (uintptr_t)header->slide;
-                }
-                sectionPtr += sizeof(*section);
-            }
-        } else if (loadCmd->cmd == LC_SEGMENT_64) {
-            const struct segment_command_64 *segment = (void *)cmdPtr;
-            char *sectionPtr = (void *)(cmdPtr + sizeof(*segment));
-            for (uint32_t j = 0; j < segment->nsects; j++) {
-                struct section_64 *section = (void *)sectionPtr;
-                if (strcmp(name, section->sectname) == 0) {
-                    return (uintptr_t)section->addr + (uintptr_t)header->slide;
-                }
-                sectionPtr += sizeof(*section);
-            }
-        }
-        cmdPtr += loadCmd->cmdsize;
-    }
-    return 0;
-}
-
 const char *bsg_mach_headers_get_crash_info_message(const BSG_Mach_Header_Info *header) {
     struct crashreporter_annotations_t info;
-    uintptr_t sectionAddress = bsg_mach_header_info_get_section_addr_named(header, CRASHREPORTER_ANNOTATIONS_SECTION);
-    if (!sectionAddress) {
+    if (!header->crashInfo) {
         return NULL;
     }
-    if (bsg_ksmachcopyMem((void *)sectionAddress, &info, sizeof(info)) != KERN_SUCCESS) {
+    if (bsg_ksmachcopyMem((void *)header->crashInfo, &info, sizeof(info)) != KERN_SUCCESS) {
         return NULL;
     }
     // Version 4 was in use until iOS 9 / Swift 2.0 when the version was bumped to 5.
@@ -327,14 +666,18 @@ const char *bsg_mach_headers_get_crash_info_message(const BSG_Mach_Header_Info *
     if (!info.message) {
         return NULL;
     }
-    // Probe the string to ensure it's safe to read.
-    for (uintptr_t i = 0; i < 500; i++) {
-        char c;
-        if (bsg_ksmachcopyMem((void *)(info.message + i), &c, sizeof(c)) != KERN_SUCCESS) {
+    // Probe the string to ensure it's safe to read. Readability can only change at a page boundary, so copy up to
+    // the end of each page in one go rather than a byte at a time.
+    const uintptr_t pageSize = 4096;
+    char buffer[500];
+    for (size_t length = 0, chunk = 0; length < sizeof(buffer); length += chunk) {
+        const uintptr_t address = (uintptr_t)info.message + length;
+        chunk = MIN(sizeof(buffer) - length, pageSize - address % pageSize);
+        if (bsg_ksmachcopyMem((void *)address, buffer + length, chunk) != KERN_SUCCESS) {
             // String is not readable.
             return NULL;
         }
-        if (c == '\0') {
+        if (memchr(buffer + length, '\0', chunk)) {
             // Found end of string.
             return (const char *)info.message;
         }
@@ -376,7 +719,99 @@ static bool contains_address(BSG_Mach_Header_Info *img, vm_address_t address) {
     return address >= imageStart && address < (imageStart + img->imageSize);
 }
 
+// MARK: - Crash report JSON
+
+struct json_buffer {
+    char *data;
+    size_t length;
+};
+
+static int append_json(const char *data, size_t length, void *userData) {
+    struct json_buffer *buffer = userData;
+    if (buffer->data) {
+        memcpy(buffer->data + buffer->length, data, length);
+    }
+    buffer->length += length;
+    return BSG_KSJSON_OK;
+}
+
+static void encode_json(BSG_Mach_Header_Info *image, struct json_buffer *buffer) {
+    BSG_KSJSONEncodeContext context;
+    bsg_ksjsonbeginEncode(&context, false, append_json, buffer);
+    bsg_ksjsonbeginObject(&context, NULL);
+    bsg_ksjsonaddUIntegerElement(&context, BSG_KSCrashField_ImageAddress, (uintptr_t)image->header);
+    bsg_ksjsonaddUIntegerElement(&context, BSG_KSCrashField_ImageVmAddress, image->imageVmAddr);
+    bsg_ksjsonaddUIntegerElement(&context, BSG_KSCrashField_ImageSize, image->imageSize);
+    bsg_ksjsonaddStringElement(&context, BSG_KSCrashField_Name, image->name, BSG_KSJSON_SIZE_AUTOMATIC);
+    if (image->uuid) {
+        uuid_string_t uuid;
+        uuid_unparse_upper(image->uuid, uuid);
+        bsg_ksjsonaddStringElement(&context, BSG_KSCrashField_UUID, uuid, BSG_KSJSON_SIZE_AUTOMATIC);
+    } else {
+        bsg_ksjsonaddNullElement(&context, BSG_KSCrashField_UUID);
+    }
+    bsg_ksjsonaddIntegerElement(&context, BSG_KSCrashField_CPUType, image->header->cputype);
+    bsg_ksjsonaddIntegerElement(&context, BSG_KSCrashField_CPUSubType, image->header->cpusubtype);
+    bsg_ksjsonendEncode(&context);
+}
+
+/**
+ * Renders the image's binary_images entry ahead of time, so that crash reports can include it without any formatting.
+ */
+static void render_json(BSG_Mach_Header_Info *image) {
+    // The first pass measures, the second writes.
+    struct json_buffer buffer = {0};
+    encode_json(image, &buffer);
+    buffer.data = malloc(buffer.length + 1);
+    if (!buffer.data) {
+        return;
+    }
+    buffer.length = 0;
+    encode_json(image, &buffer);
+    buffer.data[buffer.length] = '\0';
+    // Images may be rendered in the background, so publish the length before the pointer that readers check.
+    image->jsonLength = buffer.length;
+    atomic_store_explicit(&image->json, buffer.data, memory_order_release);
+}
+
+const char *bsg_mach_headers_get_json(const BSG_Mach_Header_Info *image, size_t *length) {
+    if (atomic_load_explicit(&image->state, memory_order_acquire) != IMAGE_POPULATED) {
+        return NULL;
+    }
+    const char *json = atomic_load_explicit(&image->json, memory_order_acquire);
+    if (json) {
+        *length = image->jsonLength;
+    }
+    return json;
+}
+
+static const char * get_dyld_image_path(const struct mach_header *header) {
+    if (!g_all_image_infos) {
+        return NULL;
+    }
+    if (header == g_all_image_infos->dyldImageLoadAddress) {
+        return g_all_image_infos->dyldPath;
+    }
+    const struct dyld_image_info *infoArray = g_all_image_infos->infoArray;
+    if (!infoArray) {
+        // dyld is updating the array
+        return NULL;
+    }
+    for (uint32_t i = 0; i < g_all_image_infos->infoArrayCount; i++) {
+        if (infoArray[i].imageLoadAddress == header) {
+            return infoArray[i].imageFilePath;
+        }
+    }
+    return NULL;
+}
+
+/// Overrides get_path() (for unit tests).
+static const char * (*g_test_get_path)(const struct mach_header *header);
+
 static const char * get_path(const struct mach_header *header) {
+    if (g_test_get_path) {
+        return g_test_get_path(header);
+    }
     Dl_info DlInfo = {0};
     dladdr(header, &DlInfo);
     if (DlInfo.dli_fname) {
@@ -397,10 +832,15 @@ static const char * get_path(const struct mach_header *header) {
 }
 
 void bsg_test_support_mach_headers_reset(void) {
+    // Wait for lazy population to finish with the images
+    dispatch_sync(population_queue(), ^{});
+
     // Erase all current images
     BSG_Mach_Header_Info *next = NULL;
     for (BSG_Mach_Header_Info *img = bsg_mach_headers_get_images(); img != NULL; img = next) {
         next = atomic_load(&img->next);
+        free((void *)atomic_load(&img->json));
+        bsg_symbolicate_free_indexes(img);
         free(img);
     }
 
@@ -408,11 +848,22 @@ void bsg_test_support_mach_headers_reset(void) {
     atomic_store(&g_head_dummy.next, NULL);
     atomic_store(&g_images_tail, &g_head_dummy);
     g_self_image = NULL;
+    g_test_get_path = NULL;
+    atomic_store(&g_pending_image_count, 0);
+    bsg_symbolicate_cache_invalidate();
+    image_names_reset();
+    pthread_mutex_lock(&g_image_table_mutex);
+    image_table_publish(NULL);
+    pthread_mutex_unlock(&g_image_table_mutex);
 
     // Force bsg_mach_headers_initialize to run again when requested.
     atomic_store(&is_mach_headers_initialized, false);
 }
 
+void bsg_test_support_mach_headers_set_path_function(const char * (*function)(const struct mach_header *header)) {
+    g_test_get_path = function;
+}
+
 void bsg_test_support_mach_headers_add_image(const struct mach_header *header, intptr_t slide) {
     add_image(header, slide);
 }
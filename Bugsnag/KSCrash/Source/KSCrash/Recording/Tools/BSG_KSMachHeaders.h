@@ -10,9 +10,13 @@
 #define BSG_KSMachHeaders_h
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdatomic.h>
 
+struct bsg_function_starts;
+struct bsg_symbol_index;
+
 /* Maintaining our own list of framework Mach headers means that we avoid potential
  * deadlock situations where we try and suspend lock-holding threads prior to
  * loading mach headers as part of our normal event handling behaviour.
@@ -41,17 +45,40 @@ typedef struct bsg_mach_image {
     const uint8_t *uuid;
 
     /// The pathname of the shared object (Dl_info.dli_fname)
-    const char* name;
+    ///
+    /// NULL until the image has been populated if it was registered lazily. Atomic because crash handling may fill it
+    /// in while the image is being populated in the background.
+    _Atomic(const char *) name;
 
     /// The virtual memory address slide of the image
     intptr_t slide;
 
+    /// The address of the image's __crash_info section, including slide, or 0 if it has none
+    uintptr_t crashInfo;
+
     /// True if the image has been unloaded and should be ignored
     bool unloaded;
     
     /// True if the image is referenced by the current crash report.
     bool inCrashReport;
 
+    /// Whether name, json and the name index have been filled in; see bsg_mach_headers_ensure_populated().
+    _Atomic(int) state;
+
+    /// The image's entry in a crash report's binary_images, rendered as JSON when the image was added.
+    /// NULL if it could not be rendered. Read it with bsg_mach_headers_get_json().
+    _Atomic(const char *) json;
+
+    /// The length of json, excluding the terminating NUL. Published before json.
+    size_t jsonLength;
+
+    /// The image's function start offsets, decoded from LC_FUNCTION_STARTS the first time an address in
+    /// the image is symbolicated outside of crash handling. NULL until then.
+    _Atomic(const struct bsg_function_starts *) functionStarts;
+
+    /// The image's named symbols sorted by address, built alongside functionStarts. NULL until then.
+    _Atomic(const struct bsg_symbol_index *) symbolIndex;
+
     /// The next image in the linked list
     _Atomic(struct bsg_mach_image *) next;
 } BSG_Mach_Header_Info;
@@ -64,6 +91,42 @@ typedef struct bsg_mach_image {
  */
 void bsg_mach_headers_initialize(void);
 
+/**
+ * Defers reading images' names and rendering their JSON to a background queue, so that dyld's image registration
+ * callbacks only read load commands. Must be called before bsg_mach_headers_initialize().
+ */
+void bsg_mach_headers_set_lazy_population(bool lazy);
+
+/**
+ * Fills in the image's name, JSON and name index entries if it was registered lazily and has not yet been populated.
+ * Not async-signal safe.
+ */
+void bsg_mach_headers_ensure_populated(BSG_Mach_Header_Info *image);
+
+/**
+ * Fills in the names of any images that have not yet been populated using dyld's image list, which is async-signal
+ * safe. Must be called before a crash report reads image names.
+ */
+void bsg_mach_headers_populate_for_crash(void);
+
+/**
+ * Returns the image's pre-rendered binary_images entry, or NULL if it has not been fully populated yet.
+ * Async-signal safe.
+ *
+ * @param length Out: The length of the JSON, excluding the terminating NUL.
+ */
+const char *bsg_mach_headers_get_json(const BSG_Mach_Header_Info *image, size_t *length);
+
+/**
+ * The total time, in seconds, spent in dyld's image registration callbacks.
+ */
+double bsg_mach_headers_registration_duration(void);
+
+/**
+ * The number of images dyld's registration callbacks have been called for.
+ */
+uint32_t bsg_mach_headers_registration_count(void);
+
 /**
  * Returns the head of the link list of headers
  */
@@ -89,7 +152,8 @@ BSG_Mach_Header_Info *bsg_mach_headers_image_at_address(const uintptr_t address)
  *
  * @param imageName The image name to look for.
  *
- * @param exactMatch If true, look for an exact match instead of a partial one.
+ * @param exactMatch If true, look for an image whose path or basename is imageName using a hash index,
+ *                   instead of searching every image's path for imageName.
  *
  * @return the matched image, or NULL if not found.
  */
@@ -117,6 +181,11 @@ const char *bsg_mach_headers_get_crash_info_message(const BSG_Mach_Header_Info *
  */
 void bsg_test_support_mach_headers_reset(void);
 
+/**
+ * Replace the function used to find an image's path, or restore the default by passing NULL (for unit tests).
+ */
+void bsg_test_support_mach_headers_set_path_function(const char * (*function)(const struct mach_header *header));
+
 /**
  * Add a binary image (for unit tests).
  */
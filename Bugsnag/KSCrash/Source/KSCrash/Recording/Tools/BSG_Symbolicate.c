@@ -12,6 +12,7 @@
 
 #include <mach-o/loader.h>
 #include <mach-o/nlist.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef __LP64__
@@ -26,6 +27,59 @@ typedef struct segment_command segment_command_t;
 typedef struct section section_t;
 #endif
 
+#if defined(__arm__)
+#define THUMB_INSTRUCTION_TAG 1ul
+#endif
+
+struct bsg_function_starts {
+    uint32_t count;
+    /// The number of offsets allocated, which can exceed count.
+    uint32_t capacity;
+    /// Ascending offsets of function starts from the start of __TEXT.
+    uint32_t offsets[];
+};
+
+struct bsg_symbol_index {
+    uint32_t count;
+    /// Ascending offsets from the image's vmaddr, and the string table index of the preferred symbol at each.
+    struct bsg_symbol_index_entry {
+        uint32_t offset;
+        uint32_t strx;
+    } entries[];
+};
+
+/// The number of bytes allocated for function starts and symbol indexes.
+static _Atomic(size_t) bsg_g_index_bytes;
+
+static size_t function_starts_size(const struct bsg_function_starts *starts) {
+    return sizeof(*starts) + starts->capacity * sizeof(uint32_t);
+}
+
+static size_t symbol_index_size(const struct bsg_symbol_index *index) {
+    return sizeof(*index) + index->count * sizeof(struct bsg_symbol_index_entry);
+}
+
+#define BSG_SYMBOLICATE_CACHE_BITS 11
+#define BSG_SYMBOLICATE_CACHE_SIZE (1 << BSG_SYMBOLICATE_CACHE_BITS)
+
+/// A slot in the results cache, guarded by a sequence number that is odd while the slot is being written.
+struct cache_entry {
+    _Atomic(uint32_t) sequence;
+    _Atomic(uint32_t) generation;
+    _Atomic(uintptr_t) address;
+    _Atomic(uintptr_t) function_address;
+    _Atomic(const char *) function_name;
+    _Atomic(struct bsg_mach_image *) image;
+};
+
+static struct cache_entry bsg_g_cache[BSG_SYMBOLICATE_CACHE_SIZE];
+
+/// Incremented to invalidate every entry in the cache; entries only match if written in the current generation.
+static _Atomic(uint32_t) bsg_g_cache_generation = 1;
+
+static _Atomic(uint64_t) bsg_g_cache_hits;
+static _Atomic(uint64_t) bsg_g_cache_misses;
+
 struct leb128_uintptr_context {
     uintptr_t value;
     uint32_t shift;
@@ -44,23 +98,207 @@ static int leb128_uintptr_decode(struct leb128_uintptr_context *context, uint8_t
     return 0;
 }
 
+// Decode function starts data into a sorted array of offsets and publish it on the image.
+// Returns the image's existing index if another thread published one first, or NULL on failure.
+static const struct bsg_function_starts *
+function_starts_build(struct bsg_mach_image *image, const uint8_t *data, uint32_t size) {
+    // Every value is terminated by a byte without the continuation bit set, which bounds the count.
+    uint32_t capacity = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        capacity += data[i] < 0x80;
+    }
+    struct bsg_function_starts *starts = malloc(sizeof(*starts) + capacity * sizeof(uint32_t));
+    if (!starts) {
+        return NULL;
+    }
+    starts->count = 0;
+    starts->capacity = capacity;
+    uintptr_t offset = 0;
+    struct leb128_uintptr_context context = {0};
+    for (uint32_t i = 0; i < size; i++) {
+        uintptr_t delta = 0;
+        if (leb128_uintptr_decode(&context, data[i], &delta) && delta) {
+            offset += delta;
+            uintptr_t func_offset = offset;
+#if defined(__arm__)
+            func_offset &= ~THUMB_INSTRUCTION_TAG;
+#endif
+            if (func_offset > UINT32_MAX) {
+                BSG_KSLOG_INFO("Function starts of %s do not fit in 32 bits", image->name);
+                free(starts);
+                return NULL;
+            }
+            starts->offsets[starts->count++] = (uint32_t)func_offset;
+        }
+    }
+    const struct bsg_function_starts *existing = NULL;
+    if (!atomic_compare_exchange_strong(&image->functionStarts, &existing, starts)) {
+        free(starts);
+        return existing;
+    }
+    atomic_fetch_add(&bsg_g_index_bytes, function_starts_size(starts));
+    return starts;
+}
+
+// Returns the offset of the last function start at or before offset, or 0 (the start of __TEXT) if there is none.
+static uintptr_t function_starts_lookup(const struct bsg_function_starts *starts, uintptr_t offset) {
+    uint32_t low = 0, high = starts->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (starts->offsets[mid] <= offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low ? starts->offsets[low - 1] : 0;
+}
+
+// Returns whether a symbol table entry is a candidate for naming a function.
+static bool symbol_is_named(const nlist_t *sym, const char *strings, uint32_t strsize) {
+    return
+    // Ignore symbolic debugging entries
+    //  "Only symbolic debugging entries have some of the N_STAB bits set and if any
+    //   of these bits are set then it is a symbolic debugging entry (a stab).  In
+    //   which case then the values of the n_type field (the entire field) are given
+    //   in <mach-o/stab.h>"
+    (sym->n_type & N_STAB) == 0 &&
+    // Sanity check string table index
+    sym->n_un.n_strx < strsize &&
+    // Ignore empty symbol names
+    strings[sym->n_un.n_strx];
+}
+
+struct symbol_candidate {
+    uint32_t offset;
+    uint32_t strx;
+    /// Orders candidates at the same offset so that the preferred one sorts last.
+    uint32_t rank;
+};
+
+static int symbol_candidate_compare(const void *a, const void *b) {
+    const struct symbol_candidate *lhs = a, *rhs = b;
+    if (lhs->offset != rhs->offset) {
+        return lhs->offset < rhs->offset ? -1 : 1;
+    }
+    return lhs->rank < rhs->rank ? -1 : lhs->rank > rhs->rank;
+}
+
+// Sort the named symbols by address, keeping only the preferred symbol at each, and publish them on the image.
+// Returns the image's existing index if another thread published one first, or NULL on failure.
+static const struct bsg_symbol_index *
+symbol_index_build(struct bsg_mach_image *image, const nlist_t *syms, uint32_t nsyms,
+                   const char *strings, uint32_t strsize) {
+    struct symbol_candidate *candidates = malloc(nsyms * sizeof(*candidates));
+    if (!candidates) {
+        return NULL;
+    }
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < nsyms && i < 0x80000000; i++) {
+        if (!symbol_is_named(&syms[i], strings, strsize) ||
+            syms[i].n_value < image->imageVmAddr ||
+            syms[i].n_value - image->imageVmAddr > UINT32_MAX) {
+            continue;
+        }
+        candidates[count++] = (struct symbol_candidate){
+            .offset = (uint32_t)(syms[i].n_value - image->imageVmAddr),
+            .strx = syms[i].n_un.n_strx,
+            // Prefer external symbols, then later ones, matching the linear scan.
+            .rank = (syms[i].n_type & N_EXT ? 0x80000000 : 0) | i};
+    }
+    qsort(candidates, count, sizeof(*candidates), symbol_candidate_compare);
+    
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        unique += i + 1 == count || candidates[i].offset != candidates[i + 1].offset;
+    }
+    struct bsg_symbol_index *index = malloc(sizeof(*index) + unique * sizeof(struct bsg_symbol_index_entry));
+    if (!index) {
+        free(candidates);
+        return NULL;
+    }
+    index->count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i + 1 == count || candidates[i].offset != candidates[i + 1].offset) {
+            index->entries[index->count++] = (struct bsg_symbol_index_entry){
+                candidates[i].offset, candidates[i].strx};
+        }
+    }
+    free(candidates);
+    
+    const struct bsg_symbol_index *existing = NULL;
+    if (!atomic_compare_exchange_strong(&image->symbolIndex, &existing, index)) {
+        free(index);
+        return existing;
+    }
+    atomic_fetch_add(&bsg_g_index_bytes, symbol_index_size(index));
+    return index;
+}
+
+// Returns the entry for the symbol at offset, or NULL if there is none.
+static const struct bsg_symbol_index_entry *
+symbol_index_lookup(const struct bsg_symbol_index *index, uint64_t offset) {
+    uint32_t low = 0, high = index->count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (index->entries[mid].offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < index->count && index->entries[low].offset == offset ? &index->entries[low] : NULL;
+}
+
+// The parts of an image's load commands needed to symbolicate addresses within it.
+struct image_symbols {
+    struct bsg_mach_image *image;
+    /// The bounds of the __text section, which function starts data describes.
+    uintptr_t text_start;
+    uintptr_t text_end;
+    const uint8_t *function_starts;
+    uint32_t function_starts_size;
+    const nlist_t *syms;
+    uint32_t nsyms;
+    const char *strings;
+    uint32_t strsize;
+};
+
+// The layout of segments in memory differs depending on whether the image is in the dyld cache.
+// Subtracting __LINKEDIT's fileoff converts a *file* offset into an offset relative to __LINKEDIT
+// that lets us compute the data's address in memory regardless of layout.
+static const void * get_linkedit_data(const segment_command_t *linkedit, uintptr_t slide,
+                                      uint64_t dataoff, uint64_t size) {
+    if (dataoff < linkedit->fileoff) {
+        BSG_KSLOG_DEBUG("dataoff < linkedit->fileoff");
+        return NULL;
+    }
+    if (dataoff + size > linkedit->fileoff + linkedit->filesize) {
+        BSG_KSLOG_DEBUG("dataoff + size > linkedit->fileoff + linkedit->filesize");
+        return NULL;
+    }
+    return (const void *)(uintptr_t)(dataoff - linkedit->fileoff + linkedit->vmaddr + slide);
+}
+
+// Walk an image's load commands to locate its __text section, function starts and symbol table.
+// Returns false if the image's load commands could not be read.
 #if __clang_major__ >= 11 // Xcode 10 does not like the following attribute
 __attribute__((annotate("oclint:suppress[deep nested block]")))
 #endif
-void bsg_symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_result *result) {
-    bzero(result, sizeof(*result));
+static bool image_symbols_init(struct image_symbols *symbols, struct bsg_mach_image *image) {
+    bzero(symbols, sizeof(*symbols));
+    symbols->text_end = UINTPTR_MAX;
     
-    struct bsg_mach_image *image = bsg_mach_headers_image_at_address(instruction_addr);
     if (!image || !image->header) {
-        return;
+        return false;
     }
     
     const struct load_command *load_cmd = (const void *)bsg_mach_headers_first_cmd_after_header(image->header);
     if (!load_cmd) {
-        return;
+        return false;
     }
     
-    result->image = image;
+    symbols->image = image;
     
     const uintptr_t slide = (uintptr_t)image->slide;
     
@@ -78,7 +316,6 @@ void bsg_symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_re
                     linkedit = seg_cmd;
                 }
                 
-                // Sanity check: the instruction address is in the __text section.
                 // Function Starts data only describes things within the __text section.
                 // We may sometimes be asked to symbolicate addresses in the __stubs section,
                 // which would be nice support in addition.
@@ -87,13 +324,8 @@ void bsg_symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_re
                     for (uint32_t sect_idx = 0; sect_idx < seg_cmd->nsects; sect_idx++) {
                         const section_t *section = sections + sect_idx;
                         if (strncmp(section->sectname, SECT_TEXT, sizeof(section->sectname)) == 0) {
-                            uintptr_t start = section->addr + slide;
-                            uintptr_t end = start + section->size;
-                            if (instruction_addr < start || instruction_addr >= end) {
-                                BSG_KSLOG_ERROR("Address %p is outside the " SECT_TEXT " section of image %s",
-                                                (void *)instruction_addr, image->name);
-                                return;
-                            }
+                            symbols->text_start = section->addr + slide;
+                            symbols->text_end = symbols->text_start + section->size;
                             break;
                         }
                     }
@@ -120,53 +352,13 @@ void bsg_symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_re
     
     if (!linkedit) {
         BSG_KSLOG_INFO(SEG_LINKEDIT " not found for %s", image->name);
-        return;
+        return true;
     }
     
-    const uintptr_t linkedit_addr = linkedit->vmaddr + slide;
-    
-    // The layout of segments in memory differs depending on whether the image is in the dyld cache.
-    // Subtracting __LINKEDIT's fileoff converts a *file* offset into an offset relative to __LINKEDIT
-    // that lets us compute the data's address in memory regardless of layout.
-#define get_linkedit_data(__dataoff__, __size__) ({ \
-    if (__dataoff__ < linkedit->fileoff) { \
-        BSG_KSLOG_DEBUG(#__dataoff__ " < linkedit->fileoff"); \
-        return; } \
-    if (__dataoff__ + __size__ > linkedit->fileoff + linkedit->filesize) { \
-        BSG_KSLOG_DEBUG(#__dataoff__ " + " #__size__ " > linkedit->fileoff + linkedit->filesize"); \
-        return; } \
-    (const void *)(__dataoff__ - linkedit->fileoff + linkedit_addr); })
-    
-    // Search functions starts data for a function that contains the address
     if (function_starts) {
-        // Function starts are stored as a series of LEB128 encoded deltas
-        // Starting with delta from start of __TEXT
-        uintptr_t addr = (uintptr_t)image->imageVmAddr + slide;
-        uintptr_t func_start = addr;
-        struct leb128_uintptr_context context = {0};
-        const uint8_t *data = get_linkedit_data(function_starts->dataoff, function_starts->datasize);
-        for (uint32_t i = 0; i < function_starts->datasize; i++) {
-            uintptr_t delta = 0;
-            if (leb128_uintptr_decode(&context, data[i], &delta) && delta) {
-                addr += delta;
-                uintptr_t next_func_start = addr;
-#if defined(__arm__)
-#define THUMB_INSTRUCTION_TAG 1ul
-                // ld64 sets the least significant bit for thumb instructions, which needs to be
-                // zeroed to recover the original address - see FunctionStartsAtom<A>::encode()
-                // https://opensource.apple.com/source/ld64/ld64-123.2/src/ld/LinkEdit.hpp.auto.html
-                if (next_func_start & THUMB_INSTRUCTION_TAG) {
-                    next_func_start &= ~THUMB_INSTRUCTION_TAG;
-                }
-#endif
-                if (instruction_addr < next_func_start) {
-                    // address was in the previous function
-                    break;
-                }
-                func_start = next_func_start;
-            }
-        }
-        result->function_address = func_start;
+        symbols->function_starts = get_linkedit_data(linkedit, slide, function_starts->dataoff,
+                                                     function_starts->datasize);
+        symbols->function_starts_size = function_starts->datasize;
     } else {
         // If LC_FUNCTION_STARTS has been omitted via ld's `-no_function_starts` option, accurate in-process
         // symbolication cannot be performed.
@@ -176,31 +368,102 @@ void bsg_symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_re
         //
         // The back-end will still be able to symbolicate if the dSYM was uploaded.
         BSG_KSLOG_INFO("No LC_FUNCTION_STARTS, skipping in-process symbolication for %s", image->name);
+    }
+    
+    if (symtab) {
+        symbols->syms = get_linkedit_data(linkedit, slide, symtab->symoff, symtab->nsyms * sizeof(nlist_t));
+        symbols->strings = get_linkedit_data(linkedit, slide, symtab->stroff, symtab->strsize);
+        if (symbols->syms && symbols->strings) {
+            symbols->nsyms = symtab->nsyms;
+            symbols->strsize = symtab->strsize;
+        } else {
+            symbols->syms = NULL;
+        }
+    }
+    
+    return true;
+}
+
+// Find the function containing an address that lies within symbols->image.
+static void symbolicate_in_image(const struct image_symbols *symbols, const uintptr_t instruction_addr,
+                                 struct bsg_symbolicate_result *result, bool build_index) {
+    struct bsg_mach_image *image = symbols->image;
+    result->image = image;
+    
+    // Sanity check: the instruction address is in the __text section.
+    if (instruction_addr < symbols->text_start || instruction_addr >= symbols->text_end) {
+        BSG_KSLOG_ERROR("Address %p is outside the " SECT_TEXT " section of image %s",
+                        (void *)instruction_addr, image->name);
         return;
     }
     
+    if (!symbols->function_starts) {
+        return;
+    }
+    
+    // Search functions starts data for a function that contains the address
+    // Function starts are stored as a series of LEB128 encoded deltas
+    // Starting with delta from start of __TEXT
+    uintptr_t addr = (uintptr_t)image->imageVmAddr + (uintptr_t)image->slide;
+    uintptr_t func_start = addr;
+    struct leb128_uintptr_context context = {0};
+    const uint8_t *data = symbols->function_starts;
+    const struct bsg_function_starts *starts = atomic_load(&image->functionStarts);
+    if (!starts && build_index) {
+        starts = function_starts_build(image, data, symbols->function_starts_size);
+    }
+    if (starts) {
+        func_start += function_starts_lookup(starts, instruction_addr - addr);
+    }
+    for (uint32_t i = 0; !starts && i < symbols->function_starts_size; i++) {
+        uintptr_t delta = 0;
+        if (leb128_uintptr_decode(&context, data[i], &delta) && delta) {
+            addr += delta;
+            uintptr_t next_func_start = addr;
+#if defined(__arm__)
+            // ld64 sets the least significant bit for thumb instructions, which needs to be
+            // zeroed to recover the original address - see FunctionStartsAtom<A>::encode()
+            // https://opensource.apple.com/source/ld64/ld64-123.2/src/ld/LinkEdit.hpp.auto.html
+            if (next_func_start & THUMB_INSTRUCTION_TAG) {
+                next_func_start &= ~THUMB_INSTRUCTION_TAG;
+            }
+#endif
+            if (instruction_addr < next_func_start) {
+                // address was in the previous function
+                break;
+            }
+            func_start = next_func_start;
+        }
+    }
+    result->function_address = func_start;
+    
     // Find the best symbol that matches function_address.
-    if (result->function_address && symtab) {
-        const nlist_t *syms = get_linkedit_data(symtab->symoff, symtab->nsyms * sizeof(nlist_t));
-        const char *strings = get_linkedit_data(symtab->stroff, symtab->strsize);
-        const uintptr_t symbol_address = (uintptr_t)result->function_address - slide;
+    if (result->function_address && symbols->syms) {
+        const nlist_t *syms = symbols->syms;
+        const char *strings = symbols->strings;
+        const uintptr_t symbol_address = (uintptr_t)result->function_address - (uintptr_t)image->slide;
+        const struct bsg_symbol_index *index = atomic_load(&image->symbolIndex);
+        if (!index && build_index) {
+            index = symbol_index_build(image, syms, symbols->nsyms, strings, symbols->strsize);
+        }
+        if (index) {
+            const struct bsg_symbol_index_entry *entry =
+            symbol_address >= image->imageVmAddr ?
+            symbol_index_lookup(index, symbol_address - image->imageVmAddr) : NULL;
+            if (entry) {
+                const char *name = strings + entry->strx;
+                result->function_name = name[0] == '_' ? name + 1 : name;
+            }
+            return;
+        }
         nlist_t best = {{0}};
         // Scan the whole symtab because there can be > 1 symbol with the same n_value.
         // For example CoreFoundation has matching local `__forwarding_prep_0___` and
         // external `_CF_forwarding_prep_0` symbols.
         // Report the external symbol like dladdr, atos, lldb, et al.
-        for (uint32_t i = 0; i < symtab->nsyms; i++) {
+        for (uint32_t i = 0; i < symbols->nsyms; i++) {
             if (syms[i].n_value == symbol_address &&
-                // Ignore symbolic debugging entries
-                //  "Only symbolic debugging entries have some of the N_STAB bits set and if any
-                //   of these bits are set then it is a symbolic debugging entry (a stab).  In
-                //   which case then the values of the n_type field (the entire field) are given
-                //   in <mach-o/stab.h>"
-                (syms[i].n_type & N_STAB) == 0 &&
-                // Sanity check string table index
-                syms[i].n_un.n_strx < symtab->strsize &&
-                // Ignore empty symbol names
-                strings[syms[i].n_un.n_strx] &&
+                symbol_is_named(&syms[i], strings, symbols->strsize) &&
                 // Prefer external symbols
                 ((best.n_type & N_EXT) == 0 || (syms[i].n_type & N_EXT) != 0)) {
                 best = syms[i];
@@ -212,3 +475,147 @@ void bsg_symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_re
         }
     }
 }
+
+static void symbolicate(const uintptr_t instruction_addr, struct bsg_symbolicate_result *result,
+                        bool build_index) {
+    bzero(result, sizeof(*result));
+    
+    struct image_symbols symbols;
+    if (image_symbols_init(&symbols, bsg_mach_headers_image_at_address(instruction_addr))) {
+        symbolicate_in_image(&symbols, instruction_addr, result, build_index);
+    }
+}
+
+void bsg_symbolicate(const uintptr_t address, struct bsg_symbolicate_result *result) {
+    symbolicate(address, result, false);
+}
+
+static struct cache_entry * cache_entry_for_address(uintptr_t address) {
+    // Fibonacci hashing spreads nearby instruction addresses across the table.
+    const uint64_t hash = (uint64_t)address * 0x9E3779B97F4A7C15ull;
+    return &bsg_g_cache[hash >> (64 - BSG_SYMBOLICATE_CACHE_BITS)];
+}
+
+// Returns true and fills result if the cache holds a result for address from the given generation.
+static bool cache_lookup(uintptr_t address, uint32_t generation, struct bsg_symbolicate_result *result) {
+    struct cache_entry *entry = cache_entry_for_address(address);
+    const uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+    if (!(sequence & 1) &&
+        atomic_load_explicit(&entry->generation, memory_order_relaxed) == generation &&
+        atomic_load_explicit(&entry->address, memory_order_relaxed) == address) {
+        result->function_address = atomic_load_explicit(&entry->function_address, memory_order_relaxed);
+        result->function_name = atomic_load_explicit(&entry->function_name, memory_order_relaxed);
+        result->image = atomic_load_explicit(&entry->image, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&entry->sequence, memory_order_relaxed) == sequence) {
+            atomic_fetch_add_explicit(&bsg_g_cache_hits, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+    atomic_fetch_add_explicit(&bsg_g_cache_misses, 1, memory_order_relaxed);
+    return false;
+}
+
+// Stores a result computed in the given generation. Gives up if another thread is writing the same slot.
+static void cache_store(uintptr_t address, uint32_t generation, const struct bsg_symbolicate_result *result) {
+    struct cache_entry *entry = cache_entry_for_address(address);
+    uint32_t sequence = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+    if ((sequence & 1) ||
+        !atomic_compare_exchange_strong_explicit(&entry->sequence, &sequence, sequence + 1,
+                                                 memory_order_acquire, memory_order_relaxed)) {
+        return;
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&entry->generation, generation, memory_order_relaxed);
+    atomic_store_explicit(&entry->address, address, memory_order_relaxed);
+    atomic_store_explicit(&entry->function_address, result->function_address, memory_order_relaxed);
+    atomic_store_explicit(&entry->function_name, result->function_name, memory_order_relaxed);
+    atomic_store_explicit(&entry->image, result->image, memory_order_relaxed);
+    atomic_store_explicit(&entry->sequence, sequence + 2, memory_order_release);
+}
+
+void bsg_symbolicate_indexed(const uintptr_t address, struct bsg_symbolicate_result *result) {
+    const uint32_t generation = atomic_load(&bsg_g_cache_generation);
+    if (cache_lookup(address, generation, result)) {
+        return;
+    }
+    symbolicate(address, result, true);
+    cache_store(address, generation, result);
+}
+
+struct batch_entry {
+    uintptr_t address;
+    size_t index;
+};
+
+static int batch_entry_compare(const void *a, const void *b) {
+    const struct batch_entry *lhs = a, *rhs = b;
+    return lhs->address < rhs->address ? -1 : lhs->address > rhs->address;
+}
+
+void bsg_symbolicate_batch(const uintptr_t *addresses, size_t count, struct bsg_symbolicate_result *results) {
+    struct batch_entry *entries = malloc(count * sizeof(*entries));
+    if (!entries) {
+        for (size_t i = 0; i < count; i++) {
+            bsg_symbolicate_indexed(addresses[i], &results[i]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        entries[i] = (struct batch_entry){addresses[i], i};
+    }
+    // Sorting brings addresses in the same image together, so that each image's load commands are
+    // only walked once.
+    qsort(entries, count, sizeof(*entries), batch_entry_compare);
+    
+    const uint32_t generation = atomic_load(&bsg_g_cache_generation);
+    struct image_symbols symbols = {0};
+    bool symbols_valid = false;
+    for (size_t i = 0; i < count; i++) {
+        const uintptr_t address = entries[i].address;
+        struct bsg_symbolicate_result *result = &results[entries[i].index];
+        bzero(result, sizeof(*result));
+        if (cache_lookup(address, generation, result)) {
+            continue;
+        }
+        
+        if (!symbols_valid || address < symbols.text_start || address >= symbols.text_end) {
+            struct bsg_mach_image *image = bsg_mach_headers_image_at_address(address);
+            if (!symbols_valid || image != symbols.image) {
+                symbols_valid = image_symbols_init(&symbols, image);
+            }
+        }
+        if (symbols_valid) {
+            symbolicate_in_image(&symbols, address, result, true);
+        }
+        cache_store(address, generation, result);
+    }
+    free(entries);
+}
+
+size_t bsg_symbolicate_index_bytes(void) {
+    return atomic_load(&bsg_g_index_bytes);
+}
+
+void bsg_symbolicate_free_indexes(struct bsg_mach_image *image) {
+    const struct bsg_function_starts *starts = atomic_exchange(&image->functionStarts, NULL);
+    if (starts) {
+        atomic_fetch_sub(&bsg_g_index_bytes, function_starts_size(starts));
+        free((void *)starts);
+    }
+    const struct bsg_symbol_index *index = atomic_exchange(&image->symbolIndex, NULL);
+    if (index) {
+        atomic_fetch_sub(&bsg_g_index_bytes, symbol_index_size(index));
+        free((void *)index);
+    }
+}
+
+void bsg_symbolicate_cache_invalidate(void) {
+    atomic_fetch_add(&bsg_g_cache_generation, 1);
+}
+
+struct bsg_symbolicate_cache_stats bsg_symbolicate_cache_stats(void) {
+    return (struct bsg_symbolicate_cache_stats){
+        .hits = atomic_load(&bsg_g_cache_hits),
+        .misses = atomic_load(&bsg_g_cache_misses)};
+}
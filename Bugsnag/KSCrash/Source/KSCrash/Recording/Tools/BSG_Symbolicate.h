@@ -8,6 +8,7 @@
 #ifndef BSG_Symbolicate_h
 #define BSG_Symbolicate_h
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -20,8 +21,46 @@ struct bsg_symbolicate_result {
     const char *function_name;
 };
 
+/// Finds the function containing an address using the image's function starts and symbol table.
+///
+/// Async-signal safe. Uses the image's indexes if they have already been built, and otherwise decodes
+/// LC_FUNCTION_STARTS and scans the symbol table linearly.
 void bsg_symbolicate(const uintptr_t address, struct bsg_symbolicate_result *result);
 
+/// Like bsg_symbolicate(), but first builds the image's function starts and symbol indexes if needed so
+/// that this and subsequent lookups in the image use binary searches. Results are cached by address until
+/// an image is unloaded.
+///
+/// Not async-signal safe because it allocates memory; must not be called while handling a crash.
+void bsg_symbolicate_indexed(const uintptr_t address, struct bsg_symbolicate_result *result);
+
+/// Symbolicates count addresses, storing the result for addresses[i] in results[i].
+///
+/// Addresses are processed in sorted order so that each image's load commands are only parsed once per
+/// batch, and its indexes and the results cache are used as by bsg_symbolicate_indexed(). Not async-signal safe.
+void bsg_symbolicate_batch(const uintptr_t *addresses, size_t count, struct bsg_symbolicate_result *results);
+
+/// The number of bytes used by the function starts and symbol indexes built by bsg_symbolicate_indexed().
+size_t bsg_symbolicate_index_bytes(void);
+
+/// Frees an image's function starts and symbol indexes and stops counting them in bsg_symbolicate_index_bytes().
+/// They are rebuilt when next needed.
+///
+/// Only safe when no other thread can be using the indexes, such as when resetting images in unit tests.
+void bsg_symbolicate_free_indexes(struct bsg_mach_image *image);
+
+struct bsg_symbolicate_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+};
+
+/// Discards all cached symbolication results. Called when an image is unloaded.
+void bsg_symbolicate_cache_invalidate(void);
+
+/// The number of results cache lookups by bsg_symbolicate_indexed() and bsg_symbolicate_batch() that have
+/// hit and missed.
+struct bsg_symbolicate_cache_stats bsg_symbolicate_cache_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,10 @@ NS_ASSUME_NONNULL_BEGIN
 BSG_OBJC_DIRECT_MEMBERS
 @interface BugsnagEvent ()
 
+/// The breadcrumbs as encoded by BugsnagBreadcrumbs. While this is set, they are written into the payload without
+/// being parsed, and `breadcrumbs` is only populated from them if it is accessed (e.g. by an OnError or OnSendError block.)
+@property (copy, nullable, nonatomic) NSArray<NSData *> *breadcrumbData;
+
 @property (copy, nonatomic) NSString *codeBundleId;
 
 /// User-provided exception metadata.
@@ -57,6 +61,10 @@ BSG_OBJC_DIRECT_MEMBERS
 /// Whether this report should be sent, based on release stage information cached at crash time and within the application currently.
 - (BOOL)shouldBeSent;
 
+/// Equivalent to `-toJsonWithRedactedKeys:` except that, if `breadcrumbData` is set, the breadcrumbs are returned via
+/// `breadcrumbsJSON` and replaced by `BSGJSONFragmentPlaceholder`, for use with `BSGJSONDataFromDictionaryWithFragment()`.
+- (NSDictionary *)toJsonWithRedactedKeys:(nullable NSSet *)redactedKeys breadcrumbsJSON:(NSData *_Nullable *_Nullable)breadcrumbsJSON;
+
 - (void)trimBreadcrumbs:(NSUInteger)bytesToRemove;
 
 - (void)truncateStrings:(NSUInteger)maxLength;
@@ -16,6 +16,7 @@
 #import "BSGUtils.h"
 #import "BSG_KSCrashReportFields.h"
 #import "BSG_RFC3339DateTool.h"
+#import "BSG_Symbolicate.h"
 #import "Bugsnag+Private.h"
 #import "BugsnagApp+Private.h"
 #import "BugsnagAppWithState+Private.h"
@@ -37,6 +38,38 @@
 
 static NSString * const RedactedMetadataValue = @"[REDACTED]";
 
+/**
+ * Whether a serialized breadcrumb might contain a key matching one of `redactedKeys`.
+ *
+ * This is a conservative check of the encoded bytes that avoids parsing breadcrumbs which cannot need redacting.
+ */
+static BOOL BreadcrumbDataMayContainRedactedKey(NSData *data, NSSet *redactedKeys) {
+    const char *bytes = data.bytes;
+    const NSUInteger length = data.length;
+    for (id obj in redactedKeys) {
+        if (![obj isKindOfClass:[NSString class]]) {
+            return YES; // Regular expressions cannot be checked without parsing
+        }
+        const char *key = [obj lowercaseString].UTF8String;
+        const size_t keyLength = key ? strlen(key) : 0;
+        if (!keyLength) {
+            return YES;
+        }
+        for (size_t i = 0; i < keyLength; i++) {
+            // Other characters may be escaped in JSON.
+            if (key[i] < 0x20 || key[i] > 0x7E || key[i] == '"' || key[i] == '\\') {
+                return YES;
+            }
+        }
+        for (NSUInteger i = 0; i + keyLength <= length; i++) {
+            if (tolower((unsigned char)bytes[i]) == key[0] && strncasecmp(bytes + i, key, keyLength) == 0) {
+                return YES;
+            }
+        }
+    }
+    return NO;
+}
+
 id BSGLoadConfigValue(NSDictionary *report, NSString *valueName) {
     NSString *keypath = [NSString stringWithFormat:@"user.config.%@", valueName];
     NSString *fallbackKeypath = [NSString stringWithFormat:@"user.config.config.%@", valueName];
@@ -490,6 +523,25 @@ BSG_OBJC_DIRECT_MEMBERS
     return userAtCrash;
 }
 
+// MARK: - breadcrumbs
+
+@synthesize breadcrumbs = _breadcrumbs;
+
+- (NSArray<BugsnagBreadcrumb *> *)breadcrumbs {
+    // Breadcrumbs are only parsed if something other than the payload serialization needs them.
+    NSArray<NSData *> *breadcrumbData = self.breadcrumbData;
+    if (breadcrumbData) {
+        _breadcrumbs = BugsnagBreadcrumbsFromJSONData(breadcrumbData);
+        self.breadcrumbData = nil;
+    }
+    return _breadcrumbs;
+}
+
+- (void)setBreadcrumbs:(NSArray<BugsnagBreadcrumb *> *)breadcrumbs {
+    _breadcrumbs = [breadcrumbs copy];
+    self.breadcrumbData = nil;
+}
+
 // MARK: - apiKey
 
 @synthesize apiKey = _apiKey;
@@ -516,18 +568,56 @@ BSG_OBJC_DIRECT_MEMBERS
 }
 
 - (NSArray<NSDictionary *> *)serializeBreadcrumbsWithRedactedKeys:(NSSet *)redactedKeys {
+    NSArray<NSData *> *breadcrumbData = self.breadcrumbData;
+    if (breadcrumbData) {
+        return BSGArrayMap(breadcrumbData, ^NSDictionary * (NSData *data) {
+            NSDictionary *dictionary = BSGJSONDictionaryFromData(data, 0, NULL);
+            return dictionary ? [self redactBreadcrumb:dictionary redactedKeys:redactedKeys] : nil;
+        });
+    }
     return BSGArrayMap(self.breadcrumbs, ^NSDictionary * (BugsnagBreadcrumb *breadcrumb) {
-        NSMutableDictionary *dictionary = [[breadcrumb objectValue] mutableCopy];
-        NSDictionary *metadata = dictionary[BSGKeyMetadata];
-        NSMutableDictionary *redactedMetadata = [NSMutableDictionary dictionary];
-        for (NSString *key in metadata) {
-            redactedMetadata[key] = [self redactedMetadataValue:metadata[key] forKey:key redactedKeys:redactedKeys];
-        }
-        dictionary[BSGKeyMetadata] = redactedMetadata;
-        return dictionary;
+        return [self redactBreadcrumb:[breadcrumb objectValue] redactedKeys:redactedKeys];
     });
 }
 
+/// Concatenates `breadcrumbData` into a JSON array, only parsing those breadcrumbs that may need redacting.
+- (NSData *)serializeBreadcrumbDataWithRedactedKeys:(NSSet *)redactedKeys {
+    NSArray<NSData *> *breadcrumbData = self.breadcrumbData ?: @[];
+    NSUInteger capacity = 2;
+    for (NSData *data in breadcrumbData) {
+        capacity += data.length + 1;
+    }
+    NSMutableData *JSONData = [NSMutableData dataWithCapacity:capacity];
+    [JSONData appendBytes:"[" length:1];
+    for (NSData *data in breadcrumbData) {
+        NSData *redactedData = data;
+        if (BreadcrumbDataMayContainRedactedKey(data, redactedKeys)) {
+            NSDictionary *dictionary = BSGJSONDictionaryFromData(data, 0, NULL);
+            redactedData = dictionary ? BSGJSONDataFromDictionary([self redactBreadcrumb:dictionary redactedKeys:redactedKeys], NULL) : nil;
+            if (!redactedData) {
+                continue;
+            }
+        }
+        if (JSONData.length > 1) {
+            [JSONData appendBytes:"," length:1];
+        }
+        [JSONData appendData:redactedData];
+    }
+    [JSONData appendBytes:"]" length:1];
+    return JSONData;
+}
+
+- (NSDictionary *)redactBreadcrumb:(NSDictionary *)breadcrumb redactedKeys:(NSSet *)redactedKeys {
+    NSMutableDictionary *dictionary = [breadcrumb mutableCopy];
+    NSDictionary *metadata = dictionary[BSGKeyMetadata];
+    NSMutableDictionary *redactedMetadata = [NSMutableDictionary dictionary];
+    for (NSString *key in metadata) {
+        redactedMetadata[key] = [self redactedMetadataValue:metadata[key] forKey:key redactedKeys:redactedKeys];
+    }
+    dictionary[BSGKeyMetadata] = redactedMetadata;
+    return dictionary;
+}
+
 - (void)attachCustomStacktrace:(NSArray *)frames withType:(NSString *)type {
     BugsnagError *error = self.errors.firstObject;
     error.stacktrace = [BugsnagStacktrace stacktraceFromJson:frames].trace;
@@ -591,6 +681,10 @@ BSG_OBJC_DIRECT_MEMBERS
 }
 
 - (NSDictionary *)toJsonWithRedactedKeys:(NSSet *)redactedKeys {
+    return [self toJsonWithRedactedKeys:redactedKeys breadcrumbsJSON:NULL];
+}
+
+- (NSDictionary *)toJsonWithRedactedKeys:(NSSet *)redactedKeys breadcrumbsJSON:(NSData **)breadcrumbsJSON {
     NSMutableDictionary *event = [NSMutableDictionary dictionary];
 
     event[BSGKeyExceptions] = ({
@@ -607,7 +701,15 @@ BSG_OBJC_DIRECT_MEMBERS
     
     event[BSGKeyThreads] = [BugsnagThread serializeThreads:self.threads];
     event[BSGKeySeverity] = BSGFormatSeverity(self.severity);
-    event[BSGKeyBreadcrumbs] = [self serializeBreadcrumbsWithRedactedKeys:redactedKeys];
+    if (breadcrumbsJSON) {
+        *breadcrumbsJSON = nil;
+    }
+    if (breadcrumbsJSON && self.breadcrumbData) {
+        *breadcrumbsJSON = [self serializeBreadcrumbDataWithRedactedKeys:redactedKeys];
+        event[BSGKeyBreadcrumbs] = BSGJSONFragmentPlaceholder;
+    } else {
+        event[BSGKeyBreadcrumbs] = [self serializeBreadcrumbsWithRedactedKeys:redactedKeys];
+    }
 
     NSMutableDictionary *metadata = [[[self metadata] toDictionary] mutableCopy];
     @try {
@@ -710,42 +812,61 @@ BSG_OBJC_DIRECT_MEMBERS
 }
 
 - (void)symbolicateIfNeeded {
+    NSMutableArray<BugsnagStackframe *> *stackframes = [NSMutableArray array];
     for (BugsnagError *error in self.errors) {
-        for (BugsnagStackframe *stackframe in error.stacktrace) {
-            [stackframe symbolicateIfNeeded];
-        }
+        [stackframes addObjectsFromArray:error.stacktrace];
     }
     for (BugsnagThread *thread in self.threads) {
-        for (BugsnagStackframe *stackframe in thread.stacktrace) {
-            [stackframe symbolicateIfNeeded];
-        }
+        [stackframes addObjectsFromArray:thread.stacktrace];
+    }
+    [BugsnagStackframe symbolicateStackframes:stackframes];
+    
+    NSDictionary *usage = self.usage;
+    if (usage) {
+        struct bsg_symbolicate_cache_stats cacheStats = bsg_symbolicate_cache_stats();
+        self.usage = BSGDictMerge(@{
+            @"system": @{
+                @"symbolicationCacheHits": @(cacheStats.hits),
+                @"symbolicationCacheMisses": @(cacheStats.misses),
+                @"symbolicationIndexBytes": @(bsg_symbolicate_index_bytes())}
+        }, usage);
     }
 }
 
 - (void)trimBreadcrumbs:(const NSUInteger)bytesToRemove {
-    NSMutableArray *breadcrumbs = [self.breadcrumbs mutableCopy];
-    BugsnagBreadcrumb *lastRemovedBreadcrumb = nil;
+    NSArray<NSData *> *breadcrumbData = self.breadcrumbData;
+    NSMutableArray *breadcrumbs = [(breadcrumbData ?: self.breadcrumbs) mutableCopy];
+    id lastRemovedBreadcrumb = nil;
     NSUInteger bytesRemoved = 0, count = 0;
     
     while (bytesRemoved < bytesToRemove && breadcrumbs.count) {
         lastRemovedBreadcrumb = [breadcrumbs firstObject];
         [breadcrumbs removeObjectAtIndex:0];
         
-        NSDictionary *dict = [lastRemovedBreadcrumb objectValue];
-        NSData *data = BSGJSONDataFromDictionary(dict, NULL);
+        NSData *data = breadcrumbData ? lastRemovedBreadcrumb :
+        BSGJSONDataFromDictionary([lastRemovedBreadcrumb objectValue], NULL);
         bytesRemoved += data.length;
         count++;
     }
     
-    if (lastRemovedBreadcrumb) {
-        lastRemovedBreadcrumb.message = count < 2 ? @"Removed to reduce payload size" :
+    BugsnagBreadcrumb *breadcrumb = breadcrumbData && lastRemovedBreadcrumb ?
+    BugsnagBreadcrumbsFromJSONData(@[lastRemovedBreadcrumb]).firstObject : lastRemovedBreadcrumb;
+    if (breadcrumb) {
+        breadcrumb.message = count < 2 ? @"Removed to reduce payload size" :
         [NSString stringWithFormat:@"Removed, along with %lu older breadcrumb%s, to reduce payload size",
          (unsigned long)(count - 1), count == 2 ? "" : "s"];
-        lastRemovedBreadcrumb.metadata = @{};
-        [breadcrumbs insertObject:lastRemovedBreadcrumb atIndex:0];
+        breadcrumb.metadata = @{};
+        id replacement = breadcrumbData ? BSGJSONDataFromDictionary([breadcrumb objectValue], NULL) : breadcrumb;
+        if (replacement) {
+            [breadcrumbs insertObject:replacement atIndex:0];
+        }
     }
     
-    self.breadcrumbs = breadcrumbs;
+    if (breadcrumbData) {
+        self.breadcrumbData = breadcrumbs;
+    } else {
+        self.breadcrumbs = breadcrumbs;
+    }
     
     NSDictionary *usage = self.usage;
     if (usage) {
@@ -771,9 +892,32 @@ BSG_OBJC_DIRECT_MEMBERS
         error.errorMessage = BSGTruncatePossibleString(&context, error.errorMessage);
     }
     
-    for (BugsnagBreadcrumb *breadcrumb in self.breadcrumbs) {
-        breadcrumb.message = BSGTruncateString(&context, breadcrumb.message);
-        breadcrumb.metadata = BSGTruncateStrings(&context, breadcrumb.metadata);
+    NSArray<NSData *> *breadcrumbData = self.breadcrumbData;
+    if (breadcrumbData) {
+        NSMutableArray<NSData *> *truncatedData = [NSMutableArray arrayWithCapacity:breadcrumbData.count];
+        for (NSData *data in breadcrumbData) {
+            // A string cannot be longer than the JSON it is encoded in, so most breadcrumbs need not be parsed.
+            if (data.length <= maxLength) {
+                [truncatedData addObject:data];
+                continue;
+            }
+            BugsnagBreadcrumb *breadcrumb = BugsnagBreadcrumbsFromJSONData(@[data]).firstObject;
+            if (!breadcrumb) {
+                continue;
+            }
+            breadcrumb.message = BSGTruncateString(&context, breadcrumb.message);
+            breadcrumb.metadata = BSGTruncateStrings(&context, breadcrumb.metadata);
+            NSData *truncated = BSGJSONDataFromDictionary([breadcrumb objectValue], NULL);
+            if (truncated) {
+                [truncatedData addObject:truncated];
+            }
+        }
+        self.breadcrumbData = truncatedData;
+    } else {
+        for (BugsnagBreadcrumb *breadcrumb in self.breadcrumbs) {
+            breadcrumb.message = BSGTruncateString(&context, breadcrumb.message);
+            breadcrumb.metadata = BSGTruncateStrings(&context, breadcrumb.metadata);
+        }
     }
     
     BugsnagMetadata *metadata = self.metadata; 
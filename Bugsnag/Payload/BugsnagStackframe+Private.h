@@ -21,6 +21,10 @@ BSG_OBJC_DIRECT_MEMBERS
 
 @property (nonatomic) BOOL needsSymbolication;
 
+/// Symbolicates those stackframes that need it with a single call to bsg_symbolicate_batch(), which only
+/// parses each image once. Like -symbolicateIfNeeded, this should be performed on a background thread.
++ (void)symbolicateStackframes:(NSArray<BugsnagStackframe *> *)stackframes;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -186,6 +186,7 @@ static NSDictionary * _Nullable FindImage(NSArray *images, uintptr_t addr) {
         _needsSymbolication = YES;
         BSG_Mach_Header_Info *header = bsg_mach_headers_image_at_address(address);
         if (header) {
+            bsg_mach_headers_ensure_populated(header);
             _machoFile = header->name ? @(header->name) : nil;
             _machoLoadAddress = @((uintptr_t)header->header);
             _machoVmAddress = @(header->imageVmAddr);
@@ -195,23 +196,58 @@ static NSDictionary * _Nullable FindImage(NSArray *images, uintptr_t addr) {
     return self;
 }
 
+static uintptr_t InstructionAddress(BugsnagStackframe *stackframe) {
+    uintptr_t frameAddress = stackframe.frameAddress.unsignedIntegerValue;
+    return stackframe.isPc ? frameAddress: CALL_INSTRUCTION_FROM_RETURN_ADDRESS(frameAddress);
+}
+
+static void ApplySymbolicateResult(BugsnagStackframe *stackframe, const struct bsg_symbolicate_result *result) {
+    if (result->function_address) {
+        stackframe.symbolAddress = @(result->function_address);
+    }
+    if (result->function_name) {
+        stackframe.method = @(result->function_name);
+    }
+}
+
 - (void)symbolicateIfNeeded {
     if (!self.needsSymbolication) {
         return;
     }
     self.needsSymbolication = NO;
     
-    uintptr_t frameAddress = self.frameAddress.unsignedIntegerValue;
-    uintptr_t instructionAddress = self.isPc ? frameAddress: CALL_INSTRUCTION_FROM_RETURN_ADDRESS(frameAddress);
     struct bsg_symbolicate_result result;
-    bsg_symbolicate(instructionAddress, &result);
-    
-    if (result.function_address) {
-        self.symbolAddress = @(result.function_address);
+    bsg_symbolicate_indexed(InstructionAddress(self), &result);
+    ApplySymbolicateResult(self, &result);
+}
+
++ (void)symbolicateStackframes:(NSArray<BugsnagStackframe *> *)stackframes {
+    NSMutableArray<BugsnagStackframe *> *frames = [NSMutableArray arrayWithCapacity:stackframes.count];
+    for (BugsnagStackframe *stackframe in stackframes) {
+        if (stackframe.needsSymbolication) {
+            [frames addObject:stackframe];
+        }
     }
-    if (result.function_name) {
-        self.method = @(result.function_name);
+    
+    const NSUInteger count = frames.count;
+    uintptr_t *addresses = calloc(count, sizeof(uintptr_t));
+    struct bsg_symbolicate_result *results = calloc(count, sizeof(struct bsg_symbolicate_result));
+    if (count && addresses && results) {
+        for (NSUInteger i = 0; i < count; i++) {
+            addresses[i] = InstructionAddress(frames[i]);
+        }
+        bsg_symbolicate_batch(addresses, count, results);
+        for (NSUInteger i = 0; i < count; i++) {
+            frames[i].needsSymbolication = NO;
+            ApplySymbolicateResult(frames[i], &results[i]);
+        }
+    } else {
+        for (BugsnagStackframe *stackframe in frames) {
+            [stackframe symbolicateIfNeeded];
+        }
     }
+    free(addresses);
+    free(results);
 }
 
 - (NSDictionary *)toDictionary {
@@ -127,4 +127,15 @@
         @"error", @"user_atcrash", @"config", @"metaData", @"state", @"breadcrumbs", @"metaData"]));
 }
 
+- (void)testTruncatedBinaryReport {
+    // Self-describe tag, "{", "report": "{"
+    const char bytes[] = "\xd9\xd9\xf7\xbf\x66report\xbf";
+    NSString *file = [self temporaryFileWithContents:@""];
+    [[NSData dataWithBytes:bytes length:sizeof(bytes) - 1] writeToFile:file atomically:NO];
+    BSGEventUploadKSCrashReportOperation *operation = [self operationWithFile:file];
+    XCTAssertNil([operation loadEventAndReturnError:nil]);
+    XCTAssertEqualObjects(self.errorClass, @"Invalid crash report");
+    XCTAssertEqualObjects(self.context, @"Binary report error");
+}
+
 @end
@@ -62,6 +62,22 @@
     XCTAssertNotNil(error);
 }
 
+- (void)testDataWithFragment {
+    NSData *fragment = [@"[{\"name\":\"spliced\"}]" dataUsingEncoding:NSUTF8StringEncoding];
+    NSDictionary *dictionary = @{@"events": @[@{@"breadcrumbs": BSGJSONFragmentPlaceholder, @"context": @"test"}]};
+    
+    NSData *data = BSGJSONDataFromDictionaryWithFragment(dictionary, fragment, nil);
+    XCTAssertEqualObjects(BSGJSONDictionaryFromData(data, 0, nil),
+                          (@{@"events": @[@{@"breadcrumbs": @[@{@"name": @"spliced"}], @"context": @"test"}]}));
+    
+    XCTAssertEqualObjects(BSGJSONDataFromDictionaryWithFragment(dictionary, nil, nil),
+                          BSGJSONDataFromDictionary(dictionary, nil));
+    
+    NSError *error = nil;
+    XCTAssertNil(BSGJSONDataFromDictionaryWithFragment(@{@"foo": @"bar"}, fragment, &error));
+    XCTAssertNotNil(error);
+}
+
 - (void)testExceptionHandling {
     NSError *error = nil;
 #pragma clang diagnostic push
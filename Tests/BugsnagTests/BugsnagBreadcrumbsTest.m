@@ -8,8 +8,10 @@
 
 #import "BSGTestCase.h"
 
+#import "BSGFileLocations.h"
 #import "BSGUtils.h"
 #import "BSG_KSJSONCodec.h"
+#import "BSG_RFC3339DateTool.h"
 #import "Bugsnag.h"
 #import "BugsnagBreadcrumb+Private.h"
 #import "BugsnagBreadcrumbs.h"
@@ -296,6 +298,101 @@ BSGBreadcrumbType BSGBreadcrumbTypeFromString(NSString *value);
     XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[NSDate distantPast]].count, 0);
 }
 
+- (void)testBreadcrumbsBeforeDateSearch {
+    [self.crumbs removeAllBreadcrumbs];
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:1700000000];
+    BugsnagBreadcrumb * (^ MakeBreadcrumb)(NSString *, NSTimeInterval) = ^(NSString *message, NSTimeInterval offset) {
+        return WithBlock(^(BugsnagBreadcrumb *crumb) {
+            crumb.message = message;
+            crumb.timestampString = [BSG_RFC3339DateTool stringFromDate:[date dateByAddingTimeInterval:offset]];
+        });
+    };
+    for (int i = 0; i < 10; i++) {
+        [self.crumbs addBreadcrumb:MakeBreadcrumb([NSString stringWithFormat:@"Crumb %d", i], i)];
+    }
+    
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:-0.001]].count, 0);
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:date].count, 1);
+    XCTAssertEqualObjects([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:4.5]].lastObject.message, @"Crumb 4");
+    XCTAssertEqual([self.crumbs serializedBreadcrumbsBeforeDate:[date dateByAddingTimeInterval:4.5]].count, 5);
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:9.0009]].count, 10);
+    
+    // A breadcrumb added out of order is still matched by its own timestamp.
+    [self.crumbs addBreadcrumb:MakeBreadcrumb(@"Late", 1)];
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:0.5]].count, 1);
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:1]].count, 3);
+    XCTAssertEqualObjects([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:1]].lastObject.message, @"Late");
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:8.5]].count, 10);
+}
+
+- (void)testBreadcrumbsBeforeDateAfterClockSetBack {
+    [self.crumbs removeAllBreadcrumbs];
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:1700000000];
+    BugsnagBreadcrumb * (^ MakeBreadcrumb)(NSString *, NSTimeInterval) = ^(NSString *message, NSTimeInterval offset) {
+        return WithBlock(^(BugsnagBreadcrumb *crumb) {
+            crumb.message = message;
+            crumb.timestampString = [BSG_RFC3339DateTool stringFromDate:[date dateByAddingTimeInterval:offset]];
+        });
+    };
+    for (int i = 0; i < 5; i++) {
+        [self.crumbs addBreadcrumb:MakeBreadcrumb([NSString stringWithFormat:@"Before %d", i], i)];
+    }
+    // The clock is set back by a minute.
+    for (int i = 0; i < 3; i++) {
+        [self.crumbs addBreadcrumb:MakeBreadcrumb([NSString stringWithFormat:@"After %d", i], i - 60)];
+    }
+    
+    // An app hang that started after the clock was set back includes the breadcrumbs added since then.
+    NSArray<BugsnagBreadcrumb *> *breadcrumbs = [self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:-59]];
+    XCTAssertEqualObjects([breadcrumbs valueForKeyPath:@"message"], (@[@"After 0", @"After 1"]));
+    XCTAssertEqual([self.crumbs serializedBreadcrumbsBeforeDate:[date dateByAddingTimeInterval:-59]].count, 2);
+    
+    breadcrumbs = [self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:2]];
+    XCTAssertEqualObjects([breadcrumbs valueForKeyPath:@"message"],
+                          (@[@"Before 0", @"Before 1", @"Before 2", @"After 0", @"After 1", @"After 2"]));
+    XCTAssertEqual([self.crumbs breadcrumbsBeforeDate:[date dateByAddingTimeInterval:-61]].count, 0);
+}
+
+- (void)testEncoding {
+    NSString *nul = [NSString stringWithFormat:@"before%Cafter", (unichar)0];
+    NSDictionary *metadata = @{
+        @"string": @"Hello \"world\"\n\u2603",
+        @"integer": @-42,
+        @"unsigned": @(4294967296ULL),
+        @"double": @3.25,
+        @"bool": @YES,
+        @"null": [NSNull null],
+        @"array": @[@1, @"two", @[@3], @{@"four": @4}],
+        @"invalid": @[[NSDate date], @(NAN), @(INFINITY)],
+        @"nul": nul,
+        @42: @"non-string key"
+    };
+    BugsnagBreadcrumb *breadcrumb = WithBlock(^(BugsnagBreadcrumb *crumb) {
+        crumb.message = @"Encoding \U0001F600";
+        crumb.metadata = metadata;
+        crumb.type = BSGBreadcrumbTypeNavigation;
+    });
+    [self.crumbs addBreadcrumb:breadcrumb];
+    XCTAssertEqual(self.crumbs.encodeCount, 4);
+    XCTAssertGreaterThan(self.crumbs.encodeDuration, 0);
+    
+    NSDictionary *objectValue = self.crumbs.breadcrumbs.lastObject.objectValue;
+    XCTAssertEqualObjects(objectValue[@"name"], @"Encoding \U0001F600");
+    XCTAssertEqualObjects(objectValue[@"type"], @"navigation");
+    XCTAssertEqualObjects(objectValue[@"timestamp"], breadcrumb.objectValue[@"timestamp"]);
+    XCTAssertEqualObjects(objectValue[@"metaData"], (@{
+        @"string": @"Hello \"world\"\n\u2603",
+        @"integer": @-42,
+        @"unsigned": @(4294967296ULL),
+        @"double": @3.25,
+        @"bool": @YES,
+        @"null": [NSNull null],
+        @"array": @[@1, @"two", @[@3], @{@"four": @4}],
+        @"invalid": @[],
+        @"nul": nul
+    }));
+}
+
 - (void)testBreadcrumbFromDict {
     XCTAssertNil([BugsnagBreadcrumb breadcrumbFromDict:@{}]);
     XCTAssertNil([BugsnagBreadcrumb breadcrumbFromDict:@{@"metadata": @{}}]);
@@ -471,10 +568,10 @@ static void * executeBlock(void *ptr) {
 #endif
     //
     // The aim of this test is to ensure that BugsnagBreadcrumbsWriteCrashReport will insert only valid JSON
-    // into a crash report when other threads are updating the breadcrumbs linked list.
+    // into a crash report when other threads are updating the breadcrumbs ring buffer.
     //
-    // So that the test spends less time serialising breadcrumbs and more time updating the linked list, the
-    // breadcrumb data is precomputed and not written to disk.
+    // So that the test spends less time serialising breadcrumbs and more time updating the ring buffer, the
+    // breadcrumb data is precomputed.
     //
     NSData *breadcrumbData = [NSJSONSerialization dataWithJSONObject:
                               [WithBlock(^(BugsnagBreadcrumb *breadcrumb) {
@@ -494,7 +591,7 @@ static void * executeBlock(void *ptr) {
             pthread_setname_np("com.bugsnag.testCrashReportWriterConcurrency.writer");
             dispatch_semaphore_signal(semaphore);
             while (!isFinished) {
-                [self.crumbs addBreadcrumbWithData:breadcrumbData writeToDisk:NO];
+                [self.crumbs addBreadcrumbWithData:breadcrumbData];
             }
         });
         // Wait for thread to start executing
@@ -553,6 +650,40 @@ static void * executeBlock(void *ptr) {
     }];
 }
 
+- (void)testConcurrentAddPerformance {
+    BugsnagConfiguration *configuration = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
+    configuration.maxBreadcrumbs = 500;
+    BugsnagBreadcrumbs *crumbs = [[BugsnagBreadcrumbs alloc] initWithConfiguration:configuration];
+    [crumbs removeAllBreadcrumbs];
+    
+    NSData *breadcrumbData = [NSJSONSerialization dataWithJSONObject:
+                              [WithMessage(@"Lorem ipsum dolor sit amet") objectValue] options:0 error:nil];
+    
+    const size_t threadCount = 8, addsPerThread = 10000;
+    __block CFTimeInterval elapsed = 0;
+    __block NSUInteger iterations = 0;
+    [self measureBlock:^{
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(__unused size_t thread) {
+            for (size_t i = 0; i < addsPerThread; i++) {
+                [crumbs addBreadcrumbWithData:breadcrumbData];
+            }
+        });
+        elapsed += CFAbsoluteTimeGetCurrent() - start;
+        iterations++;
+    }];
+    NSLog(@"%s: %.0f adds/sec across %zu threads", __PRETTY_FUNCTION__,
+          (double)(iterations * threadCount * addsPerThread) / elapsed, threadCount);
+    
+    // Records can be lost if their producer was preempted long enough for the arena to wrap, so only the upper
+    // bound is deterministic while producers are racing. A single add afterwards must always be retained.
+    XCTAssertLessThanOrEqual(crumbs.breadcrumbs.count, 500);
+    [crumbs addBreadcrumb:WithMessage(@"Last")];
+    NSArray<BugsnagBreadcrumb *> *breadcrumbs = crumbs.breadcrumbs;
+    XCTAssertLessThanOrEqual(breadcrumbs.count, 500);
+    XCTAssertEqualObjects(breadcrumbs.lastObject.message, @"Last");
+}
+
 #if TARGET_OS_WATCH
 
 - (void)testShouldNotCacheBreadcrumbsOnWatchOs {
@@ -591,6 +722,97 @@ static void * executeBlock(void *ptr) {
     XCTAssertEqual(1, cachedBredcrumbs.count);
 }
 
+- (void)testCachedBreadcrumbsAfterRelaunch {
+    BugsnagConfiguration *config = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
+    config.maxBreadcrumbs = 20;
+    self.crumbs = [[BugsnagBreadcrumbs alloc] initWithConfiguration:config];
+    [self.crumbs removeAllBreadcrumbs];
+    [self.crumbs addBreadcrumb:WithMessage(@"Crumb 1")];
+    [self.crumbs addBreadcrumb:WithMessage(@"Crumb 2")];
+    
+    // A new capacity with the same journal size maps the journal again, as would happen at next launch.
+    config.maxBreadcrumbs = 30;
+    BugsnagBreadcrumbs *relaunched = [[BugsnagBreadcrumbs alloc] initWithConfiguration:config];
+    XCTAssertEqual(relaunched.breadcrumbs.count, 0);
+    XCTAssertEqualObjects([relaunched.cachedBreadcrumbs valueForKey:@"message"], (@[@"Crumb 1", @"Crumb 2"]));
+}
+
+- (void)testCachedBreadcrumbsFromPreviousVersion {
+    BugsnagConfiguration *config = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
+    config.enabledErrorTypes.ooms = YES;
+    self.crumbs = [[BugsnagBreadcrumbs alloc] initWithConfiguration:config];
+    [self.crumbs removeAllBreadcrumbs];
+    awaitBreadcrumbSync(self.crumbs);
+    
+    // Previous versions stored one breadcrumb per file, named after an incrementing number.
+    NSString *directory = [BSGFileLocations current].breadcrumbs;
+    for (unsigned int i = 8; i <= 11; i++) {
+        NSData *data = [NSJSONSerialization dataWithJSONObject:
+                        [WithMessage([NSString stringWithFormat:@"Crumb %u", i]) objectValue] options:0 error:nil];
+        NSString *file = [directory stringByAppendingPathComponent:[NSString stringWithFormat:@"%u.json", i]];
+        XCTAssertTrue([data writeToFile:file atomically:NO]);
+    }
+    [@"{" writeToFile:[directory stringByAppendingPathComponent:@".dat.nosync43c9.RZFc3z"]
+           atomically:NO encoding:NSUTF8StringEncoding error:nil];
+    
+    XCTAssertEqualObjects([self.crumbs.cachedBreadcrumbs valueForKey:@"message"],
+                          (@[@"Crumb 8", @"Crumb 9", @"Crumb 10", @"Crumb 11"]));
+    
+    [self.crumbs removeAllBreadcrumbs];
+    awaitBreadcrumbSync(self.crumbs);
+    XCTAssertEqual(self.crumbs.cachedBreadcrumbs.count, 0);
+}
+
+- (void)testAddBreadcrumbPerformance {
+    BugsnagConfiguration *config = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
+    config.maxBreadcrumbs = 500;
+    self.crumbs = [[BugsnagBreadcrumbs alloc] initWithConfiguration:config];
+    [self.crumbs removeAllBreadcrumbs];
+    
+    BugsnagBreadcrumb *breadcrumb = WithMessage(@"Lorem ipsum dolor sit amet");
+    breadcrumb.metadata = @{@"foo": @"bar", @"baz": @[@1, @2, @3]};
+    [self measureBlock:^{
+        for (int i = 0; i < 1000; i++) {
+            [self.crumbs addBreadcrumb:breadcrumb];
+        }
+    }];
+    XCTAssertEqual(self.crumbs.breadcrumbs.count, 500);
+}
+
+- (void)testCachedBreadcrumbsPerformance {
+    BugsnagConfiguration *config = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
+    config.maxBreadcrumbs = 500;
+    self.crumbs = [[BugsnagBreadcrumbs alloc] initWithConfiguration:config];
+    [self.crumbs removeAllBreadcrumbs];
+    for (int i = 0; i < 500; i++) {
+        [self.crumbs addBreadcrumb:WithMessage([NSString stringWithFormat:@"Crumb %d", i])];
+    }
+    
+    __block NSArray<BugsnagBreadcrumb *> *cachedBreadcrumbs = nil;
+    [self measureBlock:^{
+        cachedBreadcrumbs = [self.crumbs cachedBreadcrumbs];
+    }];
+    XCTAssertEqual(cachedBreadcrumbs.count, 500);
+    XCTAssertEqualObjects(cachedBreadcrumbs.lastObject.message, @"Crumb 499");
+}
+
+- (void)testBreadcrumbsBeforeDatePerformance {
+    BugsnagConfiguration *config = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
+    config.maxBreadcrumbs = 500;
+    self.crumbs = [[BugsnagBreadcrumbs alloc] initWithConfiguration:config];
+    [self.crumbs removeAllBreadcrumbs];
+    for (int i = 0; i < 500; i++) {
+        [self.crumbs addBreadcrumb:WithMessage([NSString stringWithFormat:@"Crumb %d", i])];
+    }
+    
+    NSDate *date = [NSDate date];
+    __block NSArray<NSData *> *breadcrumbs = nil;
+    [self measureBlock:^{
+        breadcrumbs = [self.crumbs serializedBreadcrumbsBeforeDate:date];
+    }];
+    XCTAssertEqual(breadcrumbs.count, 500);
+}
+
 - (void)testShouldNotCacheBreadcrumbsIfOOMsAndThermalKillsAreNotSupported {
     BugsnagConfiguration *config = [[BugsnagConfiguration alloc] initWithApiKey:DUMMY_APIKEY_32CHAR_1];
     config.enabledErrorTypes.thermalKills = NO;
@@ -8,7 +8,9 @@
 
 #import "BSGTestCase.h"
 
+#import "BSGJSONSerialization.h"
 #import "BSG_RFC3339DateTool.h"
+#import "BSG_Symbolicate.h"
 #import "Bugsnag.h"
 #import "BugsnagBreadcrumb+Private.h"
 #import "BugsnagClient+Private.h"
@@ -386,6 +388,22 @@
     XCTAssertEqualObjects(event.usage, (@{@"system": @{@"breadcrumbBytesRemoved": @(byteCount), @"breadcrumbsRemoved": @1}}));
 }
 
+- (void)testSymbolicationTelemetry {
+    [[BugsnagStackframe stackframesWithCallStackReturnAddresses:NSThread.callStackReturnAddresses]
+     makeObjectsPerformSelector:@selector(symbolicateIfNeeded)];
+    XCTAssertGreaterThan(bsg_symbolicate_index_bytes(), 0);
+    
+    BugsnagEvent *event = [self generateEvent:nil];
+    event.usage = @{}; // Enable gathering telemetry
+    [event symbolicateIfNeeded];
+    XCTAssertEqualObjects([event.usage valueForKeyPath:@"system.symbolicationIndexBytes"],
+                          @(bsg_symbolicate_index_bytes()));
+    XCTAssertEqualObjects([event.usage valueForKeyPath:@"system.symbolicationCacheHits"],
+                          @(bsg_symbolicate_cache_stats().hits));
+    XCTAssertEqualObjects([event.usage valueForKeyPath:@"system.symbolicationCacheMisses"],
+                          @(bsg_symbolicate_cache_stats().misses));
+}
+
 - (void)testTruncateStrings {
     BugsnagEvent *event = [BugsnagEvent new];
     
@@ -438,6 +456,75 @@
                           "\n***101 CHARS TRUNCATED***");
 }
 
+- (void)testBreadcrumbData {
+    BugsnagEvent *event = [self generateEvent:[BugsnagHandledState handledStateWithSeverityReason:HandledException]];
+    
+    NSData * (^ MakeBreadcrumbData)() = ^(NSString *message, NSDictionary *metadata) {
+        BugsnagBreadcrumb *breadcrumb = [BugsnagBreadcrumb new];
+        breadcrumb.message = message;
+        breadcrumb.metadata = metadata;
+        return [NSJSONSerialization dataWithJSONObject:[breadcrumb objectValue] options:0 error:NULL];
+    };
+    
+    event.breadcrumbData = @[
+        MakeBreadcrumbData(@"Logged in", @{@"user": @"alice", @"Password": @"hunter2"}),
+        MakeBreadcrumbData(@"Tapped button", @{@"button": @"Next"})];
+    
+    NSSet *redactedKeys = [NSSet setWithObject:@"password"];
+    NSData *breadcrumbsJSON = nil;
+    NSDictionary *json = [event toJsonWithRedactedKeys:redactedKeys breadcrumbsJSON:&breadcrumbsJSON];
+    XCTAssertEqualObjects(json[@"breadcrumbs"], BSGJSONFragmentPlaceholder);
+    XCTAssertNotNil(breadcrumbsJSON);
+    XCTAssertNotNil(event.breadcrumbData, @"Serializing the event should not parse its breadcrumbs");
+    
+    NSDictionary *spliced = BSGJSONDictionaryFromData(BSGJSONDataFromDictionaryWithFragment(json, breadcrumbsJSON, NULL), 0, NULL);
+    XCTAssertEqualObjects(spliced[@"breadcrumbs"], [event toJsonWithRedactedKeys:redactedKeys][@"breadcrumbs"]);
+    XCTAssertEqualObjects([spliced valueForKeyPath:@"breadcrumbs.metaData.Password"], (@[@"[REDACTED]", [NSNull null]]));
+    XCTAssertEqualObjects([spliced valueForKeyPath:@"breadcrumbs.metaData.user"], (@[@"alice", [NSNull null]]));
+    
+    XCTAssertEqual(event.breadcrumbs.count, 2);
+    XCTAssertEqualObjects(event.breadcrumbs[0].metadata[@"Password"], @"hunter2");
+    XCTAssertEqualObjects(event.breadcrumbs[1].message, @"Tapped button");
+    XCTAssertNil(event.breadcrumbData, @"Accessing breadcrumbs should replace breadcrumbData");
+    
+    event.breadcrumbs[1].message = @"Modified by callback";
+    json = [event toJsonWithRedactedKeys:redactedKeys breadcrumbsJSON:&breadcrumbsJSON];
+    XCTAssertNil(breadcrumbsJSON);
+    XCTAssertEqualObjects([json valueForKeyPath:@"breadcrumbs.name"], (@[@"Logged in", @"Modified by callback"]));
+}
+
+- (void)testTrimBreadcrumbData {
+    BugsnagEvent *event = [BugsnagEvent new];
+    
+    NSData * (^ MakeBreadcrumbData)() = ^(BSGBreadcrumbType type, NSString *message, NSDictionary *metadata) {
+        BugsnagBreadcrumb *breadcrumb = [BugsnagBreadcrumb new];
+        breadcrumb.type = type;
+        breadcrumb.message = message;
+        breadcrumb.metadata = metadata;
+        return [NSJSONSerialization dataWithJSONObject:[breadcrumb objectValue] options:0 error:NULL];
+    };
+    
+    event.breadcrumbData = @[
+        MakeBreadcrumbData(BSGBreadcrumbTypeState, @"Test started", @{}), // 91 bytes
+        MakeBreadcrumbData(BSGBreadcrumbTypeLog, @"Some log message", @{@"some": @"metadata"}), // 110 bytes
+        MakeBreadcrumbData(BSGBreadcrumbTypeManual, @"The final breadcrumb", @{@"key": @"untouched"})];
+    
+    event.usage = @{@"sentinel": @42}; // Enable gathering telemetry
+    
+    [event trimBreadcrumbs:100];
+    
+    XCTAssertEqual(event.breadcrumbData.count, 2);
+    XCTAssertEqualObjects(event.usage, (@{@"system": @{@"breadcrumbBytesRemoved": @(91 + 110), @"breadcrumbsRemoved": @2}, @"sentinel": @42}));
+    
+    XCTAssertEqual       (event.breadcrumbs[0].type, BSGBreadcrumbTypeLog);
+    XCTAssertEqualObjects(event.breadcrumbs[0].message, @"Removed, along with 1 older breadcrumb, to reduce payload size");
+    XCTAssertEqualObjects(event.breadcrumbs[0].metadata, @{});
+    
+    XCTAssertEqual       (event.breadcrumbs[1].type, BSGBreadcrumbTypeManual);
+    XCTAssertEqualObjects(event.breadcrumbs[1].message, @"The final breadcrumb");
+    XCTAssertEqualObjects(event.breadcrumbs[1].metadata, @{@"key": @"untouched"});
+}
+
 // MARK: - Feature flags interface
 
 - (void)testFeatureFlags {
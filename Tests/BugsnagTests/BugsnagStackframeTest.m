@@ -286,4 +286,24 @@
     }];
 }
 
+- (void)testSymbolicateStackframes {
+    bsg_mach_headers_initialize();
+    bsg_mach_headers_get_images(); // Ensure call stack can be symbolicated
+    
+    NSArray<NSNumber *> *addresses = NSThread.callStackReturnAddresses;
+    NSArray<BugsnagStackframe *> *batched = [BugsnagStackframe stackframesWithCallStackReturnAddresses:addresses];
+    NSArray<BugsnagStackframe *> *individual = [BugsnagStackframe stackframesWithCallStackReturnAddresses:addresses];
+    
+    // Reversed and duplicated frames should have the same results as frames symbolicated one by one
+    [BugsnagStackframe symbolicateStackframes:
+     [batched.reverseObjectEnumerator.allObjects arrayByAddingObjectsFromArray:batched]];
+    
+    for (NSUInteger i = 0; i < addresses.count; i++) {
+        XCTAssertFalse(batched[i].needsSymbolication);
+        [individual[i] symbolicateIfNeeded];
+        XCTAssertEqualObjects(batched[i].symbolAddress, individual[i].symbolAddress);
+        XCTAssertEqualObjects(batched[i].method, individual[i].method);
+    }
+}
+
 @end
@@ -68,8 +68,157 @@
     XCTAssertEqualObjects(binaryImageAddrs, backtraceImageAddrs);
 }
 
+- (void)testPreallocatedReportFile {
+    NSString *crashReportFilePath = [self temporaryFile:@"crash_report.json"];
+    NSString *preallocatedFilePath = [self temporaryFile:@"crash_report.preallocated"];
+    BSG_KSCrash_Context *context = [self installWithSyntheticStackTrace:crashReportFilePath];
+    
+    XCTAssertTrue(bsg_kscrashreport_preallocateReportFile([preallocatedFilePath fileSystemRepresentation], 4096));
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:preallocatedFilePath error:nil];
+    XCTAssertEqual(attributes.fileSize, 4096);
+    
+    // The report is larger than the preallocated size, so must spill over into ordinary writes.
+#if BSG_HAVE_MACH_THREADS
+    bsg_kscrashsentry_suspendThreads();
+#endif
+    bsg_kscrashreport_writeStandardReport(context, [crashReportFilePath fileSystemRepresentation]);
+#if BSG_HAVE_MACH_THREADS
+    bsg_kscrashsentry_resumeThreads();
+#endif
+    
+    XCTAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:preallocatedFilePath]);
+    NSData *data = [NSData dataWithContentsOfFile:crashReportFilePath];
+    NSDictionary *report = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    XCTAssert([report isKindOfClass:[NSDictionary class]], @"%@", report);
+    XCTAssertEqualObjects([report valueForKeyPath:@"writer_stats.mapped"], @YES);
+    XCTAssertGreaterThan(data.length, 4096);
+    XCTAssertEqual(((const char *)data.bytes)[data.length - 1], '}', @"Preallocated space should be truncated");
+}
+
+- (void)testReportTemplate {
+    NSString *crashReportFilePath = [self temporaryFile:@"crash_report.json"];
+    BSG_KSCrash_Context *context = [self installWithSyntheticStackTrace:crashReportFilePath];
+    const char *reportPath = [crashReportFilePath fileSystemRepresentation];
+    
+    NSDictionary *templateReport = [self writeStandardReport:context path:reportPath];
+    XCTAssertGreaterThan([[templateReport valueForKeyPath:@"writer_stats.template_bytes"] unsignedLongValue],
+                         strlen(context->config.systemInfoJSON));
+    
+    // A config value that no longer matches the template means the fields are encoded as usual.
+    char *systemInfoJSON = context->config.systemInfoJSON;
+    context->config.systemInfoJSON = strdup(systemInfoJSON);
+    context->config.generation++;
+    NSDictionary *report = [self writeStandardReport:context path:reportPath];
+    free(context->config.systemInfoJSON);
+    context->config.systemInfoJSON = systemInfoJSON;
+    XCTAssertEqualObjects([report valueForKeyPath:@"writer_stats.template_bytes"], @0);
+    
+    for (NSString *key in @[@"report.version", @"report.id", @"report.process_name", @"report.type", @"process", @"system"]) {
+        XCTAssertNotNil([report valueForKeyPath:key], @"%@", key);
+        XCTAssertEqualObjects([templateReport valueForKeyPath:key], [report valueForKeyPath:key], @"%@", key);
+    }
+    XCTAssertNotNil([templateReport valueForKeyPath:@"report.timestamp_millis"]);
+}
+
 - (void)testWriteStandardReportPerformance {
     NSString *crashReportFilePath = [self temporaryFile:@"crash_report"];
+    BSG_KSCrash_Context *context = [self installWithSyntheticStackTrace:crashReportFilePath];
+    
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        const char *reportPath = [crashReportFilePath fileSystemRepresentation];
+        
+        [self startMeasuring]; {
+#if BSG_HAVE_MACH_THREADS
+            bsg_kscrashsentry_suspendThreads();
+#endif
+            bsg_kscrashreport_writeStandardReport(context, reportPath);
+#if BSG_HAVE_MACH_THREADS
+            bsg_kscrashsentry_resumeThreads();
+#endif
+        }
+        [self stopMeasuring];
+        
+        NSDictionary *report = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfFile:crashReportFilePath] options:0 error:nil];
+        XCTAssert([report isKindOfClass:[NSDictionary class]], @"%@", report);
+        [[NSFileManager defaultManager] removeItemAtPath:crashReportFilePath error:nil];
+    }];
+}
+
+- (void)testWriteStandardReportPreallocatedPerformance {
+    NSString *crashReportFilePath = [self temporaryFile:@"crash_report"];
+    NSString *preallocatedFilePath = [self temporaryFile:@"crash_report.preallocated"];
+    BSG_KSCrash_Context *context = [self installWithSyntheticStackTrace:crashReportFilePath];
+    
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        const char *reportPath = [crashReportFilePath fileSystemRepresentation];
+        bsg_kscrashreport_preallocateReportFile([preallocatedFilePath fileSystemRepresentation], 512 * 1024);
+        
+        [self startMeasuring]; {
+#if BSG_HAVE_MACH_THREADS
+            bsg_kscrashsentry_suspendThreads();
+#endif
+            bsg_kscrashreport_writeStandardReport(context, reportPath);
+#if BSG_HAVE_MACH_THREADS
+            bsg_kscrashsentry_resumeThreads();
+#endif
+        }
+        [self stopMeasuring];
+        
+        NSDictionary *report = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfFile:crashReportFilePath] options:0 error:nil];
+        XCTAssert([report isKindOfClass:[NSDictionary class]], @"%@", report);
+        [[NSFileManager defaultManager] removeItemAtPath:crashReportFilePath error:nil];
+    }];
+}
+
+- (void)testWriteStandardReportWithoutTemplatePerformance {
+    NSString *crashReportFilePath = [self temporaryFile:@"crash_report"];
+    BSG_KSCrash_Context *context = [self installWithSyntheticStackTrace:crashReportFilePath];
+    
+    // Compare with testWriteStandardReportPerformance to see the time saved by the template.
+    char *systemInfoJSON = context->config.systemInfoJSON;
+    context->config.systemInfoJSON = strdup(systemInfoJSON);
+    context->config.generation++;
+    [self addTeardownBlock:^{
+        free(context->config.systemInfoJSON);
+        context->config.systemInfoJSON = systemInfoJSON;
+    }];
+    
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        const char *reportPath = [crashReportFilePath fileSystemRepresentation];
+        
+        [self startMeasuring]; {
+#if BSG_HAVE_MACH_THREADS
+            bsg_kscrashsentry_suspendThreads();
+#endif
+            bsg_kscrashreport_writeStandardReport(context, reportPath);
+#if BSG_HAVE_MACH_THREADS
+            bsg_kscrashsentry_resumeThreads();
+#endif
+        }
+        [self stopMeasuring];
+        
+        NSDictionary *report = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfFile:crashReportFilePath] options:0 error:nil];
+        XCTAssertEqualObjects([report valueForKeyPath:@"writer_stats.template_bytes"], @0);
+        [[NSFileManager defaultManager] removeItemAtPath:crashReportFilePath error:nil];
+    }];
+}
+
+- (NSDictionary *)writeStandardReport:(BSG_KSCrash_Context *)context path:(const char *)reportPath {
+#if BSG_HAVE_MACH_THREADS
+    bsg_kscrashsentry_suspendThreads();
+#endif
+    bsg_kscrashreport_writeStandardReport(context, reportPath);
+#if BSG_HAVE_MACH_THREADS
+    bsg_kscrashsentry_resumeThreads();
+#endif
+    NSData *data = [NSData dataWithContentsOfFile:@(reportPath)];
+    [[NSFileManager defaultManager] removeItemAtPath:@(reportPath) error:nil];
+    NSDictionary *report = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    XCTAssert([report isKindOfClass:[NSDictionary class]], @"%@", report);
+    return report;
+}
+
+- (BSG_KSCrash_Context *)installWithSyntheticStackTrace:(NSString *)crashReportFilePath {
     NSString *recrashReportFilePath = [self temporaryFile:@"recrash_report"];
     NSString *stateFilePath = [self temporaryFile:@"kscrash_state"];
     NSString *crashID = [[NSUUID UUID] UUIDString];
@@ -83,8 +232,8 @@
     
     // Make a fake stack trace with addresses from a library (Foundation) that will generate a non-trivial symbolication workload.
     
-    const int numFrames = 500;
-    uintptr_t stackTrace[numFrames];
+    static uintptr_t stackTrace[500];
+    const int numFrames = sizeof(stackTrace) / sizeof(*stackTrace);
     for (int i = 0; i < numFrames; i++) {
         stackTrace[i] = (uintptr_t)NSLog;
         assert(stackTrace[i] != 0);
@@ -99,25 +248,7 @@
     context->crash.stackTrace = stackTrace;
     context->crash.stackTraceLength = numFrames;
     context->crash.threadTracingEnabled = true;
-    
-    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
-        const char *reportPath = [crashReportFilePath fileSystemRepresentation];
-        
-        [self startMeasuring]; {
-#if BSG_HAVE_MACH_THREADS
-            bsg_kscrashsentry_suspendThreads();
-#endif
-            bsg_kscrashreport_writeStandardReport(context, reportPath);
-#if BSG_HAVE_MACH_THREADS
-            bsg_kscrashsentry_resumeThreads();
-#endif
-        }
-        [self stopMeasuring];
-        
-        NSDictionary *report = [NSJSONSerialization JSONObjectWithData:[NSData dataWithContentsOfFile:crashReportFilePath] options:0 error:nil];
-        XCTAssert([report isKindOfClass:[NSDictionary class]], @"%@", report);
-        [[NSFileManager defaultManager] removeItemAtPath:crashReportFilePath error:nil];
-    }];
+    return context;
 }
 
 - (NSString *)temporaryFile:(NSString *)fileName {
@@ -40,6 +40,13 @@ TEST_1_ARG(uint1, bsg_uint64_to_string, 1u, "1")
 TEST_1_ARG(uint1000, bsg_uint64_to_string, 1000u, "1000")
 TEST_1_ARG(uint1234567890, bsg_uint64_to_string, 1234567890u, "1234567890")
 TEST_1_ARG(uint18446744073709551615, bsg_uint64_to_string, 18446744073709551615u, "18446744073709551615")
+TEST_1_ARG(uint9, bsg_uint64_to_string, 9u, "9")
+TEST_1_ARG(uint10, bsg_uint64_to_string, 10u, "10")
+TEST_1_ARG(uint99, bsg_uint64_to_string, 99u, "99")
+TEST_1_ARG(uint100, bsg_uint64_to_string, 100u, "100")
+TEST_1_ARG(uint4294967296, bsg_uint64_to_string, 4294967296u, "4294967296")
+TEST_1_ARG(uint9999999999999999999, bsg_uint64_to_string, 9999999999999999999u, "9999999999999999999")
+TEST_1_ARG(uint10000000000000000000, bsg_uint64_to_string, 10000000000000000000u, "10000000000000000000")
 
 TEST_1_ARG(int0, bsg_int64_to_string, 0, "0")
 TEST_1_ARG(int1, bsg_int64_to_string, 1, "1")
@@ -63,6 +70,11 @@ TEST_2_ARG(hex9ad314_10, bsg_uint64_to_hex, 0x9ad314u, 10, "00009ad314")
 TEST_2_ARG(hex123456789abcdef0_0, bsg_uint64_to_hex, 0x123456789abcdef0u, 0, "123456789abcdef0")
 TEST_2_ARG(hex123456789abcdef0_16, bsg_uint64_to_hex, 0x123456789abcdef0u, 16, "123456789abcdef0")
 TEST_2_ARG(hex123456789abcdef0_80, bsg_uint64_to_hex, 0x123456789abcdef0u, 80, "123456789abcdef0")
+TEST_2_ARG(hexa_0, bsg_uint64_to_hex, 0xau, 0, "a")
+TEST_2_ARG(hexf_2, bsg_uint64_to_hex, 0xfu, 2, "0f")
+TEST_2_ARG(hexfedcba9876543210_0, bsg_uint64_to_hex, 0xfedcba9876543210u, 0, "fedcba9876543210")
+TEST_2_ARG(hexffffffffffffffff_0, bsg_uint64_to_hex, 0xffffffffffffffffu, 0, "ffffffffffffffff")
+TEST_2_ARG(hex100000000_0, bsg_uint64_to_hex, 0x100000000u, 0, "100000000")
 
 TEST_2_ARG(double0_0_0, bsg_double_to_string, 0.0, 0, "0")
 TEST_2_ARG(double0_0_1, bsg_double_to_string, 0.0, 1, "0")
@@ -73,4 +85,172 @@ TEST_2_ARG(double0_24_1, bsg_double_to_string, 0.24, 1, "2e-1")
 TEST_2_ARG(double0_25_1, bsg_double_to_string, 0.25, 1, "3e-1")
 TEST_2_ARG(double942_29912354_10, bsg_double_to_string, 942.29912354, 10, "9.422991235e+2")
 
+TEST_1_ARG(shortest0, bsg_double_to_shortest_string, 0.0, "0")
+TEST_1_ARG(shortestn0, bsg_double_to_shortest_string, -0.0, "0")
+TEST_1_ARG(shortest1, bsg_double_to_shortest_string, 1.0, "1")
+TEST_1_ARG(shortest10, bsg_double_to_shortest_string, 10.0, "1e+1")
+TEST_1_ARG(shortest0_1, bsg_double_to_shortest_string, 0.1, "1e-1")
+TEST_1_ARG(shortest0_3, bsg_double_to_shortest_string, 0.1 + 0.2, "3.0000000000000004e-1")
+TEST_1_ARG(shortest942_29912354, bsg_double_to_shortest_string, 942.29912354, "9.4229912354e+2")
+TEST_1_ARG(shortestn1_5, bsg_double_to_shortest_string, -1.5, "-1.5")
+TEST_1_ARG(shortestMin, bsg_double_to_shortest_string, 5e-324, "5e-324")
+TEST_1_ARG(shortestMinNormal, bsg_double_to_shortest_string, 2.2250738585072014e-308, "2.2250738585072014e-308")
+TEST_1_ARG(shortestMax, bsg_double_to_shortest_string, 1.7976931348623157e308, "1.7976931348623157e+308")
+TEST_1_ARG(shortestNaN, bsg_double_to_shortest_string, NAN, "nan")
+TEST_1_ARG(shortestInf, bsg_double_to_shortest_string, INFINITY, "inf")
+TEST_1_ARG(shortestnInf, bsg_double_to_shortest_string, -INFINITY, "-inf")
+
+static uint64_t xorshift64(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+static void assertRoundTrips(KSCrashStringConversionTests *self, double value) {
+    char buff[32];
+    memset(buff, '~', sizeof(buff));
+    size_t length = bsg_double_to_shortest_string(value, buff);
+    XCTAssertEqual(length, strlen(buff));
+    XCTAssertLessThan(length, 25);
+    double parsed = strtod(buff, NULL);
+    if (memcmp(&parsed, &value, sizeof(value)) != 0 && !(value == 0 && parsed == 0)) {
+        XCTFail(@"%.17g converted to %s", value, buff);
+    }
+}
+
+- (void)testShortestRoundTripsRandomBitPatterns {
+    uint64_t state = 88172645463325252ULL;
+    for (int i = 0; i < 1000000; i++) {
+        uint64_t bits = xorshift64(&state);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (isfinite(value)) {
+            assertRoundTrips(self, value);
+        }
+    }
+}
+
+- (void)testShortestRoundTripsExponentBoundaries {
+    // Every binary exponent, with the smallest, largest and a middle significand.
+    const uint64_t significands[] = {0, 1, 0x8000000000000, 0xFFFFFFFFFFFFF};
+    for (uint64_t exponent = 0; exponent < 0x7FF; exponent++) {
+        for (size_t i = 0; i < sizeof(significands) / sizeof(*significands); i++) {
+            uint64_t bits = (exponent << 52) | significands[i];
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            assertRoundTrips(self, value);
+            assertRoundTrips(self, -value);
+        }
+    }
+}
+
+- (void)testShortestRoundTripsTypicalValues {
+    for (int i = 0; i < 1000000; i++) {
+        assertRoundTrips(self, i);
+        assertRoundTrips(self, i / 1000.0);
+        assertRoundTrips(self, 1.7e9 + i / 1000.0);
+    }
+}
+
+static double *typicalValues(size_t count) {
+    double *values = malloc(count * sizeof(*values));
+    uint64_t state = 88172645463325252ULL;
+    for (size_t i = 0; i < count; i++) {
+        // Durations, memory figures and timestamps
+        values[i] = i % 2 ? (double)(xorshift64(&state) % 100000000) / 1000.0
+                          : 1.7e9 + (double)(xorshift64(&state) % 1000000) / 1000.0;
+    }
+    return values;
+}
+
+- (void)testDoubleToStringPerformance {
+    const size_t count = 100000;
+    double *values = typicalValues(count);
+    [self measureBlock:^{
+        char buff[32];
+        for (size_t i = 0; i < count; i++) {
+            bsg_double_to_string(values[i], buff, 7);
+        }
+    }];
+    free(values);
+}
+
+- (void)testDoubleToShortestStringPerformance {
+    const size_t count = 100000;
+    double *values = typicalValues(count);
+    [self measureBlock:^{
+        char buff[32];
+        for (size_t i = 0; i < count; i++) {
+            bsg_double_to_shortest_string(values[i], buff);
+        }
+    }];
+    free(values);
+}
+
+- (void)testSnprintfDoublePerformance {
+    // For comparison with bsg_double_to_shortest_string
+    const size_t count = 100000;
+    double *values = typicalValues(count);
+    [self measureBlock:^{
+        char buff[32];
+        for (size_t i = 0; i < count; i++) {
+            snprintf(buff, sizeof(buff), "%.17g", values[i]);
+        }
+    }];
+    free(values);
+}
+
+#define BENCHMARK_THREADS 32
+#define BENCHMARK_FRAMES 150
+#define BENCHMARK_FIELDS 5
+
+/**
+ * Values shaped like the numeric fields of a backtrace entry and its register
+ * dump: instruction, symbol and object addresses, an image size and a small
+ * index, for 150 frames on each of BENCHMARK_THREADS threads.
+ */
+static uint64_t *backtraceValues(size_t *count) {
+    *count = BENCHMARK_THREADS * BENCHMARK_FRAMES * BENCHMARK_FIELDS;
+    uint64_t *values = malloc(*count * sizeof(*values));
+    uint64_t state = 88172645463325252ULL;
+    for (size_t i = 0; i < *count; i++) {
+        switch (i % BENCHMARK_FIELDS) {
+            case 3: values[i] = xorshift64(&state) % 0x1000000; break;
+            case 4: values[i] = xorshift64(&state) % 4096; break;
+            default: values[i] = 0x100000000ULL + xorshift64(&state) % 0x200000000ULL; break;
+        }
+    }
+    return values;
+}
+
+- (void)testUInt64ToStringBacktracePerformance {
+    size_t count;
+    uint64_t *values = backtraceValues(&count);
+    [self measureBlock:^{
+        char buff[32];
+        for (int repeat = 0; repeat < 10; repeat++) {
+            for (size_t i = 0; i < count; i++) {
+                bsg_uint64_to_string(values[i], buff);
+            }
+        }
+    }];
+    free(values);
+}
+
+- (void)testUInt64ToHexBacktracePerformance {
+    size_t count;
+    uint64_t *values = backtraceValues(&count);
+    [self measureBlock:^{
+        char buff[32];
+        for (int repeat = 0; repeat < 10; repeat++) {
+            for (size_t i = 0; i < count; i++) {
+                bsg_uint64_to_hex(values[i], buff, 16);
+            }
+        }
+    }];
+    free(values);
+}
+
 @end
@@ -10,6 +10,8 @@
 
 #import "BSG_KSFile.h"
 
+#import <sys/mman.h>
+
 @interface BSG_KSFileTests : XCTestCase
 
 @property NSString *filePath;
@@ -58,6 +60,55 @@
     XCTAssertEqualObjects([self fileContentsAsString], @"Someone says: Hello, Supercalifragilisticexpialidocious");
 }
 
+- (void)testLargeWriteToEmptyBuffer {
+    BSG_KSFile file;
+    char buffer[8];
+    BSG_KSFileInit(&file, self.fileDescriptor, buffer, sizeof(buffer));
+    
+    BSG_KSFileWrite(&file, "Supercalifragilisticexpialidocious", 34);
+    XCTAssertEqual(file.bufferUsed, 0, @"Large writes should bypass an empty buffer");
+    XCTAssertEqualObjects([self fileContentsAsString], @"Supercalifragilisticexpialidocious");
+}
+
+- (void)testMappedWrite {
+    const size_t mapSize = 16;
+    ftruncate(self.fileDescriptor, mapSize);
+    char *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, self.fileDescriptor, 0);
+    XCTAssertNotEqual(map, MAP_FAILED);
+    
+    BSG_KSFile file;
+    char buffer[8];
+    BSG_KSFileInitMapped(&file, self.fileDescriptor, map, mapSize, buffer, sizeof(buffer));
+    
+    BSG_KSFileWrite(&file, "Someone says: ", 14);
+    XCTAssertEqual(file.mapUsed, 14);
+    XCTAssertEqual(file.bufferUsed, 0, @"Writes should go straight into the mapping");
+    XCTAssertEqual(BSG_KSFileOffset(&file), 14);
+    
+    BSG_KSFileWrite(&file, "Hello", 5);
+    XCTAssertEqual(file.mapUsed, mapSize);
+    XCTAssertEqual(file.bufferUsed, 3, @"Data beyond the mapping should be buffered");
+    XCTAssertEqual(BSG_KSFileOffset(&file), 19);
+    
+    XCTAssertTrue(BSG_KSFileTruncate(&file));
+    munmap(map, mapSize);
+    XCTAssertEqualObjects([self fileContentsAsString], @"Someone says: Hello");
+}
+
+- (void)testMappedWriteTruncatesUnusedSpace {
+    const size_t mapSize = 4096;
+    ftruncate(self.fileDescriptor, mapSize);
+    char *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, self.fileDescriptor, 0);
+    
+    BSG_KSFile file;
+    char buffer[8];
+    BSG_KSFileInitMapped(&file, self.fileDescriptor, map, mapSize, buffer, sizeof(buffer));
+    BSG_KSFileWrite(&file, "Supercalifragilisticexpialidocious", 34);
+    XCTAssertTrue(BSG_KSFileTruncate(&file));
+    munmap(map, mapSize);
+    XCTAssertEqualObjects([self fileContentsAsString], @"Supercalifragilisticexpialidocious");
+}
+
 - (NSString *)fileContentsAsString {
     return [NSString stringWithContentsOfFile:self.filePath encoding:NSUTF8StringEncoding error:nil];
 }
@@ -7,11 +7,14 @@
 //
 
 #import "BSG_KSMachHeaders.h"
+#import "BSG_Symbolicate.h"
 #import <Bugsnag/Bugsnag.h>
 #import <XCTest/XCTest.h>
 #import <dlfcn.h>
 #import <mach-o/dyld.h>
+#import <mach-o/getsect.h>
 #import <objc/runtime.h>
+#import <sys/mman.h>
 
 const struct mach_header header1 = {
     .magic = MH_MAGIC,
@@ -47,6 +50,12 @@ const struct segment_command command2 = {
     .vmsize = 10,
 };
 
+static struct {
+    uint64_t version;
+    uint64_t message;
+    uint64_t padding[6];
+} crash_info __attribute__((section("__DATA,__crash_info"), used)) = {.version = 5};
+
 @interface BSG_KSMachHeadersTests : XCTestCase
 @end
 
@@ -134,7 +143,7 @@ static BSG_Mach_Header_Info *get_tail(BSG_Mach_Header_Info *head) {
             // If dladdr was able to locate the image, so should bsg_mach_headers_image_at_address
             XCTAssertEqual(image->header, dlinfo.dli_fbase);
             XCTAssertEqual(image->imageVmAddr + image->slide, (uint64_t)dlinfo.dli_fbase);
-            XCTAssertEqual(image->name, dlinfo.dli_fname);
+            XCTAssertEqual(atomic_load(&image->name), dlinfo.dli_fname);
             XCTAssertFalse(image->unloaded);
         }
     }
@@ -144,4 +153,290 @@ static BSG_Mach_Header_Info *get_tail(BSG_Mach_Header_Info *head) {
     XCTAssertEqual(bsg_mach_headers_image_at_address(0x7FFFFFFFFFFFFFFF), NULL);
 }
 
+- (void)testImageAtAddressFindsEveryImage {
+    for (BSG_Mach_Header_Info *image = bsg_mach_headers_get_images(); image; image = image->next) {
+        if (image->unloaded || !image->imageSize) {
+            continue;
+        }
+        uintptr_t start = (uintptr_t)image->header;
+        XCTAssertEqual(bsg_mach_headers_image_at_address(start), image);
+        XCTAssertEqual(bsg_mach_headers_image_at_address(start + image->imageSize - 1), image);
+        XCTAssertNotEqual(bsg_mach_headers_image_at_address(start + image->imageSize), image);
+    }
+}
+
+- (void)testImageAtAddressPerformance {
+    NSArray<NSNumber *> *addresses = NSThread.callStackReturnAddresses;
+    [self measureBlock:^{
+        for (int i = 0; i < 10000; i++) {
+            for (NSNumber *address in addresses) {
+                bsg_mach_headers_image_at_address(address.unsignedIntegerValue);
+            }
+        }
+    }];
+}
+
+- (void)testImageNamed {
+    BSG_Mach_Header_Info *main = bsg_mach_headers_get_main_image();
+    XCTAssertEqual(bsg_mach_headers_image_named(main->name, true), main);
+    XCTAssertEqual(bsg_mach_headers_image_named(strrchr(main->name, '/') + 1, true), main);
+    XCTAssertEqual(bsg_mach_headers_image_named(main->name + 1, true), NULL);
+    XCTAssertEqual(bsg_mach_headers_image_named(main->name + 1, false), main);
+    XCTAssertEqual(bsg_mach_headers_image_named("no such image", true), NULL);
+}
+
+- (void)testImageNamedPerformance {
+    NSMutableArray<NSString *> *names = [NSMutableArray array];
+    for (BSG_Mach_Header_Info *image = bsg_mach_headers_get_images(); image; image = image->next) {
+        [names addObject:@(image->name)];
+    }
+    [self measureBlock:^{
+        for (int i = 0; i < 100; i++) {
+            for (NSString *name in names) {
+                bsg_mach_headers_image_named(name.UTF8String, true);
+            }
+        }
+    }];
+}
+
+#define SYNTHETIC_IMAGE_COUNT 1000
+
+static struct {
+    struct mach_header header;
+    struct segment_command command;
+} synthetic_images[SYNTHETIC_IMAGE_COUNT];
+
+static char synthetic_image_names[SYNTHETIC_IMAGE_COUNT][64];
+
+static const char * SyntheticImagePath(const struct mach_header *header) {
+    const size_t offset = (size_t)((const char *)header - (const char *)synthetic_images);
+    return synthetic_image_names[offset / sizeof(synthetic_images[0])];
+}
+
+- (void)testImageNamedSyntheticPerformance {
+    bsg_test_support_mach_headers_reset();
+    bsg_test_support_mach_headers_set_path_function(SyntheticImagePath);
+    for (uint32_t i = 0; i < SYNTHETIC_IMAGE_COUNT; i++) {
+        synthetic_images[i].header = (struct mach_header){
+            .magic = MH_MAGIC,
+            .ncmds = 1,
+            .sizeofcmds = sizeof(struct segment_command)
+        };
+        synthetic_images[i].command = (struct segment_command){
+            .cmd = LC_SEGMENT,
+            .cmdsize = sizeof(struct segment_command),
+            .segname = SEG_TEXT,
+            .vmaddr = (i + 1) * 0x1000,
+            .vmsize = 0x1000
+        };
+        snprintf(synthetic_image_names[i], sizeof(synthetic_image_names[i]),
+                 "/usr/lib/synthetic/libSynthetic%u.dylib", i);
+        bsg_test_support_mach_headers_add_image(&synthetic_images[i].header, 0);
+    }
+    
+    XCTAssertEqual(bsg_mach_headers_image_named("libSynthetic999.dylib", true)->imageVmAddr,
+                   synthetic_images[999].command.vmaddr);
+    
+    [self measureBlock:^{
+        for (uint32_t i = 0; i < SYNTHETIC_IMAGE_COUNT; i++) {
+            bsg_mach_headers_image_named(synthetic_image_names[i], true);
+            bsg_mach_headers_image_named(strrchr(synthetic_image_names[i], '/') + 1, true);
+        }
+    }];
+    bsg_test_support_mach_headers_reset();
+}
+
+- (void)testCrashInfoMessage {
+    // Images are found by their __TEXT segment, so use a code address in this test bundle.
+    BSG_Mach_Header_Info *image = bsg_mach_headers_image_at_address((uintptr_t)get_tail);
+    XCTAssertEqual(image->crashInfo, (uintptr_t)&crash_info);
+    
+    // A message ending just before an unreadable page
+    const size_t pageSize = (size_t)getpagesize();
+    char *pages = mmap(NULL, pageSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    mprotect(pages + pageSize, pageSize, PROT_NONE);
+    char *message = pages + pageSize - 10;
+    strcpy(message, "123456789");
+    crash_info.message = (uintptr_t)message;
+    XCTAssertEqual(bsg_mach_headers_get_crash_info_message(image), message);
+    
+    // An unterminated message running into an unreadable page
+    message[9] = '!';
+    XCTAssertEqual(bsg_mach_headers_get_crash_info_message(image), NULL);
+    
+    crash_info.message = 0;
+    XCTAssertEqual(bsg_mach_headers_get_crash_info_message(image), NULL);
+    munmap(pages, pageSize * 2);
+}
+
+static void RegisterLoadedImages(bool lazy) {
+    bsg_test_support_mach_headers_reset();
+    bsg_mach_headers_set_lazy_population(lazy);
+    for (uint32_t i = 0; i < _dyld_image_count(); i++) {
+        bsg_test_support_mach_headers_add_image(_dyld_get_image_header(i), _dyld_get_image_vmaddr_slide(i));
+    }
+    bsg_mach_headers_set_lazy_population(false);
+}
+
+- (void)testEagerRegistrationPerformance {
+    [self measureBlock:^{
+        RegisterLoadedImages(false);
+    }];
+    bsg_test_support_mach_headers_reset();
+}
+
+- (void)testLazyRegistrationPerformance {
+    // Compare with testEagerRegistrationPerformance to see the time saved in dyld's callbacks.
+    [self measureBlock:^{
+        RegisterLoadedImages(true);
+    }];
+    bsg_test_support_mach_headers_reset();
+}
+
+- (void)testLazyPopulation {
+    RegisterLoadedImages(true);
+    
+    // Lazily registered images can be found by address straight away
+    BSG_Mach_Header_Info *image = bsg_mach_headers_image_at_address((uintptr_t)get_tail);
+    XCTAssertNotEqual(image, NULL);
+    
+    // Crash handling names images from dyld's image list
+    bsg_mach_headers_populate_for_crash();
+    struct dl_info dlinfo = {0};
+    XCTAssertNotEqual(dladdr(image->header, &dlinfo), 0);
+    XCTAssertEqual(strcmp(image->name, dlinfo.dli_fname), 0);
+    
+    for (image = bsg_mach_headers_get_images(); image; image = image->next) {
+        bsg_mach_headers_ensure_populated(image);
+        if (image->unloaded) {
+            continue;
+        }
+        size_t length = 0;
+        XCTAssertNotEqual(atomic_load(&image->name), NULL);
+        XCTAssertNotEqual(bsg_mach_headers_get_json(image, &length), NULL);
+    }
+    BSG_Mach_Header_Info *main = bsg_mach_headers_get_main_image();
+    XCTAssertEqual(bsg_mach_headers_image_named(main->name, true), main);
+    
+    bsg_test_support_mach_headers_reset();
+}
+
+static const char * NoPath(__unused const struct mach_header *header) {
+    return NULL;
+}
+
+- (void)testNamelessImagesAreDropped {
+    for (int lazy = 0; lazy < 2; lazy++) {
+        bsg_test_support_mach_headers_reset();
+        bsg_test_support_mach_headers_set_path_function(NoPath);
+        bsg_mach_headers_set_lazy_population(lazy);
+        bsg_test_support_mach_headers_add_image(&header1, 0);
+        bsg_mach_headers_set_lazy_population(false);
+        
+        for (BSG_Mach_Header_Info *image = bsg_mach_headers_get_images(); image; image = image->next) {
+            bsg_mach_headers_ensure_populated(image);
+            XCTAssertTrue(image->unloaded, @"lazy = %d", lazy);
+        }
+        XCTAssertEqual(bsg_mach_headers_image_at_address((uintptr_t)&header1), NULL, @"lazy = %d", lazy);
+    }
+    bsg_test_support_mach_headers_reset();
+}
+
+- (void)testImageJSON {
+    for (BSG_Mach_Header_Info *image = bsg_mach_headers_get_images(); image; image = image->next) {
+        size_t length = 0;
+        const char *imageJSON = bsg_mach_headers_get_json(image, &length);
+        XCTAssertNotEqual(imageJSON, NULL);
+        XCTAssertEqual(strlen(imageJSON), length);
+        NSData *data = [NSData dataWithBytes:imageJSON length:length];
+        NSDictionary *json = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+        XCTAssertEqualObjects(json[@"image_addr"], @((uintptr_t)image->header));
+        XCTAssertEqualObjects(json[@"image_vmaddr"], @(image->imageVmAddr));
+        XCTAssertEqualObjects(json[@"image_size"], @(image->imageSize));
+        XCTAssertEqualObjects(json[@"name"], @(image->name));
+        XCTAssertEqualObjects(json[@"uuid"], image->uuid ? [[NSUUID alloc] initWithUUIDBytes:image->uuid].UUIDString : [NSNull null]);
+        XCTAssertEqualObjects(json[@"cpu_type"], @(image->header->cputype));
+        XCTAssertEqualObjects(json[@"cpu_subtype"], @(image->header->cpusubtype));
+    }
+}
+
+// Returns count random addresses within the __text section of an image.
+static NSData * RandomTextAddresses(BSG_Mach_Header_Info *image, NSUInteger count) {
+    unsigned long size = 0;
+#ifdef __LP64__
+    uint8_t *text = getsectiondata((const struct mach_header_64 *)image->header, SEG_TEXT, SECT_TEXT, &size);
+#else
+    uint8_t *text = getsectiondata(image->header, SEG_TEXT, SECT_TEXT, &size);
+#endif
+    NSMutableData *data = [NSMutableData dataWithLength:count * sizeof(uintptr_t)];
+    uintptr_t *addresses = data.mutableBytes;
+    for (NSUInteger i = 0; i < count; i++) {
+        addresses[i] = (uintptr_t)text + arc4random_uniform((uint32_t)size);
+    }
+    return data;
+}
+
+- (void)testSymbolicateIndexed {
+    BSG_Mach_Header_Info *image = bsg_mach_headers_image_at_address((uintptr_t)NSLog);
+    XCTAssertNotEqual(image, NULL);
+    NSData *data = RandomTextAddresses(image, 1000);
+    const uintptr_t *addresses = data.bytes;
+    
+    // Results from the linear decoding of LC_FUNCTION_STARTS
+    bsg_symbolicate_free_indexes(image);
+    const size_t indexBytes = bsg_symbolicate_index_bytes();
+    struct bsg_symbolicate_result *expected = calloc(1000, sizeof(struct bsg_symbolicate_result));
+    for (NSUInteger i = 0; i < 1000; i++) {
+        bsg_symbolicate(addresses[i], &expected[i]);
+    }
+    
+    for (NSUInteger i = 0; i < 1000; i++) {
+        struct bsg_symbolicate_result result;
+        bsg_symbolicate_indexed(addresses[i], &result);
+        XCTAssertEqual(result.image, expected[i].image);
+        XCTAssertEqual(result.function_address, expected[i].function_address);
+        XCTAssertEqual(result.function_name, expected[i].function_name);
+    }
+    XCTAssertNotEqual(atomic_load(&image->functionStarts), NULL);
+    XCTAssertGreaterThan(bsg_symbolicate_index_bytes(), indexBytes);
+    
+    // Freeing the indexes stops counting them
+    bsg_symbolicate_free_indexes(image);
+    XCTAssertEqual(bsg_symbolicate_index_bytes(), indexBytes);
+    free(expected);
+}
+
+- (void)testSymbolicateCache {
+    const uintptr_t address = (uintptr_t)NSLog;
+    struct bsg_symbolicate_result expected, result;
+    bsg_symbolicate(address, &expected);
+    
+    bsg_symbolicate_indexed(address, &result);
+    struct bsg_symbolicate_cache_stats stats = bsg_symbolicate_cache_stats();
+    bsg_symbolicate_indexed(address, &result);
+    XCTAssertEqual(bsg_symbolicate_cache_stats().hits, stats.hits + 1);
+    XCTAssertEqual(result.image, expected.image);
+    XCTAssertEqual(result.function_address, expected.function_address);
+    XCTAssertEqual(result.function_name, expected.function_name);
+    
+    // Unloading an image must discard cached results
+    bsg_test_support_mach_headers_remove_image(&header1, 0);
+    stats = bsg_symbolicate_cache_stats();
+    bsg_symbolicate_indexed(address, &result);
+    XCTAssertEqual(bsg_symbolicate_cache_stats().misses, stats.misses + 1);
+    XCTAssertEqual(result.function_address, expected.function_address);
+}
+
+- (void)testSymbolicateIndexedPerformance {
+    BSG_Mach_Header_Info *image = bsg_mach_headers_image_at_address((uintptr_t)NSLog);
+    NSData *data = RandomTextAddresses(image, 10000);
+    const uintptr_t *addresses = data.bytes;
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 10000; i++) {
+            struct bsg_symbolicate_result result;
+            bsg_symbolicate_indexed(addresses[i], &result);
+        }
+    }];
+}
+
 @end
@@ -27,6 +27,7 @@
 
 #import <XCTest/XCTest.h>
 
+#import "BSG_KSBacktrace_Private.h"
 #import "BSG_KSMach.h"
 #import "BSG_KSMachApple.h"
 #import "BSGDefines.h"
@@ -57,6 +58,35 @@
 @end
 
 
+@interface RecursingThread: TestThread
+
+@end
+
+@implementation RecursingThread
+
+static int __attribute__((noinline)) recurseThenWait(TestThread *thread, int depth)
+{
+    if (depth > 0)
+    {
+        // Adding to the result prevents this becoming a tail call.
+        return recurseThenWait(thread, depth - 1) + 1;
+    }
+    thread.thread = bsg_ksmachthread_self();
+    while(!thread.isCancelled)
+    {
+        [[thread class] sleepForTimeInterval:0.1];
+    }
+    return 0;
+}
+
+- (void) main
+{
+    recurseThenWait(self, 300);
+}
+
+@end
+
+
 void * executeBlock(void *ptr)
 {
     ((__bridge_transfer dispatch_block_t)ptr)();
@@ -331,6 +361,132 @@ void * executeBlock(void *ptr)
     thread_resume(thread.thread);
     [thread cancel];
 }
+
+- (void) testBacktraceRetainingTopAndBottom
+{
+    RecursingThread* thread = [[RecursingThread alloc] init];
+    [thread start];
+    [NSThread sleepForTimeInterval:0.1];
+    kern_return_t kr;
+    kr = thread_suspend(thread.thread);
+    XCTAssertTrue(kr == KERN_SUCCESS, @"");
+    
+    _STRUCT_MCONTEXT machineContext;
+    bool success = bsg_ksmachthreadState(thread.thread, &machineContext);
+    XCTAssertTrue(success, @"");
+    
+    uintptr_t full[1000];
+    int fullLength = bsg_ksbt_backtraceThreadState(&machineContext, full, 0, 1000);
+    XCTAssertGreaterThan(fullLength, 300);
+    XCTAssertLessThan(fullLength, 1000);
+    
+    uintptr_t retained[150];
+    int depth = 0;
+    int length = bsg_ksbt_backtraceThreadStateRetaining(&machineContext, retained, 100, 50, &depth);
+    XCTAssertEqual(length, 150);
+    XCTAssertEqual(depth, fullLength);
+    for (int i = 0; i < 100; i++)
+    {
+        XCTAssertEqual(retained[i], full[i], @"Top entry %d", i);
+    }
+    for (int i = 0; i < 50; i++)
+    {
+        XCTAssertEqual(retained[100 + i], full[fullLength - 50 + i], @"Bottom entry %d", i);
+    }
+    
+    // Short backtraces are kept in full.
+    length = bsg_ksbt_backtraceThreadStateRetaining(&machineContext, full, 500, 500, &depth);
+    XCTAssertEqual(length, fullLength);
+    XCTAssertEqual(depth, fullLength);
+
+    thread_resume(thread.thread);
+    [thread cancel];
+}
+
+static void setFrameRegisters(_STRUCT_MCONTEXT *machineContext, uintptr_t pc, uintptr_t fp)
+{
+    memset(machineContext, 0, sizeof(*machineContext));
+#if defined(__arm64__)
+    machineContext->__ss.__pc = pc;
+    machineContext->__ss.__fp = fp;
+#elif defined(__arm__)
+    machineContext->__ss.__pc = (__uint32_t)pc;
+    machineContext->__ss.__r[7] = (__uint32_t)fp;
+#elif defined(__x86_64__)
+    machineContext->__ss.__rip = pc;
+    machineContext->__ss.__rbp = fp;
+#elif defined(__i386__)
+    machineContext->__ss.__eip = (unsigned int)pc;
+    machineContext->__ss.__ebp = (unsigned int)fp;
+#endif
+}
+
+- (void) testBacktraceEndingInNullOrLowFramePointer
+{
+    struct { const void *previous; uintptr_t return_address; } frames[3] = {
+        {&frames[1], 0x2000},
+        {&frames[2], 0x3000},
+        {NULL, 0x4000},
+    };
+    _STRUCT_MCONTEXT machineContext;
+    uintptr_t buffer[10];
+    int depth = 0;
+
+    setFrameRegisters(&machineContext, 0x1000, (uintptr_t)&frames[0]);
+    XCTAssertEqual(bsg_ksbt_backtraceThreadState(&machineContext, buffer, 0, 10), 4);
+    XCTAssertEqual(buffer[3], (uintptr_t)0x4000);
+    XCTAssertEqual(bsg_ksbt_backtraceThreadStateRetaining(&machineContext, buffer, 5, 5, &depth), 4);
+    XCTAssertEqual(depth, 4);
+
+    frames[2].previous = (const void *)0x10;
+    XCTAssertEqual(bsg_ksbt_backtraceThreadState(&machineContext, buffer, 0, 10), 4);
+    XCTAssertEqual(bsg_ksbt_backtraceThreadStateRetaining(&machineContext, buffer, 5, 5, &depth), 4);
+    XCTAssertEqual(depth, 4);
+
+    // A frame pointer in the first block of memory must not be served from
+    // the stack reader's empty cache.
+    setFrameRegisters(&machineContext, 0x1000, 0x10);
+    XCTAssertEqual(bsg_ksbt_backtraceThreadState(&machineContext, buffer, 0, 10), 1);
+    XCTAssertEqual(buffer[0], (uintptr_t)0x1000);
+    XCTAssertEqual(bsg_ksbt_backtraceThreadStateRetaining(&machineContext, buffer, 5, 5, &depth), 1);
+    XCTAssertEqual(depth, 1);
+}
+
+- (void) testBacktraceThreadsPerformance
+{
+    NSMutableArray<RecursingThread *> *threads = [NSMutableArray array];
+    for (int i = 0; i < 100; i++)
+    {
+        RecursingThread* thread = [[RecursingThread alloc] init];
+        [thread start];
+        [threads addObject:thread];
+    }
+    [NSThread sleepForTimeInterval:0.5];
+    
+    [self measureBlock:^{
+        for (RecursingThread* thread in threads)
+        {
+            uintptr_t backtrace[150];
+            XCTAssertEqual(thread_suspend(thread.thread), KERN_SUCCESS);
+            int length = bsg_ksbt_backtraceThread(thread.thread, backtrace, 150);
+            thread_resume(thread.thread);
+            XCTAssertEqual(length, 150);
+        }
+    }];
+    
+    // Frames that share a block of stack are served from one copy of it.
+    uintptr_t backtrace[150];
+    XCTAssertEqual(thread_suspend(threads[0].thread), KERN_SUCCESS);
+    bsg_test_support_ksbt_reset_copy_count();
+    int length = bsg_ksbt_backtraceThread(threads[0].thread, backtrace, 150);
+    size_t copyCount = bsg_test_support_ksbt_copy_count();
+    thread_resume(threads[0].thread);
+    XCTAssertEqual(length, 150);
+    XCTAssertGreaterThan(copyCount, 0);
+    XCTAssertLessThan(copyCount, (size_t)length / 10);
+    
+    [threads makeObjectsPerformSelector:@selector(cancel)];
+}
 #endif
 
 - (void) testStackGrowDirection
@@ -8,18 +8,47 @@
 
 #import <XCTest/XCTest.h>
 
+#import "BSG_KSCrashReportFields.h"
 #import "BSG_KSCrashReportWriter.h"
+#import "BSG_KSFile.h"
 #import "BSG_KSFileUtils.h"
 #import "BSG_KSJSONCodec.h"
+#import "BSG_KSMachHeaders.h"
+
+#import <fcntl.h>
 
 // Defined in BSG_KSCrashReport.c
 void bsg_kscrw_i_prepareReportWriter(BSG_KSCrashReportWriter *const writer, BSG_KSJSONEncodeContext *const context);
+void bsg_kscrw_i_addBooleanElementForKey(const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key, const bool value);
+void bsg_kscrw_i_addIntegerElementForKey(const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key, const long long value);
+void bsg_kscrw_i_addUIntegerElementForKey(const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key, const unsigned long long value);
+void bsg_kscrw_i_addStringElementForKey(const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key, const char *const value, const size_t length);
+void bsg_kscrw_i_beginArrayForKey(const BSG_KSCrashReportWriter *const writer, const BSG_KSCrashKey key);
+void bsg_kscrw_i_writeBinaryImages(const BSG_KSCrashReportWriter *const writer, const char *const key);
 
 static int addJSONData(const char *data, size_t length, NSMutableData *userData) {
     [userData appendBytes:data length:length];
     return BSG_KSJSON_OK;
 }
 
+static id BinaryJSONObject(void (^ block)(BSG_KSCrashReportWriter *writer)) {
+    NSMutableData *binary = [NSMutableData data];
+    BSG_KSJSONEncodeContext encodeContext;
+    BSG_KSCrashReportWriter reportWriter;
+    bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+    bsg_ksjsonbeginBinaryEncode(&encodeContext, (BSG_KSJSONAddDataFunc)addJSONData, (__bridge void *)binary);
+    block(&reportWriter);
+    bsg_ksjsonendEncode(&encodeContext);
+
+    NSMutableData *data = [NSMutableData data];
+    bsg_ksjsonbeginEncode(&encodeContext, false, (BSG_KSJSONAddDataFunc)addJSONData, (__bridge void *)data);
+    if (bsg_ksjsontranscodeBinary(&encodeContext, binary.bytes, binary.length) != BSG_KSJSON_OK) {
+        return nil;
+    }
+    bsg_ksjsonendEncode(&encodeContext);
+    return [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL];
+}
+
 static id JSONObject(void (^ block)(BSG_KSCrashReportWriter *writer)) {
     NSMutableData *data = [NSMutableData data];
     BSG_KSJSONEncodeContext encodeContext;
@@ -85,4 +114,220 @@ static id JSONObject(void (^ block)(BSG_KSCrashReportWriter *writer)) {
     [[NSFileManager defaultManager] removeItemAtPath:temporaryFile error:NULL];
 }
 
+- (void)testLargeFileElements {
+    // Larger than the block size used to read files, so that elements span several reads.
+    NSMutableArray *items = [NSMutableArray array];
+    NSMutableString *text = [NSMutableString string];
+    for (int i = 0; i < 10000; i++) {
+        [items addObject:[NSString stringWithFormat:@"item %d", i]];
+        [text appendFormat:@"line %d: \"quoted\"\ttabbed\n", i];
+    }
+    NSString *jsonFile = [NSTemporaryDirectory() stringByAppendingPathComponent:@"testLargeFileElements.json"];
+    NSString *textFile = [NSTemporaryDirectory() stringByAppendingPathComponent:@"testLargeFileElements.txt"];
+    [[NSJSONSerialization dataWithJSONObject:items options:0 error:NULL] writeToFile:jsonFile atomically:NO];
+    [text writeToFile:textFile atomically:NO encoding:NSUTF8StringEncoding error:NULL];
+    XCTAssertGreaterThan([text lengthOfBytesUsingEncoding:NSUTF8StringEncoding], 128 * 1024);
+    
+    void (^ block)(BSG_KSCrashReportWriter *) = ^(BSG_KSCrashReportWriter *writer) {
+        writer->beginObject(writer, NULL);
+        writer->addJSONFileElement(writer, "json", jsonFile.fileSystemRepresentation);
+        writer->addTextFileElement(writer, "text", textFile.fileSystemRepresentation);
+        writer->endContainer(writer);
+    };
+    id expected = @{@"json": items, @"text": text};
+    XCTAssertEqualObjects(JSONObject(block), expected);
+    XCTAssertEqualObjects(BinaryJSONObject(block), expected);
+    [[NSFileManager defaultManager] removeItemAtPath:jsonFile error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:textFile error:NULL];
+}
+
+- (void)testEncodedKeys {
+    void (^ block)(BSG_KSCrashReportWriter *) = ^(BSG_KSCrashReportWriter *writer) {
+        writer->beginObject(writer, NULL);
+        bsg_kscrw_i_beginArrayForKey(writer, BSG_KSCrashKey_Contents);
+        writer->beginObject(writer, NULL);
+        bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_InstructionAddr, 0x1000);
+        bsg_kscrw_i_addStringElementForKey(writer, BSG_KSCrashKey_SymbolName, "main", BSG_KSJSON_SIZE_AUTOMATIC);
+        bsg_kscrw_i_addStringElementForKey(writer, BSG_KSCrashKey_ObjectName, NULL, 0);
+        writer->endContainer(writer);
+        writer->endContainer(writer);
+        bsg_kscrw_i_addIntegerElementForKey(writer, BSG_KSCrashKey_Skipped, -1);
+        bsg_kscrw_i_addBooleanElementForKey(writer, BSG_KSCrashKey_Crashed, true);
+        writer->endContainer(writer);
+    };
+    id expected = @{
+        @"contents": @[@{@"instruction_addr": @0x1000, @"symbol_name": @"main", @"object_name": [NSNull null]}],
+        @"skipped": @-1,
+        @"crashed": @YES};
+    XCTAssertEqualObjects(JSONObject(block), expected);
+    XCTAssertEqualObjects(BinaryJSONObject(block), expected);
+}
+
+static int discardJSONData(__unused const char *data, __unused size_t length, __unused void *userData) {
+    return BSG_KSJSON_OK;
+}
+
+static int addJSONDataToFile(const char *data, size_t length, void *userData) {
+    return BSG_KSFileWrite(userData, data, length) ? BSG_KSJSON_OK : BSG_KSJSON_ERROR_CANNOT_ADD_DATA;
+}
+
+static void writeSyntheticThreads(BSG_KSCrashReportWriter *writer, bool encodedKeys) {
+    writer->beginArray(writer, NULL);
+    for (int thread = 0; thread < 200; thread++) {
+        writer->beginObject(writer, NULL);
+        writer->beginObject(writer, BSG_KSCrashField_Backtrace);
+        if (encodedKeys) {
+            bsg_kscrw_i_beginArrayForKey(writer, BSG_KSCrashKey_Contents);
+        } else {
+            writer->beginArray(writer, BSG_KSCrashField_Contents);
+        }
+        for (int frame = 0; frame < 150; frame++) {
+            uintptr_t address = 0x100000000 + (uintptr_t)(thread * 0x1000 + frame * 0x10);
+            writer->beginObject(writer, NULL);
+            if (encodedKeys) {
+                bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_ObjectAddr, 0x100000000);
+                bsg_kscrw_i_addStringElementForKey(writer, BSG_KSCrashKey_ObjectName, "UIKitCore", BSG_KSJSON_SIZE_AUTOMATIC);
+                bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_SymbolAddr, address - 8);
+                bsg_kscrw_i_addStringElementForKey(writer, BSG_KSCrashKey_SymbolName, "-[UIApplication sendEvent:]", BSG_KSJSON_SIZE_AUTOMATIC);
+                bsg_kscrw_i_addUIntegerElementForKey(writer, BSG_KSCrashKey_InstructionAddr, address);
+            } else {
+                writer->addUIntegerElement(writer, BSG_KSCrashField_ObjectAddr, 0x100000000);
+                writer->addStringElement(writer, BSG_KSCrashField_ObjectName, "UIKitCore");
+                writer->addUIntegerElement(writer, BSG_KSCrashField_SymbolAddr, address - 8);
+                writer->addStringElement(writer, BSG_KSCrashField_SymbolName, "-[UIApplication sendEvent:]");
+                writer->addUIntegerElement(writer, BSG_KSCrashField_InstructionAddr, address);
+            }
+            writer->endContainer(writer);
+        }
+        writer->endContainer(writer);
+        writer->endContainer(writer);
+        writer->endContainer(writer);
+    }
+    writer->endContainer(writer);
+}
+
+- (void)testThreadsPerformance {
+    BSG_KSJSONEncodeContext encodeContext;
+    BSG_KSCrashReportWriter reportWriter;
+    bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+    [self measureBlock:^{
+        bsg_ksjsonbeginEncode(reportWriter.context, false, discardJSONData, NULL);
+        writeSyntheticThreads(&reportWriter, false);
+        bsg_ksjsonendEncode(reportWriter.context);
+    }];
+}
+
+- (void)testThreadsWithEncodedKeysPerformance {
+    BSG_KSJSONEncodeContext encodeContext;
+    BSG_KSCrashReportWriter reportWriter;
+    bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+    [self measureBlock:^{
+        bsg_ksjsonbeginEncode(reportWriter.context, false, discardJSONData, NULL);
+        writeSyntheticThreads(&reportWriter, true);
+        bsg_ksjsonendEncode(reportWriter.context);
+    }];
+}
+
+- (void)testThreadsBinaryPerformance {
+    BSG_KSJSONEncodeContext encodeContext;
+    BSG_KSCrashReportWriter reportWriter;
+    bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+    [self measureBlock:^{
+        bsg_ksjsonbeginBinaryEncode(reportWriter.context, discardJSONData, NULL);
+        writeSyntheticThreads(&reportWriter, true);
+        bsg_ksjsonendEncode(reportWriter.context);
+    }];
+}
+
+- (void)testThreadsTranscodePerformance {
+    NSMutableData *binary = [NSMutableData data];
+    BSG_KSJSONEncodeContext encodeContext;
+    BSG_KSCrashReportWriter reportWriter;
+    bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+    bsg_ksjsonbeginBinaryEncode(&encodeContext, (BSG_KSJSONAddDataFunc)addJSONData, (__bridge void *)binary);
+    writeSyntheticThreads(&reportWriter, true);
+    bsg_ksjsonendEncode(&encodeContext);
+    [self measureBlock:^{
+        BSG_KSJSONEncodeContext context;
+        bsg_ksjsonbeginEncode(&context, false, discardJSONData, NULL);
+        XCTAssertEqual(bsg_ksjsontranscodeBinary(&context, binary.bytes, binary.length), BSG_KSJSON_OK);
+        bsg_ksjsonendEncode(&context);
+    }];
+}
+
+// Writes 8 MB JSON and text files to temporary files and calls block with their paths, as a report writer
+// would encounter them: with a 4 KB output buffer that is flushed to an ordinary file.
+static void withLargeFiles(void (^ block)(const char *jsonPath, const char *textPath)) {
+    NSString *jsonFile = [NSTemporaryDirectory() stringByAppendingPathComponent:@"testFileElementsPerformance.json"];
+    NSString *textFile = [NSTemporaryDirectory() stringByAppendingPathComponent:@"testFileElementsPerformance.txt"];
+    NSMutableString *json = [NSMutableString stringWithString:@"["];
+    NSMutableString *text = [NSMutableString string];
+    for (int i = 0; json.length < 8 << 20; i++) {
+        [json appendFormat:@"%@{\"item\":%d,\"name\":\"item number %d\"}", i ? @"," : @"", i, i];
+    }
+    [json appendString:@"]"];
+    for (int i = 0; text.length < 8 << 20; i++) {
+        [text appendFormat:@"line %d: \"quoted\"\ttabbed\n", i];
+    }
+    [json writeToFile:jsonFile atomically:NO encoding:NSUTF8StringEncoding error:NULL];
+    [text writeToFile:textFile atomically:NO encoding:NSUTF8StringEncoding error:NULL];
+    block(jsonFile.fileSystemRepresentation, textFile.fileSystemRepresentation);
+    [[NSFileManager defaultManager] removeItemAtPath:jsonFile error:NULL];
+    [[NSFileManager defaultManager] removeItemAtPath:textFile error:NULL];
+}
+
+- (void)measureFileElements:(bool)binary {
+    withLargeFiles(^(const char *jsonPath, const char *textPath) {
+        NSString *reportFile = [NSTemporaryDirectory() stringByAppendingPathComponent:@"testFileElementsPerformance.report"];
+        BSG_KSJSONEncodeContext encodeContext;
+        BSG_KSCrashReportWriter reportWriter;
+        bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+        [self measureBlock:^{
+            int fd = open(reportFile.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            char fileBuffer[512], jsonBuffer[4096];
+            BSG_KSFile file;
+            BSG_KSFileInit(&file, fd, fileBuffer, sizeof(fileBuffer));
+            if (binary) {
+                bsg_ksjsonbeginBinaryEncode(&encodeContext, addJSONDataToFile, &file);
+            } else {
+                bsg_ksjsonbeginEncode(&encodeContext, false, addJSONDataToFile, &file);
+            }
+            bsg_ksjsonsetOutputBuffer(&encodeContext, jsonBuffer, sizeof(jsonBuffer));
+            reportWriter.beginObject(&reportWriter, NULL);
+            reportWriter.addJSONFileElement(&reportWriter, "json", jsonPath);
+            reportWriter.addTextFileElement(&reportWriter, "text", textPath);
+            reportWriter.endContainer(&reportWriter);
+            bsg_ksjsonendEncode(&encodeContext);
+            BSG_KSFileFlush(&file);
+            close(fd);
+        }];
+        [[NSFileManager defaultManager] removeItemAtPath:reportFile error:NULL];
+    });
+}
+
+- (void)testFileElementsPerformance {
+    [self measureFileElements:false];
+}
+
+- (void)testFileElementsBinaryPerformance {
+    [self measureFileElements:true];
+}
+
+- (void)testBinaryImagesPerformance {
+    bsg_mach_headers_initialize();
+    for (BSG_Mach_Header_Info *image = bsg_mach_headers_get_images(); image; image = image->next) {
+        image->inCrashReport = true;
+    }
+    BSG_KSJSONEncodeContext encodeContext;
+    BSG_KSCrashReportWriter reportWriter;
+    bsg_kscrw_i_prepareReportWriter(&reportWriter, &encodeContext);
+    [self measureBlock:^{
+        for (int i = 0; i < 100; i++) {
+            bsg_ksjsonbeginEncode(reportWriter.context, false, discardJSONData, NULL);
+            bsg_kscrw_i_writeBinaryImages(&reportWriter, NULL);
+            bsg_ksjsonendEncode(reportWriter.context);
+        }
+    }];
+}
+
 @end
@@ -138,7 +138,7 @@ static NSString *JSONString(void (^ block)(BSG_KSJSONEncodeContext *context)) {
 - (void) testSerializeDeserializeArrayFloat
 {
     NSError* error = nil;
-    NSString* expected = @"[-2e-1]";
+    NSString* expected = @"[-2.0000000298023224e-1]";
     id original = @[@(-0.2f)];
     NSString* jsonString = JSONString(^(BSG_KSJSONEncodeContext *context) {
         bsg_ksjsonbeginArray(context, NULL);
@@ -158,7 +158,7 @@ static NSString *JSONString(void (^ block)(BSG_KSJSONEncodeContext *context)) {
 - (void) testSerializeDeserializeArrayFloat2
 {
     NSError* error = nil;
-    NSString* expected = @"[-2e-15]";
+    NSString* expected = @"[-2.0000000072549875e-15]";
     id original = @[@(-2e-15f)];
     NSString* jsonString = JSONString(^(BSG_KSJSONEncodeContext *context) {
         bsg_ksjsonbeginArray(context, NULL);
@@ -401,7 +401,7 @@ static NSString *JSONString(void (^ block)(BSG_KSJSONEncodeContext *context)) {
 - (void) testSerializeDeserializeDictionaryFloat
 {
     NSError* error = nil;
-    NSString* expected = @"{\"One\":5.4918e+1}";
+    NSString* expected = @"{\"One\":5.4917999267578125e+1}";
     id original = @{@"One": @54.918F};
     NSString* jsonString = JSONString(^(BSG_KSJSONEncodeContext *context) {
         bsg_ksjsonbeginObject(context, NULL);
@@ -488,29 +488,31 @@ static NSString *JSONString(void (^ block)(BSG_KSJSONEncodeContext *context)) {
     [self assertDouble:1.2 convertsTo:@"1.2"];
     [self assertDouble:0.12 convertsTo:@"1.2e-1"];
     [self assertDouble:12 convertsTo:@"1.2e+1"];
-    [self assertDouble:9.5932455 convertsTo:@"9.593246"];
+    [self assertDouble:9.5932455 convertsTo:@"9.5932455"];
     [self assertDouble:1.456e+80 convertsTo:@"1.456e+80"];
     [self assertDouble:1.456e-80 convertsTo:@"1.456e-80"];
     [self assertDouble:-1.456e+80 convertsTo:@"-1.456e+80"];
     [self assertDouble:-1.456e-80 convertsTo:@"-1.456e-80"];
     [self assertDouble:1.5e-10 convertsTo:@"1.5e-10"];
-    [self assertDouble:123456789123456789 convertsTo:@"1.234568e+17"];
+    [self assertDouble:123456789123456789 convertsTo:@"1.2345678912345678e+17"];
 
     [self assertDouble:NAN convertsTo:@"nan"];
     [self assertDouble:INFINITY convertsTo:@"inf"];
     [self assertDouble:-INFINITY convertsTo:@"-inf"];
 
-    // Check stepping over the 7 significant digit limit
+    // Values are no longer rounded to 7 significant digits
     [self assertDouble:9999999 convertsTo:@"9.999999e+6"];
-    [self assertDouble:99999994 convertsTo:@"9.999999e+7"];
-    [self assertDouble:99999995 convertsTo:@"1e+8"];
-    [self assertDouble:99999999 convertsTo:@"1e+8"];
+    [self assertDouble:99999994 convertsTo:@"9.9999994e+7"];
+    [self assertDouble:99999995 convertsTo:@"9.9999995e+7"];
+    [self assertDouble:99999999 convertsTo:@"9.9999999e+7"];
+    [self assertDouble:0.1 + 0.2 convertsTo:@"3.0000000000000004e-1"];
+    [self assertDouble:1722000000.123456 convertsTo:@"1.722000000123456e+9"];
 }
 
 - (void) testSerializeDeserializeDictionaryFloat2
 {
     NSError* error = nil;
-    NSString* expected = @"{\"One\":5e+20}";
+    NSString* expected = @"{\"One\":5.000000100204387e+20}";
     id original = @{@"One": @5e20F};
     NSString* jsonString = JSONString(^(BSG_KSJSONEncodeContext *context) {
         bsg_ksjsonbeginObject(context, NULL);
@@ -779,7 +781,7 @@ static NSString *JSONString(void (^ block)(BSG_KSJSONEncodeContext *context)) {
 - (void) testSerializeDeserializeFloat
 {
     NSError* error = nil;
-    NSString* expected = @"[1.2]";
+    NSString* expected = @"[1.2000000476837158]";
     id original = @[@1.2F];
     NSString* jsonString = JSONString(^(BSG_KSJSONEncodeContext *context) {
         bsg_ksjsonbeginArray(context, NULL);
@@ -1087,4 +1089,246 @@ static NSString *JSONString(void (^ block)(BSG_KSJSONEncodeContext *context)) {
                                   @"\\u0001\\u0001\\u0001\\u0001\\u0001\\u0001\\u0001\\u0001\\u0001\\u0001\"");
 }
 
+- (void) testUnescapedLength
+{
+    char buffer[80];
+    const char specials[] = {'"', '\\', '\0', '\x01', '\n', '\x1f'};
+    for (size_t length = 0; length < sizeof(buffer); length++) {
+        memset(buffer, 'a', sizeof(buffer));
+        XCTAssertEqual(bsg_ksjsoncodec_i_unescapedLength(buffer, length), length);
+        for (size_t position = 0; position < length; position++) {
+            for (size_t i = 0; i < sizeof(specials); i++) {
+                memset(buffer, 'a', sizeof(buffer));
+                buffer[position] = specials[i];
+                XCTAssertEqual(bsg_ksjsoncodec_i_unescapedLength(buffer, length), position);
+            }
+            // Non-ASCII UTF-8 bytes must not be treated as control characters.
+            memset(buffer, 'a', sizeof(buffer));
+            buffer[position] = (char)0xE2;
+            XCTAssertEqual(bsg_ksjsoncodec_i_unescapedLength(buffer, length), length);
+        }
+    }
+}
+
+- (void) testSerializeEscapeMixedString
+{
+    NSMutableString *source = [NSMutableString string];
+    NSMutableString *expected = [NSMutableString stringWithString:@"\""];
+    for (int i = 0; i < 100; i++) {
+        [source appendString:@"/System/Library/Frameworks/UIKit.framework/UIKit\t\"é\"\n"];
+        [expected appendString:@"/System/Library/Frameworks/UIKit.framework/UIKit\\t\\\"é\\\"\\n"];
+    }
+    [expected appendString:@"\""];
+    NSString* result = JSONString(^(BSG_KSJSONEncodeContext *context) {
+        const char *value = [source UTF8String];
+        bsg_ksjsonaddStringElement(context, NULL, value, strlen(value));
+    });
+    XCTAssertEqualObjects(result, expected);
+}
+
+static int CountData(__unused const char *data, size_t length, void *userData) {
+    *(size_t *)userData += length;
+    return BSG_KSJSON_OK;
+}
+
+- (void) testSerializeStringPerformance
+{
+    // Representative strings from crash reports: image paths, thread names,
+    // symbol names, exception reasons and breadcrumb metadata.
+    const char *strings[] = {
+        "/System/Library/Frameworks/UIKit.framework/UIKit",
+        "/private/var/containers/Bundle/Application/8E1C1B2A-1234-4321-ABCD-0123456789AB/Example.app/Frameworks/Bugsnag.framework/Bugsnag",
+        "com.apple.main-thread",
+        "-[NSObject(NSObject) doesNotRecognizeSelector:]",
+        "*** -[__NSArrayM objectAtIndex:]: index 5 beyond bounds [0 .. 2]",
+        "{\"type\":\"navigation\",\"name\":\"Scene Did Become Active\"}",
+        "instruction_addr",
+    };
+    const size_t count = sizeof(strings) / sizeof(*strings);
+    size_t lengths[sizeof(strings) / sizeof(*strings)];
+    for (size_t i = 0; i < count; i++) {
+        lengths[i] = strlen(strings[i]);
+    }
+
+    [self measureBlock:^{
+        size_t total = 0;
+        BSG_KSJSONEncodeContext context;
+        bsg_ksjsonbeginEncode(&context, false, CountData, &total);
+        bsg_ksjsonbeginArray(&context, NULL);
+        for (int i = 0; i < 100000; i++) {
+            bsg_ksjsonaddStringElement(&context, NULL, strings[i % count], lengths[i % count]);
+        }
+        bsg_ksjsonendEncode(&context);
+        XCTAssertGreaterThan(total, 0);
+    }];
+}
+
+- (void) testOutputBuffer
+{
+    void (^ encode)(BSG_KSJSONEncodeContext *) = ^(BSG_KSJSONEncodeContext *context) {
+        char longString[300];
+        memset(longString, 'x', sizeof(longString));
+        bsg_ksjsonbeginObject(context, NULL);
+        for (int i = 0; i < 50; i++) {
+            bsg_ksjsonaddUIntegerElement(context, "instruction_addr", 0x100000000ULL + (unsigned)i);
+            bsg_ksjsonaddStringElement(context, "symbol_name", "a\"b", BSG_KSJSON_SIZE_AUTOMATIC);
+            bsg_ksjsonaddStringElement(context, "long", longString, sizeof(longString));
+        }
+    };
+
+    NSString *expected = JSONString(encode);
+
+    for (size_t bufferSize = 1; bufferSize < 1024; bufferSize += 37) {
+        NSMutableData *data = [NSMutableData data];
+        char buffer[bufferSize];
+        BSG_KSJSONEncodeContext context = {0};
+        bsg_ksjsonbeginEncode(&context, false, AddData, (__bridge void *)data);
+        bsg_ksjsonsetOutputBuffer(&context, buffer, bufferSize);
+        encode(&context);
+        XCTAssertEqual(bsg_ksjsonendEncode(&context), BSG_KSJSON_OK);
+        NSString *result = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+        XCTAssertEqualObjects(result, expected, @"bufferSize = %zu", bufferSize);
+    }
+}
+
+- (void) testOutputBufferOnlyFlushesWhenFull
+{
+    size_t total = 0;
+    char buffer[64];
+    BSG_KSJSONEncodeContext context;
+    bsg_ksjsonbeginEncode(&context, false, CountData, &total);
+    bsg_ksjsonsetOutputBuffer(&context, buffer, sizeof(buffer));
+    bsg_ksjsonbeginArray(&context, NULL);
+    bsg_ksjsonaddBooleanElement(&context, NULL, true);
+    XCTAssertEqual(total, 0);
+    XCTAssertEqual(bsg_ksjsonflush(&context), BSG_KSJSON_OK);
+    XCTAssertEqual(total, 5);
+    bsg_ksjsonendEncode(&context);
+    XCTAssertEqual(total, 6);
+}
+
+static NSData *BinaryData(void (^ block)(BSG_KSJSONEncodeContext *context)) {
+    NSMutableData *data = [NSMutableData data];
+    BSG_KSJSONEncodeContext context = {0};
+    bsg_ksjsonbeginBinaryEncode(&context, AddData, (__bridge void *)data);
+    block(&context);
+    bsg_ksjsonendEncode(&context);
+    return data;
+}
+
+static int TranscodeBinary(NSData *binary, NSString **json) {
+    NSMutableData *data = [NSMutableData data];
+    BSG_KSJSONEncodeContext context = {0};
+    bsg_ksjsonbeginEncode(&context, false, AddData, (__bridge void *)data);
+    int result = bsg_ksjsontranscodeBinary(&context, binary.bytes, binary.length);
+    bsg_ksjsonendEncode(&context);
+    *json = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    return result;
+}
+
+- (void) testBinaryTranscodesToJSON
+{
+    void (^ encode)(BSG_KSJSONEncodeContext *) = ^(BSG_KSJSONEncodeContext *context) {
+        const uint8_t bytes[] = {0x00, 0x7f, 0xff};
+        bsg_ksjsonbeginObject(context, NULL);
+        bsg_ksjsonaddBooleanElement(context, "true", true);
+        bsg_ksjsonaddBooleanElement(context, "false", false);
+        bsg_ksjsonaddNullElement(context, "null");
+        bsg_ksjsonaddIntegerElement(context, "min", INT64_MIN);
+        bsg_ksjsonaddIntegerElement(context, "negative", -24);
+        bsg_ksjsonaddUIntegerElement(context, "max", UINT64_MAX);
+        bsg_ksjsonaddFloatingPointElement(context, "pi", 3.141592653589793);
+        bsg_ksjsonaddStringElement(context, "escaped", "a\"b\\c\n\x01é", BSG_KSJSON_SIZE_AUTOMATIC);
+        bsg_ksjsonaddStringElement(context, "empty", "", 0);
+        bsg_ksjsonaddDataElement(context, "data", (const char *)bytes, sizeof(bytes));
+        bsg_ksjsonbeginStringElement(context, "chunked");
+        bsg_ksjsonappendStringElement(context, "one ", 4);
+        bsg_ksjsonappendStringElement(context, "two", 3);
+        bsg_ksjsonendStringElement(context);
+        bsg_ksjsonaddJSONElement(context, "json", "{\"a\":[1,2]}", 11);
+        bsg_ksjsonbeginArray(context, "array");
+        bsg_ksjsonaddUIntegerElement(context, NULL, 0x100000000ULL);
+        bsg_ksjsonbeginObject(context, NULL);
+        bsg_ksjsonendContainer(context);
+        bsg_ksjsonendContainer(context);
+        bsg_ksjsonbeginElement(context, "raw");
+        bsg_ksjsonaddRawJSONData(context, "[1,", 3);
+        bsg_ksjsonaddRawJSONData(context, "2]", 2);
+        bsg_ksjsonendContainer(context);
+    };
+
+    NSString *expected = JSONString(encode);
+    NSData *binary = BinaryData(encode);
+    XCTAssertLessThan(binary.length, [expected lengthOfBytesUsingEncoding:NSUTF8StringEncoding]);
+
+    NSString *json = nil;
+    XCTAssertEqual(TranscodeBinary(binary, &json), BSG_KSJSON_OK);
+    XCTAssertEqualObjects(json, expected);
+}
+
+- (void) testBinaryTruncatedIsIncomplete
+{
+    NSData *binary = BinaryData(^(BSG_KSJSONEncodeContext *context) {
+        bsg_ksjsonbeginObject(context, NULL);
+        bsg_ksjsonbeginArray(context, "frames");
+        bsg_ksjsonaddStringElement(context, NULL, "symbol_name", BSG_KSJSON_SIZE_AUTOMATIC);
+        bsg_ksjsonaddUIntegerElement(context, NULL, 0x100000000ULL);
+    });
+    for (NSUInteger length = 0; length < binary.length; length++) {
+        NSString *json = nil;
+        XCTAssertNotEqual(TranscodeBinary([binary subdataWithRange:NSMakeRange(0, length)], &json),
+                          BSG_KSJSON_OK, @"length = %lu", (unsigned long)length);
+    }
+}
+
+- (void) testBinaryRejectsInvalidData
+{
+    const char invalid[] = {(char)0xd9, (char)0xd9, (char)0xf7, (char)0x1c};
+    NSString *json = nil;
+    XCTAssertEqual(TranscodeBinary([NSData dataWithBytes:invalid length:sizeof(invalid)], &json),
+                   BSG_KSJSON_ERROR_INVALID_DATA);
+}
+
+- (void) testAddEncodedElements
+{
+    for (int binary = 0; binary <= 1; binary++) {
+        // Capture the members of an object, leaving out the closing '}' or break.
+        NSMutableData *data = [NSMutableData data];
+        BSG_KSJSONEncodeContext context = {0};
+        if (binary) {
+            bsg_ksjsonbeginBinaryEncode(&context, AddData, (__bridge void *)data);
+        } else {
+            bsg_ksjsonbeginEncode(&context, false, AddData, (__bridge void *)data);
+        }
+        bsg_ksjsonbeginObject(&context, NULL);
+        NSUInteger start = data.length;
+        bsg_ksjsonaddStringElement(&context, "string", "value", BSG_KSJSON_SIZE_AUTOMATIC);
+        bsg_ksjsonaddJSONElement(&context, "json", "[1,2]", 5);
+        bsg_ksjsonendContainer(&context);
+        bsg_ksjsonendEncode(&context);
+        NSData *members = [data subdataWithRange:NSMakeRange(start, data.length - start - 1)];
+
+        void (^ encode)(BSG_KSJSONEncodeContext *) = ^(BSG_KSJSONEncodeContext *context) {
+            bsg_ksjsonbeginObject(context, NULL);
+            bsg_ksjsonbeginObject(context, "first");
+            bsg_ksjsonaddEncodedElements(context, members.bytes, members.length);
+            bsg_ksjsonendContainer(context);
+            bsg_ksjsonaddIntegerElement(context, "before", 1);
+            bsg_ksjsonaddEncodedElements(context, members.bytes, members.length);
+            bsg_ksjsonaddIntegerElement(context, "after", 2);
+            bsg_ksjsonendContainer(context);
+        };
+
+        NSString *json = nil;
+        if (binary) {
+            XCTAssertEqual(TranscodeBinary(BinaryData(encode), &json), BSG_KSJSON_OK);
+        } else {
+            json = JSONString(encode);
+        }
+        XCTAssertEqualObjects(json, @"{\"first\":{\"string\":\"value\",\"json\":[1,2]},"
+                              "\"before\":1,\"string\":\"value\",\"json\":[1,2],\"after\":2}",
+                              @"binary = %d", binary);
+    }
+}
+
 @end